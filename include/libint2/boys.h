@@ -33,6 +33,7 @@
 #include <algorithm>
 #include <limits>
 #include <mutex>
+#include <atomic>
 #include <type_traits>
 #include <memory>
 
@@ -55,6 +56,56 @@ extern "C" void dgesv_(const int* n,
 
 namespace libint2 {
 
+  namespace detail {
+    /// manages the shared, immutable instances of core integral evaluator \c T .
+
+    /// Looking up an instance that can serve a request is lock-free; only when the current instance
+    /// does not suffice (e.g. its max m is too small) a new one is created, under a lock. Superseded
+    /// instances are kept alive until the program exits, hence the pointers returned by instance()
+    /// never dangle. libint2::initialize() presizes the instances used by Engine
+    /// (see init_core_eval_tables() ), so that normally the lock is never taken.
+    template <typename T>
+    class core_eval_registry {
+      public:
+        /// @param suffices a callable that returns true if the given instance can serve the request
+        /// @param create a callable that creates a new instance given the current one (or nullptr)
+        /// @return a pointer to an instance for which @c suffices returns true
+        template <typename Suffices, typename Create>
+        static T* instance(Suffices&& suffices, Create&& create) {
+          auto* result = current().load(std::memory_order_acquire);
+          if (result == nullptr || !suffices(*result)) {
+            std::lock_guard<std::mutex> lck(mutex());
+            result = current().load(std::memory_order_relaxed);
+            if (result == nullptr || !suffices(*result)) {
+              instances().emplace_back(create(result));
+              result = instances().back().get();
+              current().store(result, std::memory_order_release);
+            }
+          }
+          return result;
+        }
+
+        /// @return a non-owning shared_ptr to \c ptr ; copying it does not touch a reference count
+        static std::shared_ptr<T> nonowning_ptr(T* ptr) {
+          return std::shared_ptr<T>(std::shared_ptr<T>(), ptr);
+        }
+
+      private:
+        static std::atomic<T*>& current() {
+          static std::atomic<T*> value{nullptr};
+          return value;
+        }
+        static std::mutex& mutex() {
+          static std::mutex value;
+          return value;
+        }
+        static std::vector<std::unique_ptr<T>>& instances() {
+          static std::vector<std::unique_ptr<T>> value;
+          return value;
+        }
+    };
+  }  // namespace libint2::detail
+
   /// holds tables of expensive quantities
   template<typename Real>
   class ExpensiveNumbers {
@@ -191,6 +242,17 @@ namespace libint2 {
         return;
       }
 
+      /// fills up an array of Fm(T) for m in [0,mmax] for each of @c n arguments
+      /// @param[out] Fm array to be filled in with the Boys function values, must be at least n*(mmax+1) elements long;
+      ///             the values for argument \c T[i] are stored at \c Fm[i*(mmax+1)] ... \c Fm[i*(mmax+1)+mmax]
+      /// @param[in] T the Boys function arguments
+      /// @param[in] n the number of arguments
+      /// @param[in] mmax the maximum value of m for which Boys function will be computed;
+      static void eval(Real* Fm, const Real* T, size_t n, size_t mmax) {
+        for(size_t i=0; i!=n; ++i)
+          eval(Fm + i*(mmax+1), T[i], mmax);
+      }
+
   };
 
   /** Computes the Boys function, \$ F_m (T) = \int_0^1 u^{2m} \exp(-T u^2) \, {\rm d}u \$,
@@ -297,24 +359,21 @@ namespace libint2 {
       }
 
       /// Singleton interface allows to manage the lone instance; adjusts max m values as needed in thread-safe fashion
+      /// @note lock-free unless a larger instance must be created
       static std::shared_ptr<const FmEval_Chebyshev7> instance(int m_max, double = 0.0) {
 
         assert(m_max >= 0);
-        // thread-safe per C++11 standard [6.7.4]
-        static auto instance_ = std::make_shared<const FmEval_Chebyshev7>(m_max);
-
-        while (instance_->max_m() < m_max) {
-          static std::mutex mtx;
-          std::lock_guard<std::mutex> lck(mtx);
-          if (instance_->max_m() < m_max) {
-            auto new_instance = std::make_shared<const FmEval_Chebyshev7>(m_max);
-            instance_ = new_instance;
-          }
-        }
-
-        return instance_;
+        typedef detail::core_eval_registry<const FmEval_Chebyshev7> registry;
+        return registry::nonowning_ptr(registry::instance(
+            [m_max](const FmEval_Chebyshev7& x) { return x.max_m() >= m_max; },
+            [m_max](const FmEval_Chebyshev7* x) {
+              return new FmEval_Chebyshev7(std::max(m_max, x ? x->max_m() : 0));
+            }));
       }
 
+      /// @return the maximum value of m for which the Boys function is tabulated
+      static constexpr int max_m_tabulated() { return cheb_table_mmax; }
+
       /// @return the maximum value of m for which the Boys function can be computed with this object
       int max_m() const { return mmax; }
 
@@ -325,15 +384,8 @@ namespace libint2 {
       inline void eval(Real* Fm, Real x, int m_max) const {
 
         // large T => use upward recursion
-        // cost = 1 div + 1 sqrt + (1 + 2*(m-1)) muls
         if (x > T_crit) {
-          const double one_over_x = 1/x;
-          Fm[0] = 0.88622692545275801365 * sqrt(one_over_x); // see Eq. (9.8.9) in Helgaker-Jorgensen-Olsen
-          if (m_max == 0)
-            return;
-          // this upward recursion formula omits - e^(-x)/(2x), which for x>T_crit is small enough to guarantee full double precision
-          for (int i = 1; i <= m_max; i++)
-            Fm[i] = Fm[i - 1] * numbers_.ihalf[i] * one_over_x; // see Eq. (9.8.13)
+          eval_upward(Fm, x, m_max);
           return;
         }
 
@@ -344,6 +396,60 @@ namespace libint2 {
         const Real x_over_delta = x * one_over_delta;
         const int iv = int(x_over_delta); // the interval index
         const Real xd = x_over_delta - (Real)iv - 0.5; // this ranges from -0.5 to 0.5
+        interpolate(Fm, iv, xd, m_max);
+
+      } // eval()
+
+      /// fills in Fm with computed Boys function values for m in [0,mmax] for each of @c n arguments
+
+      /// The batch is processed in chunks: the interval indices and the reduced arguments of the chunk are computed
+      /// in a branch-free loop first, then the values are interpolated (or, for large arguments, computed by upward recursion)
+      /// one argument at a time.
+      /// @param[out] Fm array to be filled in with the Boys function values, must be at least n*(mmax+1) elements long;
+      ///             the values for argument \c x[i] are stored at \c Fm[i*(mmax+1)] ... \c Fm[i*(mmax+1)+mmax]
+      /// @param[in] x the Boys function arguments
+      /// @param[in] n the number of arguments
+      /// @param[in] mmax the maximum value of m for which Boys function will be computed; mmax must be <= the value returned by max_m
+      inline void eval(Real* Fm, const Real* x, size_t n, int m_max) const {
+        const size_t chunk_size = 64;
+        int iv[chunk_size];
+        Real xd[chunk_size];
+        const auto stride = m_max + 1;
+        for (size_t i0 = 0; i0 < n; i0 += chunk_size) {
+          const auto ni = std::min(chunk_size, n - i0);
+          const Real* xi = x + i0;
+          // large arguments are clamped so that the interval index is always valid
+          for (size_t i = 0; i != ni; ++i) {
+            const Real x_over_delta = (xi[i] > T_crit ? Real(T_crit) : xi[i]) * one_over_delta;
+            iv[i] = int(x_over_delta);
+            xd[i] = x_over_delta - (Real)iv[i] - 0.5;
+          }
+          Real* Fmi = Fm + i0 * stride;
+          for (size_t i = 0; i != ni; ++i, Fmi += stride) {
+            if (xi[i] > T_crit)
+              eval_upward(Fmi, xi[i], m_max);
+            else
+              interpolate(Fmi, iv[i], xd[i], m_max);
+          }
+        }
+      }
+
+    private:
+
+      /// computes Fm for large argument by upward recursion
+      /// cost = 1 div + 1 sqrt + (1 + 2*(m-1)) muls
+      inline void eval_upward(Real* Fm, Real x, int m_max) const {
+        const double one_over_x = 1/x;
+        Fm[0] = 0.88622692545275801365 * sqrt(one_over_x); // see Eq. (9.8.9) in Helgaker-Jorgensen-Olsen
+        if (m_max == 0)
+          return;
+        // this upward recursion formula omits - e^(-x)/(2x), which for x>T_crit is small enough to guarantee full double precision
+        for (int i = 1; i <= m_max; i++)
+          Fm[i] = Fm[i - 1] * numbers_.ihalf[i] * one_over_x; // see Eq. (9.8.13)
+      }
+
+      /// interpolates Fm in interval @c iv at reduced argument @c xd (-0.5 <= xd <= 0.5)
+      inline void interpolate(Real* Fm, int iv, Real xd, int m_max) const {
         const int m_min = 0;
 
 #if defined(__AVX__)
@@ -424,7 +530,8 @@ namespace libint2 {
 #endif
 
 
-      } // eval()
+      } // interpolate()
+
 
     private:
 
@@ -597,19 +704,16 @@ namespace libint2 {
       static std::shared_ptr<const FmEval_Taylor> instance(unsigned int mmax, Real precision = std::numeric_limits<Real>::epsilon()) {
         assert(mmax >= 0);
         assert(precision >= 0);
-        // thread-safe per C++11 standard [6.7.4]
-        static auto instance_ = std::make_shared<const FmEval_Taylor>(mmax, precision);
-
-        while (instance_->max_m() < mmax || instance_->precision() > precision) {
-          static std::mutex mtx;
-          std::lock_guard<std::mutex> lck(mtx);
-          if (instance_->max_m() < mmax || instance_->precision() > precision) {
-            auto new_instance = std::make_shared<const FmEval_Taylor>(mmax, precision);
-            instance_ = new_instance;
-          }
-        }
-
-        return instance_;
+        typedef detail::core_eval_registry<const FmEval_Taylor> registry;
+        return registry::nonowning_ptr(registry::instance(
+            [mmax, precision](const FmEval_Taylor& x) {
+              return x.max_m() >= int(mmax) && x.precision() <= precision;
+            },
+            [mmax, precision](const FmEval_Taylor* x) {
+              return x ? new FmEval_Taylor(std::max(mmax, (unsigned int)x->max_m()),
+                                           std::min(precision, x->precision()))
+                       : new FmEval_Taylor(mmax, precision);
+            }));
       }
 
       /// @return the maximum value of m for which this object can compute the Boys function
@@ -887,24 +991,21 @@ namespace libint2 {
       }
 
       /// Singleton interface allows to manage the lone instance; adjusts max m values as needed in thread-safe fashion
+      /// @note lock-free unless a larger instance must be created
       static std::shared_ptr<const TennoGmEval> instance(int m_max, double = 0) {
 
         assert(m_max >= 0);
-        // thread-safe per C++11 standard [6.7.4]
-        static auto instance_ = std::make_shared<const TennoGmEval>(m_max);
-
-        while (instance_->max_m() < m_max) {
-          static std::mutex mtx;
-          std::lock_guard<std::mutex> lck(mtx);
-          if (instance_->max_m() < m_max) {
-            auto new_instance = std::make_shared<const TennoGmEval>(m_max);
-            instance_ = new_instance;
-          }
-        }
-
-        return instance_;
+        typedef detail::core_eval_registry<const TennoGmEval> registry;
+        return registry::nonowning_ptr(registry::instance(
+            [m_max](const TennoGmEval& x) { return int(x.max_m()) >= m_max; },
+            [m_max](const TennoGmEval* x) {
+              return new TennoGmEval(std::max(m_max, x ? int(x->max_m()) : 0));
+            }));
       }
 
+      /// @return the maximum value of m for which the core integral is tabulated
+      static constexpr int max_m_tabulated() { return cheb_table_mmax; }
+
       unsigned int max_m() const { return mmax_; }
       /// @return the precision with which this object can compute the result
       Real precision() const { return precision_; }
@@ -1413,19 +1514,16 @@ namespace libint2 {
       static std::shared_ptr<GaussianGmEval> instance(unsigned int mmax, Real precision = std::numeric_limits<Real>::epsilon()) {
         assert(mmax >= 0);
         assert(precision >= 0);
-        // thread-safe per C++11 standard [6.7.4]
-        static auto instance_ = std::make_shared<GaussianGmEval>(mmax, precision);
-
-        while (instance_->max_m() < mmax || instance_->precision() > precision) {
-          static std::mutex mtx;
-          std::lock_guard<std::mutex> lck(mtx);
-          if (instance_->max_m() < mmax || instance_->precision() > precision) {
-            auto new_instance = std::make_shared<GaussianGmEval>(mmax, precision);
-            instance_ = new_instance;
-          }
-        }
-
-        return instance_;
+        typedef detail::core_eval_registry<GaussianGmEval> registry;
+        return registry::nonowning_ptr(registry::instance(
+            [mmax, precision](const GaussianGmEval& x) {
+              return x.max_m() >= int(mmax) && x.precision() <= precision;
+            },
+            [mmax, precision](const GaussianGmEval* x) {
+              return x ? new GaussianGmEval(std::max(int(mmax), x->max_m()),
+                                            std::min(precision, x->precision()))
+                       : new GaussianGmEval(mmax, precision);
+            }));
       }
 
       /// @return the maximum value of m for which the \f$ G_m(\rho, T) \f$ can be computed with this object
@@ -1974,6 +2072,21 @@ namespace libint2 {
     }
 #endif
 
+  namespace detail {
+    /// creates the core integral evaluators used by Engine, sized for all angular momenta and
+    /// derivative orders supported by this library, so that Engine never has to rebuild them
+    inline void init_core_eval_tables() {
+// LIBINT2_MAX_AM is not defined by the code generated for individual classes (see tests in src/bin/test_eri)
+#if !defined(LIBINT_USER_DEFINED_REAL) && defined(LIBINT2_MAX_AM)
+      const int mmax = 4 * LIBINT2_MAX_AM + 4;
+      FmEval_Chebyshev7<double>::instance(
+          std::min(mmax, FmEval_Chebyshev7<double>::max_m_tabulated()));
+      TennoGmEval<double>::instance(
+          std::min(mmax, TennoGmEval<double>::max_m_tabulated()));
+#endif
+    }
+  }  // namespace libint2::detail
+
 } // end of namespace libint2
 
 #endif // C++ only
@@ -0,0 +1,406 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_dfintegralstore_h_
+#define _libint2_src_lib_libint_dfintegralstore_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/df_integral_store.h requires C++11 support"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ios>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <libint2/basis.h>
+#include <libint2/engine.h>
+#include <libint2/shellblock_file.h>
+#include <libint2/shellpair_database.h>
+
+namespace libint2 {
+
+/// DFIntegralStore computes and holds the 3-center Coulomb integrals \f$ (P|\mu\nu) \f$ over
+/// a density-fitting basis (\f$ P \f$) and an orbital basis (\f$ \mu,\nu \f$) .
+
+/// The integrals are stored in a block-sparse layout keyed by the significant shell pairs
+/// \c {s1,s2} , \c s2<=s1 , of a (symmetric) ShellPairDatabase of the orbital basis: the block of
+/// shell pair \c sp is a dense (ndf x n1*n2) row-major matrix, i.e. the integrals are packed
+/// in the order of the shell sets computed by Engine with BraKet::xs_xx . The integrals of
+/// the pairs that are not significant, and those of the DF shells for which the Schwarz-type
+/// estimate \f$ \sqrt{||(P|P)||_\infty} \sqrt{||(\mu\nu|\mu\nu)||_\infty} \f$ is below the target
+/// precision, are zero and are not computed. Since only the \f$ \mu \ge \nu \f$ pairs are kept,
+/// the store takes less than half the memory of the dense (ndf x n x n) tensor, and much
+/// less for extended systems.
+/// If the integrals do not fit in memory, the blocks can be kept in a file instead (see the constructor);
+/// then they are computed, and later read back, in batches of consecutive blocks, and the next batch
+/// is read while the current one is processed.
+class DFIntegralStore {
+ public:
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1> Vector;
+
+  /// computes the integrals
+  /// @param obs the orbital basis set
+  /// @param dfbs the density-fitting basis set
+  /// @param nthreads the number of threads to use
+  /// @param precision the target precision of the integrals
+  /// @param filename if not empty, the blocks are kept in the file of this name rather than
+  ///        in memory; the file is removed when this object is destroyed
+  /// @param batch_size the maximum number of integrals of a batch of blocks held in memory
+  ///        if the blocks are kept in a file
+  /// \warning @c obs and @c dfbs must outlive this object
+  DFIntegralStore(const BasisSet& obs, const BasisSet& dfbs,
+                  std::size_t nthreads = 1,
+                  double precision = std::numeric_limits<double>::epsilon(),
+                  const std::string& filename = std::string(),
+                  std::size_t batch_size = 1ul << 24)
+      : obs_(obs),
+        dfbs_(dfbs),
+        spdb_(obs),
+        nthreads_(std::max<std::size_t>(nthreads, 1)),
+        precision_(precision),
+        filename_(filename),
+        batch_size_(batch_size) {
+    init();
+  }
+
+  ~DFIntegralStore() {
+    if (!in_core()) std::remove(filename_.c_str());
+  }
+
+  /// @return true if the blocks are kept in memory, false if they are kept in a file
+  bool in_core() const { return filename_.empty(); }
+
+  /// @return the shell pair database whose pairs key the blocks
+  const ShellPairDatabase& shellpairs() const { return spdb_; }
+
+  /// @return the number of threads
+  std::size_t nthreads() const { return nthreads_; }
+
+  /// @param[in] sp shell-pair index
+  /// @return the (ndf x n1*n2) block of shell pair @c sp
+  /// @note only available if in_core() is true
+  Eigen::Map<const Matrix> block(std::size_t sp) const {
+    assert(in_core());
+    return Eigen::Map<const Matrix>(data_.data() + offsets_[sp], dfbs_.nbf(),
+                                    block_cols(sp));
+  }
+
+  /// @return the number of (DF shell, shell pair) integral sets that survived the screening
+  std::size_t nsignificant() const { return nsignificant_; }
+
+  /// @return the number of stored integrals, including those that were screened out
+  std::size_t size() const { return offsets_.back(); }
+
+  /// @return the number of bytes of memory used by this object, not including the basis sets
+  std::size_t nbytes() const {
+    return spdb_.nbytes() + data_.size() * sizeof(double) +
+           offsets_.size() * sizeof(std::size_t);
+  }
+
+  /// transforms the DF index of the integrals, \f$ (Q|\mu\nu) \leftarrow \sum_P M_{PQ} (P|\mu\nu) \f$ ;
+  /// e.g. for \f$ \mathbf{M} = \mathbf{L}^{-\dagger} \f$ , where \f$ \mathbf{V} = \mathbf{L} \mathbf{L}^\dagger \f$
+  /// is the Cholesky decomposition of the 2-center Coulomb metric, the store will hold the
+  /// integrals in the orthonormalized (fitted) DF basis
+  /// @param[in] M the (ndf x ndf) transformation matrix
+  void transform(const Matrix& M) {
+    const auto ndf = dfbs_.nbf();
+    assert(M.rows() == ndf && M.cols() == ndf);
+    // transforms the blocks of shell pairs [sp_first,sp_last) ; out may be the same as in
+    auto transform_batch = [&](std::size_t sp_first, std::size_t sp_last,
+                               const double* in, double* out) {
+      auto thread_main = [&](std::size_t thread_id) {
+        Matrix tmp;
+        for (auto sp = sp_first + thread_id; sp < sp_last; sp += nthreads_) {
+          const auto offset = offsets_[sp] - offsets_[sp_first];
+          tmp.noalias() =
+              M.transpose() *
+              Eigen::Map<const Matrix>(in + offset, ndf, block_cols(sp));
+          Eigen::Map<Matrix>(out + offset, ndf, block_cols(sp)) = tmp;
+        }
+      };
+      run_threads(thread_main);
+    };
+
+    if (in_core()) {
+      transform_batch(0, spdb_.size(), data_.data(), data_.data());
+    } else {
+      const auto tmp_filename = filename_ + ".tmp";
+      {
+        ShellBlockFileWriter writer(tmp_filename);
+        std::vector<double> out;
+        for_each_batch([&](std::size_t sp_first, std::size_t sp_last,
+                           const double* in) {
+          out.resize(offsets_[sp_last] - offsets_[sp_first]);
+          transform_batch(sp_first, sp_last, in, out.data());
+          for (auto sp = sp_first; sp != sp_last; ++sp)
+            writer.write(sp, out.data() + offsets_[sp] - offsets_[sp_first],
+                         offsets_[sp + 1] - offsets_[sp]);
+        });
+        writer.close();
+      }
+      if (std::rename(tmp_filename.c_str(), filename_.c_str()) != 0)
+        throw std::ios_base::failure("DFIntegralStore: could not rename " +
+                                     tmp_filename);
+    }
+  }
+
+  /// contracts the orbital index of the integrals with a coefficient matrix,
+  /// \f$ X_{Q,\mu i} = \sum_\nu (Q|\mu\nu) C_{\nu i} \f$
+  /// @param[in] C the (n x m) coefficient matrix, e.g. the occupied orbitals
+  /// @return the (ndf x n*m) row-major matrix \f$ X \f$ ; row @c Q is an (n x m) row-major matrix
+  Matrix contract_ao(const Matrix& C) const {
+    const std::size_t n = obs_.nbf();
+    const std::size_t ndf = dfbs_.nbf();
+    assert(C.rows() == n);
+    const std::size_t m = C.cols();
+    Matrix X = Matrix::Zero(ndf, n * m);
+
+    // the threads own disjoint ranges of rows of X
+    const auto batch_size = (ndf + nthreads_ - 1) / nthreads_;
+    for_each_batch([&](std::size_t sp_first, std::size_t sp_last,
+                       const double* data) {
+      auto thread_main = [&](std::size_t thread_id) {
+        const auto Q_first = std::min(thread_id * batch_size, ndf);
+        const auto Q_last = std::min(Q_first + batch_size, ndf);
+        const auto& shell2bf = obs_.shell2bf();
+        for (auto sp = sp_first; sp != sp_last; ++sp) {
+          const auto s1 = spdb_.shell1(sp);
+          const auto s2 = spdb_.shell2(sp);
+          const auto bf1_first = shell2bf[s1];
+          const auto bf2_first = shell2bf[s2];
+          const auto n1 = obs_[s1].size();
+          const auto n2 = obs_[s2].size();
+          const auto* blk = data + offsets_[sp] - offsets_[sp_first];
+          for (auto Q = Q_first; Q < Q_last; ++Q) {
+            Eigen::Map<const Matrix> B(blk + Q * n1 * n2, n1, n2);
+            Eigen::Map<Matrix> XQ(X.data() + Q * n * m, n, m);
+            XQ.middleRows(bf1_first, n1).noalias() += B * C.middleRows(bf2_first, n2);
+            if (s1 != s2)
+              XQ.middleRows(bf2_first, n2).noalias() +=
+                  B.transpose() * C.middleRows(bf1_first, n1);
+          }
+        }
+      };
+      run_threads(thread_main);
+    });
+    return X;
+  }
+
+  /// contracts the DF index of the integrals with a vector,
+  /// \f$ J_{\mu\nu} = \sum_Q (Q|\mu\nu) d_Q \f$
+  /// @param[in] d the vector of ndf coefficients
+  /// @return the (n x n) symmetric matrix \f$ J \f$
+  Matrix contract_df(const Vector& d) const {
+    const auto n = obs_.nbf();
+    const auto ndf = dfbs_.nbf();
+    assert(d.size() == ndf);
+    Matrix J = Matrix::Zero(n, n);
+
+    // each shell pair contributes to its own blocks of J only
+    for_each_batch([&](std::size_t sp_first, std::size_t sp_last,
+                       const double* data) {
+      auto thread_main = [&](std::size_t thread_id) {
+        const auto& shell2bf = obs_.shell2bf();
+        Vector j;
+        for (auto sp = sp_first + thread_id; sp < sp_last; sp += nthreads_) {
+          const auto s1 = spdb_.shell1(sp);
+          const auto s2 = spdb_.shell2(sp);
+          const auto n1 = obs_[s1].size();
+          const auto n2 = obs_[s2].size();
+          Eigen::Map<const Matrix> blk(data + offsets_[sp] - offsets_[sp_first],
+                                       ndf, n1 * n2);
+          j.noalias() = blk.transpose() * d;
+          Eigen::Map<const Matrix> J12(j.data(), n1, n2);
+          J.block(shell2bf[s1], shell2bf[s2], n1, n2) = J12;
+          if (s1 != s2) J.block(shell2bf[s2], shell2bf[s1], n2, n1) = J12.transpose();
+        }
+      };
+      run_threads(thread_main);
+    });
+    return J;
+  }
+
+ private:
+  const BasisSet& obs_;
+  const BasisSet& dfbs_;
+  ShellPairDatabase spdb_;
+  std::size_t nthreads_;
+  double precision_;
+  std::string filename_;
+  std::size_t batch_size_;
+  std::vector<std::size_t> offsets_;  // the offsets of the blocks, followed by the total size
+  std::vector<double> data_;          // the blocks, if in_core()
+  std::size_t nsignificant_ = 0;
+
+  /// @return the number of columns of the block of shell pair @c sp
+  std::size_t block_cols(std::size_t sp) const {
+    return obs_[spdb_.shell1(sp)].size() * obs_[spdb_.shell2(sp)].size();
+  }
+
+  /// runs @c thread_main(thread_id) on @c nthreads_ threads, including the calling thread
+  template <typename ThreadMain>
+  void run_threads(const ThreadMain& thread_main) const {
+    std::vector<std::thread> threads;
+    for (auto thread_id = 1ul; thread_id < nthreads_; ++thread_id)
+      threads.emplace_back(thread_main, thread_id);
+    thread_main(0);
+    for (auto& thread : threads) thread.join();
+  }
+
+  /// calls @c f(sp_first,sp_last,data) for batches of consecutive blocks, where @c data points to
+  /// the block of shell pair @c sp_first , followed by the other blocks of the batch; if the blocks are
+  /// kept in memory, there is a single batch
+  template <typename F>
+  void for_each_batch(const F& f) const {
+    if (in_core()) {
+      f(0, spdb_.size(), static_cast<const double*>(data_.data()));
+    } else {
+      // the records of the file are the blocks, in order
+      ShellBlockFileReader reader(filename_);
+      assert(reader.nrecords() == spdb_.size());
+      reader.stream(f, batch_size_);
+    }
+  }
+
+  /// allocates the blocks and computes the integrals
+  void init() {
+    const auto npairs = spdb_.size();
+    const auto ndf = dfbs_.nbf();
+    const auto nshells_df = dfbs_.size();
+    const auto& unitshell = Shell::unit();
+
+    offsets_.resize(npairs + 1);
+    offsets_[0] = 0;
+    for (auto sp = 0ul; sp != npairs; ++sp)
+      offsets_[sp + 1] = offsets_[sp] + ndf * block_cols(sp);
+
+    // the Schwarz factors of the DF shells, sqrt(||(P|P)||)
+    std::vector<double> Schwarz_df(nshells_df);
+    {
+      Engine engine(Operator::coulomb, dfbs_.max_nprim(), dfbs_.max_l(), 0, 0.0,
+                    operator_traits<Operator::coulomb>::default_params(),
+                    BraKet::xs_xs);
+      const auto& buf = engine.results();
+      for (auto P = 0ul; P != nshells_df; ++P) {
+        engine.compute2<Operator::coulomb, BraKet::xs_xs, 0>(dfbs_[P], unitshell,
+                                                             dfbs_[P], unitshell);
+        double max_abs = 0.0;
+        if (buf[0] != nullptr) {
+          const auto nP = dfbs_[P].size();
+          for (auto i = 0ul; i != nP * nP; ++i)
+            max_abs = std::max(max_abs, std::abs(buf[0][i]));
+        }
+        Schwarz_df[P] = std::sqrt(max_abs);
+      }
+    }
+
+    // the primitive data of the {P,unit} pairs is shared by all shell pairs
+    const auto ln_prec = std::log(std::numeric_limits<double>::epsilon());
+    std::vector<ShellPair> dfpairs;
+    dfpairs.reserve(nshells_df);
+    for (auto P = 0ul; P != nshells_df; ++P)
+      dfpairs.emplace_back(dfbs_[P], unitshell, ln_prec);
+
+    // computes the blocks of shell pairs [sp_first,sp_last) into data, which is zeroed
+    std::vector<std::size_t> nsignificant(nthreads_, 0);
+    auto compute_batch = [&](std::size_t sp_first, std::size_t sp_last,
+                             double* data) {
+      auto thread_main = [&](std::size_t thread_id) {
+        // N.B. the braket is given to the constructor since the AM limits of the 3-center
+        // integrals may exceed those of the 4-center integrals
+        Engine engine(Operator::coulomb,
+                      std::max(obs_.max_nprim(), dfbs_.max_nprim()),
+                      std::max(obs_.max_l(), dfbs_.max_l()), 0, precision_,
+                      operator_traits<Operator::coulomb>::default_params(),
+                      BraKet::xs_xx);
+        const auto& buf = engine.results();
+        // for the Schwarz factors of the shell pairs, sqrt(||(μν|μν)||)
+        Engine engine_schwarz(Operator::coulomb, obs_.max_nprim(), obs_.max_l(), 0, 0.0);
+        const auto& buf_schwarz = engine_schwarz.results();
+        const auto& shell2bf_df = dfbs_.shell2bf();
+
+        for (auto sp = sp_first + thread_id; sp < sp_last; sp += nthreads_) {
+          const auto s1 = spdb_.shell1(sp);
+          const auto s2 = spdb_.shell2(sp);
+          const auto n12 = block_cols(sp);
+
+          engine_schwarz.compute2<Operator::coulomb, BraKet::xx_xx, 0>(spdb_, sp, sp);
+          if (buf_schwarz[0] == nullptr) continue;
+          double max_abs = 0.0;
+          for (auto i = 0ul; i != n12 * n12; ++i)
+            max_abs = std::max(max_abs, std::abs(buf_schwarz[0][i]));
+          const auto Schwarz12 = std::sqrt(max_abs);
+
+          const auto sp12 = spdb_[sp];
+          auto* blk = data + offsets_[sp] - offsets_[sp_first];
+          for (auto P = 0ul; P != nshells_df; ++P) {
+            if (Schwarz_df[P] * Schwarz12 < precision_) continue;
+
+            engine.compute2<Operator::coulomb, BraKet::xs_xx, 0>(
+                dfbs_[P], unitshell, obs_[s1], obs_[s2], &dfpairs[P], &sp12);
+            if (buf[0] == nullptr) continue;  // screened out
+            ++nsignificant[thread_id];
+
+            std::copy(buf[0], buf[0] + dfbs_[P].size() * n12,
+                      blk + shell2bf_df[P] * n12);
+          }
+        }
+      };
+      run_threads(thread_main);
+    };
+
+    if (in_core()) {
+      data_.resize(size(), 0.0);
+      compute_batch(0, npairs, data_.data());
+    } else {
+      ShellBlockFileWriter writer(filename_);
+      std::vector<double> batch;
+      for (auto sp_first = 0ul; sp_first != npairs;) {
+        auto sp_last = sp_first + 1;
+        while (sp_last != npairs &&
+               offsets_[sp_last + 1] - offsets_[sp_first] <= batch_size_)
+          ++sp_last;
+        batch.assign(offsets_[sp_last] - offsets_[sp_first], 0.0);
+        compute_batch(sp_first, sp_last, batch.data());
+        for (auto sp = sp_first; sp != sp_last; ++sp)
+          writer.write(sp, batch.data() + offsets_[sp] - offsets_[sp_first],
+                       offsets_[sp + 1] - offsets_[sp]);
+        sp_first = sp_last;
+      }
+      writer.close();
+    }
+
+    for (auto n : nsignificant) nsignificant_ += n;
+  }
+};
+
+}  // namespace libint2
+
+#endif /* _libint2_src_lib_libint_dfintegralstore_h_ */
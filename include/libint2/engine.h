@@ -70,6 +70,8 @@
 
 namespace libint2 {
 
+class ShellPairDatabase;
+
 /// contracted Gaussian geminal = \f$ \sum_i c_i \exp(- \alpha r_{12}^2) \f$,
 /// represented as a vector of
 /// {\f$ \alpha_i \f$, \f$ c_i \f$ } pairs
@@ -450,7 +452,10 @@ class Engine {
         stack_size_(0),
         lmax_(-1),
         deriv_order_(0),
-        cartesian_shell_normalization_(CartesianShellNormalization::standard) {
+        cartesian_shell_normalization_(CartesianShellNormalization::standard),
+        charge_screening_(false),
+        rys_am_threshold_(std::numeric_limits<int>::max()),
+        rys_max_nprim_(std::numeric_limits<size_t>::max()) {
     set_precision(std::numeric_limits<scalar_type>::epsilon());
   }
 
@@ -500,6 +505,9 @@ class Engine {
         lmax_(max_l),
         deriv_order_(deriv_order),
         cartesian_shell_normalization_(CartesianShellNormalization::standard),
+        charge_screening_(false),
+        rys_am_threshold_(std::numeric_limits<int>::max()),
+        rys_max_nprim_(std::numeric_limits<size_t>::max()),
         params_(enforce_params_type(oper, params)) {
     set_precision(precision);
     assert(max_nprim > 0);
@@ -526,6 +534,9 @@ class Engine {
         precision_(other.precision_),
         ln_precision_(other.ln_precision_),
         cartesian_shell_normalization_(other.cartesian_shell_normalization_),
+        charge_screening_(other.charge_screening_),
+        rys_am_threshold_(other.rys_am_threshold_),
+        rys_max_nprim_(other.rys_max_nprim_),
         core_eval_pack_(std::move(other.core_eval_pack_)),
         params_(std::move(other.params_)),
         core_ints_params_(std::move(other.core_ints_params_)),
@@ -533,7 +544,8 @@ class Engine {
         set_targets_(other.set_targets_),
         scratch_(std::move(other.scratch_)),
         scratch2_(other.scratch2_),
-        buildfnptrs_(other.buildfnptrs_) {}
+        buildfnptrs_(other.buildfnptrs_),
+        costs_(other.costs_) {}
 
   /// (deep) copy constructor
   Engine(const Engine& other)
@@ -548,6 +560,9 @@ class Engine {
         precision_(other.precision_),
         ln_precision_(other.ln_precision_),
         cartesian_shell_normalization_(other.cartesian_shell_normalization_),
+        charge_screening_(other.charge_screening_),
+        rys_am_threshold_(other.rys_am_threshold_),
+        rys_max_nprim_(other.rys_max_nprim_),
         core_eval_pack_(other.core_eval_pack_),
         params_(other.params_),
         core_ints_params_(other.core_ints_params_) {
@@ -571,6 +586,9 @@ class Engine {
     precision_ = other.precision_;
     ln_precision_ = other.ln_precision_;
     cartesian_shell_normalization_ = other.cartesian_shell_normalization_;
+    charge_screening_ = other.charge_screening_;
+    rys_am_threshold_ = other.rys_am_threshold_;
+    rys_max_nprim_ = other.rys_max_nprim_;
     core_eval_pack_ = std::move(other.core_eval_pack_);
     params_ = std::move(other.params_);
     core_ints_params_ = std::move(other.core_ints_params_);
@@ -579,6 +597,7 @@ class Engine {
     scratch_ = std::move(other.scratch_);
     scratch2_ = other.scratch2_;
     buildfnptrs_ = other.buildfnptrs_;
+    costs_ = other.costs_;
     return *this;
   }
 
@@ -595,6 +614,9 @@ class Engine {
     precision_ = other.precision_;
     ln_precision_ = other.ln_precision_;
     cartesian_shell_normalization_ = other.cartesian_shell_normalization_;
+    charge_screening_ = other.charge_screening_;
+    rys_am_threshold_ = other.rys_am_threshold_;
+    rys_max_nprim_ = other.rys_max_nprim_;
     core_eval_pack_ = other.core_eval_pack_;
     params_ = other.params_;
     core_ints_params_ = other.core_ints_params_;
@@ -614,6 +636,9 @@ class Engine {
   /// @return the braket
   BraKet braket() const { return braket_; }
 
+  /// @return the order of geometric derivatives
+  int deriv_order() const { return deriv_order_; }
+
   /// (re)sets operator type to @c new_oper
   /// @param[in] new_oper Operator whose integrals will be computed with the next call to Engine::compute()
   /// @note this resets braket and params to their respective defaults for @c new_oper
@@ -653,15 +678,15 @@ class Engine {
 
   /// @return the maximum number of primitives that this engine can handle
   std::size_t max_nprim() const {
-    assert(spbra_.primpairs.size() == spket_.primpairs.size());
-    return static_cast<std::size_t>(std::sqrt(spbra_.primpairs.size()));
+    assert(spbra_.max_nprimpairs() == spket_.max_nprimpairs());
+    return static_cast<std::size_t>(std::sqrt(spbra_.max_nprimpairs()));
   }
 
   /// reset the maximum number of primitives
   /// @param[in] n the maximum number of primitives
   /// @note left unchanged if the value returned by Engine::max_nprim is greater than @c n
   Engine& set_max_nprim(std::size_t n) {
-    if (n*n > spbra_.primpairs.size()) {
+    if (n*n > spbra_.max_nprimpairs()) {
       spbra_.resize(n);
       spket_.resize(n);
       initialize(n);
@@ -707,6 +732,28 @@ class Engine {
   __libint2_engine_inline const target_ptr_vec& compute(
       const libint2::Shell& first_shell, const ShellPack&... rest_of_shells);
 
+  /// the estimated cost of computing a shell set with Engine::compute()
+  struct Cost {
+    double nflops = 0;            //!< the number of floating-point operations executed by the library code
+    std::size_t stack_bytes = 0;  //!< the size of the stack used by the library code, in bytes
+    std::size_t target_size = 0;  //!< the number of (Cartesian) integrals in each target shell set
+  };
+
+  /// Estimates the cost of computing target shell sets of integrals with Engine::compute(),
+  /// using the cost of each class reported by the library (see libint2_cost_<task> arrays)
+  /// and the number of primitive combinations that survive the screening done by compute().
+  /// @param first_shell,rest_of_shells the shells, as would be given to Engine::compute()
+  /// @return the estimated cost; all members are 0 if the cost is not known to the library
+  ///         (e.g. if the library was generated without cost tables) or if the shell set
+  ///         is screened out
+  /// @note only the flops executed by the generated code are counted, i.e. the cost of
+  ///       evaluating the primitive data (Boys function, etc.) is excluded; the classes computed
+  ///       by the Rys quadrature (see Engine::set_rys_am_threshold) are reported as if
+  ///       computed by the library
+  template <typename... ShellPack>
+  __libint2_engine_inline Cost estimated_cost(
+      const libint2::Shell& first_shell, const ShellPack&... rest_of_shells) const;
+
   /// Computes target shell sets of 1-body integrals.
   /// @param[in] s1
   /// @param[in] s2
@@ -751,6 +798,48 @@ class Engine {
                                                              const ShellPair* spbra,
                                                              const ShellPair* spket);
 
+  /// computes shell set of integrals of 2-body operator over the shell quartet formed by
+  /// a pair of shell pairs from a ShellPairDatabase
+  /// @param[in] spdb the shell pair database
+  /// @param[in] spbra the index of the bra shell pair in @c spdb
+  /// @param[in] spket the index of the ket shell pair in @c spdb
+  /// @sa Engine::compute2(const Shell&,const Shell&,const Shell&,const Shell&,const ShellPair*,const ShellPair*)
+  template <Operator oper, BraKet braket, size_t deriv_order>
+  __libint2_engine_inline const target_ptr_vec& compute2(const ShellPairDatabase& spdb,
+                                                         std::size_t spbra,
+                                                         std::size_t spket);
+
+  /// describes a single shell quartet (i.e. the arguments of one compute2() call) in a batch
+  /// processed by Engine::compute2_batch()
+  struct ShellQuartet {
+    const Shell* bra1;
+    const Shell* bra2;
+    const Shell* ket1;
+    const Shell* ket2;
+    const ShellPair* spbra;  //!< ShellPair data for {bra1,bra2}, may be nullptr
+    const ShellPair* spket;  //!< ShellPair data for {ket1,ket2}, may be nullptr
+  };
+
+  /// Computes shell sets of 2-body integrals for a batch of shell quartets of the same class.
+  /// All quartets must have identical angular momenta (and solid harmonics flags) of the
+  /// corresponding shells. ShellPair data that is not provided is computed once per run of
+  /// consecutive quartets sharing the same bra (ket) shell pair, hence loops with fixed bra
+  /// (or ket) do not recompute it for every quartet.
+  /// @tparam oper operator
+  /// @tparam braket the integral type
+  /// @tparam deriv_order the derivative order
+  /// @param[in] quartets pointer to the first of @c nquartets shell quartets; for brakets of rank
+  ///            less than 4 the missing shells should point to Shell::unit()
+  /// @param[in] nquartets the number of shell quartets in the batch
+  /// @param[out] result the integrals, packed quartet by quartet; the shell sets of quartet @c q start at
+  ///             @c result+q*nshellsets()*setsize , where @c setsize is the number of integrals in one shell set;
+  ///             shell sets of quartets that were screened out are zero-filled
+  /// @return the number of quartets that were not screened out
+  template <Operator oper, BraKet braket, size_t deriv_order>
+  __libint2_engine_inline size_t compute2_batch(const ShellQuartet* quartets,
+                                                size_t nquartets,
+                                                value_type* result);
+
   /** this specifies target precision for computing the integrals.
    * @param[in] prec the target precision
    * @note target precision \f$ \epsilon \f$ is used in 3 ways:
@@ -791,6 +880,60 @@ class Engine {
     return *this;
   }
 
+  /// @return true if the charge screening is enabled
+  /// @sa set_charge_screening(bool)
+  bool charge_screening() const { return charge_screening_; }
+
+  /// enables or disables screening of the charges of Operator::nuclear, Operator::erf_nuclear,
+  /// and Operator::erfc_nuclear (for non-derivative integrals only). If enabled, charge \f$ q \f$
+  /// located at \f$ \vec{C} \f$ is skipped if
+  /// \f$ |q| \sum_{12} 2 \pi |c_1 c_2| \exp(-\rho_{12} |AB|^2)/\gamma_{12} \min(1, \sqrt{\pi/(4 \gamma_{12} |PC|^2)}) \f$ ,
+  /// the estimate of its contribution to the \f$ (s|s) \f$ integral computed from the bound \f$ F_m(T) \leq F_0(T) \f$ ,
+  /// is smaller than the target precision. This is useful when there are many distant charges, e.g. in QM/MM.
+  /// @note the default is to not screen charges
+  /// @return reference to @c this for daisy-chaining
+  Engine& set_charge_screening(bool screen) {
+    charge_screening_ = screen;
+    return *this;
+  }
+
+  /// @return the total angular momentum of a shell quartet at and above which the Coulomb integrals
+  ///         are computed by the Rys quadrature
+  /// @sa set_rys_am_threshold(int)
+  int rys_am_threshold() const { return rys_am_threshold_; }
+
+  /// sets the crossover from the Obara-Saika/Head-Gordon-Pople code of the library to the Rys quadrature:
+  /// non-derivative integrals of Operator::coulomb over shell sets whose total angular momentum is at least
+  /// @c L are computed by the Rys quadrature, with the roots and weights interpolated by RysEval_Chebyshev7 .
+  /// The results have the same layout as those produced by the library.
+  /// @param[in] L the total angular momentum at and above which the Rys quadrature is used
+  /// @note the default is std::numeric_limits<int>::max(), i.e. the Rys quadrature is not used
+  /// @return reference to @c this for daisy-chaining
+  Engine& set_rys_am_threshold(int L) {
+    rys_am_threshold_ = L;
+    return *this;
+  }
+
+  /// @return the largest number of primitive quartets of a shell quartet whose Coulomb integrals
+  ///         are computed by the Rys quadrature
+  /// @sa set_rys_max_nprim(size_t)
+  size_t rys_max_nprim() const { return rys_max_nprim_; }
+
+  /// limits the use of the Rys quadrature (see set_rys_am_threshold(int)) to shell quartets with few primitives.
+  /// The two methods contract the primitive integrals at different points: the Rys quadrature
+  /// evaluates every primitive quartet all the way to the target integrals and contracts them at the end,
+  /// whereas the code of the library contracts the \f$ (e0|f0) \f$ integrals produced by the VRR and
+  /// applies the HRR once per contracted quartet. Hence the latter is more efficient for
+  /// highly contracted shells, and the former for (nearly) uncontracted shells.
+  /// @param[in] n the largest product of the numbers of primitives of the four shells for which the Rys quadrature is used;
+  ///            quartets with more primitives are computed by the library
+  /// @note the default is std::numeric_limits<size_t>::max(), i.e. the choice only depends on the angular momentum
+  /// @return reference to @c this for daisy-chaining
+  Engine& set_rys_max_nprim(size_t n) {
+    rys_max_nprim_ = n;
+    return *this;
+  }
+
   /// prints the contents of timers to @c os
   void print_timers(std::ostream& os = std::cout) {
 #ifdef LIBINT2_ENGINE_TIMERS
@@ -874,6 +1017,12 @@ class Engine {
 
   // specifies the normalization convention for Cartesian Gaussians
   CartesianShellNormalization cartesian_shell_normalization_;
+  // if true, charges of *nuclear operators whose contributions are negligible are skipped
+  bool charge_screening_;
+  // the Coulomb integrals of shell sets with total angular momentum at least this large are computed by the Rys quadrature
+  int rys_am_threshold_;
+  // ... but only if the shells have at most this many primitive quartets
+  size_t rys_max_nprim_;
 
   any core_eval_pack_;
 
@@ -902,6 +1051,35 @@ class Engine {
   // primdata_[0].stack
   typedef void (*buildfnptr_t)(const Libint_t*);
   buildfnptr_t* buildfnptrs_;
+  const Libint2_ClassCost* costs_;  // same layout as buildfnptrs_
+
+  /// @return the index of the build function (and of its cost) for the given angular momenta
+  ///         of the 2-body shell set in canonical order
+  __libint2_engine_inline size_t buildfnidx2(int l1, int l2, int l3, int l4) const;
+  __libint2_engine_inline Cost estimated_cost1(const Shell& s1, const Shell& s2) const;
+  __libint2_engine_inline Cost estimated_cost2(const Shell& tbra1, const Shell& tbra2,
+                                               const Shell& tket1, const Shell& tket2) const;
+
+  /// Boys function arguments, prefactors, and values for the primitive quartets
+  /// of the current shell set; used by compute2() to evaluate the Boys function in one batch
+  std::vector<scalar_type> boys_T_, boys_pfac_, boys_Fm_;
+
+  /// the data of a primitive quartet used by the Rys quadrature, in the notation of the Obara-Saika
+  /// recurrence relations; the Boys function argument and the prefactor are kept in boys_T_ and boys_pfac_
+  struct RysPrimData {
+    scalar_type PA[3], QC[3], WP[3], WQ[3];
+    scalar_type oo2z, oo2e, oo2ze, roz, roe;
+  };
+  std::vector<RysPrimData> rys_primdata_;
+  /// 1-d integrals for each Cartesian direction and root, used by compute2_rys()
+  std::vector<scalar_type> rys_scratch_;
+
+  /// computes the Cartesian shell set of Coulomb integrals over the primitive quartets in boys_T_,
+  /// boys_pfac_, and rys_primdata_ (the first @c nprimquartets) by the Rys quadrature
+  /// @param[out] result the integrals, in the layout of the shell sets computed by the library
+  __libint2_engine_inline void compute2_rys(const Shell& bra1, const Shell& bra2,
+                                            const Shell& ket1, const Shell& ket2,
+                                            size_t nprimquartets, value_type* result);
 
   /// reports the number of shell sets that each call to compute() produces.
   unsigned int compute_nshellsets() const {
@@ -940,6 +1118,21 @@ class Engine {
                                                 const Shell& s2, size_t p1,
                                                 size_t p2, size_t oset);
 
+  /// computes the data of primitive pair @c pp of @c sp and charge @c oset of
+  /// a (non-derivative) *nuclear operator; the pair data is taken from @c sp
+  __libint2_engine_inline void compute_primdata_nuclear(Libint_t& primdata,
+                                                        const Shell& s1,
+                                                        const Shell& s2,
+                                                        const ShellPair& sp,
+                                                        size_t pp, size_t oset);
+
+  /// @return true if the estimated magnitude of the contribution of charge @c oset
+  ///         to the integrals over the primitive pairs of @c sp is below the target precision
+  __libint2_engine_inline bool charge_is_negligible(const Shell& s1,
+                                                    const Shell& s2,
+                                                    const ShellPair& sp,
+                                                    size_t oset) const;
+
   /// 3-dim array of pointers to help dispatch efficiently based on oper_,
   /// braket_, and deriv_order_
   __libint2_engine_inline const std::vector<Engine::compute2_ptr_type>&
@@ -988,5 +1181,7 @@ class Engine {
 #include "./engine.impl.h"
 #endif
 
+#include <libint2/shellpair_database.h>
+
 #endif /* _libint2_src_lib_libint_engine_h_ */
 
@@ -31,6 +31,7 @@
 #pragma GCC diagnostic pop
 
 #include <libint2/boys.h>
+#include <libint2/rys.h>
 #if LIBINT_HAS_SYSTEM_BOOST_PREPROCESSOR_VARIADICS
 # include <boost/preprocessor.hpp>
 # include <boost/preprocessor/facilities/is_1.hpp>
@@ -165,6 +166,30 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute(
   return targets_;
 }
 
+template <typename... ShellPack>
+__libint2_engine_inline Engine::Cost Engine::estimated_cost(
+    const libint2::Shell& first_shell, const ShellPack&... rest_of_shells) const {
+  constexpr auto nargs = 1 + sizeof...(rest_of_shells);
+  assert(nargs == braket_rank() && "# of arguments to estimated_cost() does not match the braket type");
+
+  std::array<std::reference_wrapper<const Shell>, nargs> shells{{
+      first_shell, rest_of_shells...}};
+
+  if (operator_rank() == 1) {
+    if (nargs == 2) return estimated_cost1(shells[0], shells[1]);
+  } else if (operator_rank() == 2) {
+    if (nargs == 2)
+      return estimated_cost2(shells[0], Shell::unit(), shells[1], Shell::unit());
+    if (nargs == 3)
+      return estimated_cost2(shells[0], Shell::unit(), shells[1], shells[2]);
+    if (nargs == 4)
+      return estimated_cost2(shells[0], shells[1], shells[2], shells[3]);
+  }
+
+  assert(false && "missing feature");  // only reached if missing a feature
+  return Cost();
+}
+
 /// Computes target shell sets of 1-body integrals.
 /// @return vector of pointers to target shell sets, the number of sets =
 /// Engine::nshellsets()
@@ -255,15 +280,45 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute1(
     std::fill(std::begin(scratch_),
               std::begin(scratch_) + num_shellsets_computed * ncart12, 0.0);
 
+  // for non-derivative integrals of *nuclear operators libint accumulates the
+  // contributions of a batch of charges, as if each {primitive pair, charge}
+  // combination were a primitive pair; the primitive pair data is computed once
+  const auto batch_charges = oper_is_nuclear && deriv_order_ == 0;
+  if (batch_charges) spbra_.init(s1, s2, ln_precision_);
+  const auto ncharges_per_batch =
+      batch_charges
+          ? std::max(primdata_.size() /
+                         std::max(spbra_.nprimpairs(), std::size_t(1)),
+                     std::size_t(1))
+          : std::size_t(1);
+  bool accumulated = false;  // true once ints have been accumulated in scratch
+  // if all charges are screened out the result is the zeroed scratch
+  if (batch_charges && charge_screening_ && !compute_directly) set_targets = true;
+
   // loop over accumulation batches
-  for (auto pset = 0u; pset != nparam_sets; ++pset) {
+  for (auto pset = 0u; pset < nparam_sets; pset += ncharges_per_batch) {
     if (!oper_is_nuclear)
       assert(nparam_sets == 1 && "unexpected number of operator parameters");
 
     auto p12 = 0;
-    for (auto p1 = 0; p1 != nprim1; ++p1) {
-      for (auto p2 = 0; p2 != nprim2; ++p2, ++p12) {
-        compute_primdata(primdata_[p12], s1, s2, p1, p2, pset);
+    if (batch_charges) {
+      const auto pset_fence =
+          std::min<std::size_t>(pset + ncharges_per_batch, nparam_sets);
+      const auto nprimpairs12 = spbra_.nprimpairs();
+      for (auto c = pset; c != pset_fence; ++c) {
+        if (charge_screening_ && charge_is_negligible(s1, s2, spbra_, c))
+          continue;
+        for (auto pp = 0ul; pp != nprimpairs12; ++pp, ++p12) {
+          compute_primdata_nuclear(primdata_[p12], s1, s2, spbra_, pp, c);
+        }
+      }
+      // nothing to compute for this batch
+      if (p12 == 0) continue;
+    } else {
+      for (auto p1 = 0; p1 != nprim1; ++p1) {
+        for (auto p2 = 0; p2 != nprim2; ++p2, ++p12) {
+          compute_primdata(primdata_[p12], s1, s2, p1, p2, pset);
+        }
       }
     }
     primdata_[0].contrdepth = p12;
@@ -304,13 +359,14 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute1(
           // accumulated targets in scratch
           auto s_target = &scratch_[0];
           for (auto s = 0; s != ntargets; ++s, s_target += ncart12)
-            if (pset != 0)
+            if (accumulated)
               std::transform(primdata_[0].targets[s],
                              primdata_[0].targets[s] + ncart12, s_target,
                              s_target, std::plus<value_type>());
             else
               std::copy(primdata_[0].targets[s],
                         primdata_[0].targets[s] + ncart12, s_target);
+          accumulated = true;
         }
 
         // 2. reconstruct derivatives of nuclear ints for each nucleus
@@ -620,6 +676,8 @@ __libint2_engine_inline void Engine::_initialize() {
     (&primdata_[0], primdata_.size()), BOOST_PP_EMPTY());                      \
     buildfnptrs_ = to_ptr1(LIBINT2_PREFIXED_NAME(BOOST_PP_CAT(                 \
         libint2_build_, BOOST_PP_NBODYENGINE_MCR3_TASK(product))));            \
+    costs_ = to_ptr1(LIBINT2_PREFIXED_NAME(BOOST_PP_CAT(                       \
+        libint2_cost_, BOOST_PP_NBODYENGINE_MCR3_TASK(product))));             \
     reset_scratch();                                                           \
     return;                                                                    \
   }
@@ -664,7 +722,15 @@ __libint2_engine_inline void Engine::initialize(size_t max_nprim) {
   // initialize braket, if needed
   if (braket_ == BraKet::invalid) braket_ = default_braket(oper_);
 
-  if (max_nprim != 0) primdata_.resize(std::pow(max_nprim, braket_rank()));
+  if (max_nprim != 0) {
+    std::size_t nprimdata = std::pow(max_nprim, braket_rank());
+    // non-derivative integrals of *nuclear operators are computed for multiple charges
+    // at once, make room for at least 256 {primitive pair, charge} combinations
+    if ((oper_ == Operator::nuclear || oper_ == Operator::erf_nuclear ||
+         oper_ == Operator::erfc_nuclear) && deriv_order_ == 0)
+      nprimdata = std::max(nprimdata, std::size_t(256));
+    primdata_.resize(nprimdata);
+  }
 
   // initialize targets
   {
@@ -1083,6 +1149,312 @@ __libint2_engine_inline void Engine::compute_primdata(Libint_t& primdata, const
   }
 }  // Engine::compute_primdata()
 
+__libint2_engine_inline void Engine::compute_primdata_nuclear(
+    Libint_t& primdata, const Shell& s1, const Shell& s2, const ShellPair& sp,
+    size_t pp, size_t oset) {
+  assert(deriv_order_ == 0);
+  const auto& A = s1.O;
+  const auto& B = s2.O;
+
+  const auto p1 = sp.p1()[pp];
+  const auto p2 = sp.p2()[pp];
+  const auto alpha1 = s1.alpha[p1];
+  const auto alpha2 = s2.alpha[p2];
+  const auto c1 = s1.contr[0].coeff[p1];
+  const auto c2 = s2.contr[0].coeff[p2];
+
+  const auto gammap = alpha1 + alpha2;
+  const auto oogammap = sp.one_over_gamma()[pp];
+  const auto rhop = alpha1 * alpha2 * oogammap;
+  const auto Px = sp.P(0)[pp];
+  const auto Py = sp.P(1)[pp];
+  const auto Pz = sp.P(2)[pp];
+
+  // see compute_primdata() ; only the quantities used by the *nuclear build functions are needed
+  const auto l1 = s1.contr[0].l;
+  const auto l2 = s2.contr[0].l;
+  const bool use_hrr = l1 > 0 && l2 > 0;
+  const bool hrr_ket_to_bra = l1 >= l2;
+  if (use_hrr) {
+    if (hrr_ket_to_bra) {
+#if LIBINT2_DEFINED(eri, AB_x)
+    primdata.AB_x[0] = sp.AB[0];
+#endif
+#if LIBINT2_DEFINED(eri, AB_y)
+    primdata.AB_y[0] = sp.AB[1];
+#endif
+#if LIBINT2_DEFINED(eri, AB_z)
+    primdata.AB_z[0] = sp.AB[2];
+#endif
+    }
+    else {
+#if LIBINT2_DEFINED(eri, BA_x)
+    primdata.BA_x[0] = - sp.AB[0];
+#endif
+#if LIBINT2_DEFINED(eri, BA_y)
+    primdata.BA_y[0] = - sp.AB[1];
+#endif
+#if LIBINT2_DEFINED(eri, BA_z)
+    primdata.BA_z[0] = - sp.AB[2];
+#endif
+    }
+  }
+
+#if LIBINT2_DEFINED(eri, PA_x)
+  primdata.PA_x[0] = Px - A[0];
+#endif
+#if LIBINT2_DEFINED(eri, PA_y)
+  primdata.PA_y[0] = Py - A[1];
+#endif
+#if LIBINT2_DEFINED(eri, PA_z)
+  primdata.PA_z[0] = Pz - A[2];
+#endif
+#if LIBINT2_DEFINED(eri, PB_x)
+  primdata.PB_x[0] = Px - B[0];
+#endif
+#if LIBINT2_DEFINED(eri, PB_y)
+  primdata.PB_y[0] = Py - B[1];
+#endif
+#if LIBINT2_DEFINED(eri, PB_z)
+  primdata.PB_z[0] = Pz - B[2];
+#endif
+
+#if LIBINT2_DEFINED(eri, oo2z)
+  primdata.oo2z[0] = 0.5 * oogammap;
+#endif
+
+  const auto& params = (oper_ == Operator::nuclear) ?
+      any_cast<const operator_traits<Operator::nuclear>::oper_params_type&>(params_) :
+      std::get<1>(any_cast<const operator_traits<Operator::erfc_nuclear>::oper_params_type&>(params_));
+
+  const auto& C = params[oset].second;
+  const auto& q = params[oset].first;
+#if LIBINT2_DEFINED(eri, PC_x) && LIBINT2_DEFINED(eri, PC_y) && \
+    LIBINT2_DEFINED(eri, PC_z)
+  primdata.PC_x[0] = Px - C[0];
+  primdata.PC_y[0] = Py - C[1];
+  primdata.PC_z[0] = Pz - C[2];
+  const auto PC2 = primdata.PC_x[0] * primdata.PC_x[0] +
+                   primdata.PC_y[0] * primdata.PC_y[0] +
+                   primdata.PC_z[0] * primdata.PC_z[0];
+  const scalar_type U = gammap * PC2;
+  const scalar_type rho = rhop;
+  const auto mmax = l1 + l2;
+  auto* fm_ptr = &(primdata.LIBINT_T_S_ELECPOT_S(0)[0]);
+  if (oper_ == Operator::nuclear) {
+    auto fm_engine_ptr =
+        any_cast<const detail::core_eval_pack_type<Operator::nuclear>&>(core_eval_pack_)
+        .first();
+    fm_engine_ptr->eval(fm_ptr, U, mmax);
+  } else if (oper_ == Operator::erf_nuclear) {
+    const auto& core_eval_ptr =
+        any_cast<const detail::core_eval_pack_type<Operator::erf_nuclear>&>(core_eval_pack_)
+          .first();
+    auto core_ints_params =
+        std::get<0>(any_cast<const typename operator_traits<
+          Operator::erf_nuclear>::oper_params_type&>(core_ints_params_));
+    core_eval_ptr->eval(fm_ptr, rho, U, mmax, core_ints_params);
+  } else if (oper_ == Operator::erfc_nuclear) {
+    const auto& core_eval_ptr =
+        any_cast<const detail::core_eval_pack_type<Operator::erfc_nuclear>&>(core_eval_pack_)
+          .first();
+    auto core_ints_params =
+        std::get<0>(any_cast<const typename operator_traits<
+          Operator::erfc_nuclear>::oper_params_type&>(core_ints_params_));
+    core_eval_ptr->eval(fm_ptr, rho, U, mmax, core_ints_params);
+  }
+
+  // same as the prefactor in compute_primdata() since
+  // sqrt(gamma) (2/sqrt(pi)) (pi/gamma)^{3/2} exp(-rho |AB|^2) = 2 pi K
+  decltype(U) two_PI(6.28318530717958647692528676656);
+  const auto pfac = -q * two_PI * sp.K()[pp] * c1 * c2;
+  const auto m_fence = mmax + 1;
+  for (auto m = 0; m != m_fence; ++m) {
+    fm_ptr[m] *= pfac;
+  }
+#endif
+}  // Engine::compute_primdata_nuclear()
+
+__libint2_engine_inline bool Engine::charge_is_negligible(
+    const Shell& s1, const Shell& s2, const ShellPair& sp, size_t oset) const {
+  const auto& params = (oper_ == Operator::nuclear) ?
+      any_cast<const operator_traits<Operator::nuclear>::oper_params_type&>(params_) :
+      std::get<1>(any_cast<const operator_traits<Operator::erfc_nuclear>::oper_params_type&>(params_));
+  const auto& C = params[oset].second;
+  using std::abs;
+  using std::sqrt;
+  const auto abs_q = abs(params[oset].first);
+
+  // F_0(T) <= min(1, sqrt(pi/(4T)))
+  const scalar_type two_PI(6.28318530717958647692528676656);
+  const scalar_type PI_over_4(0.785398163397448309615660845820);
+  scalar_type bound = 0;
+  for (auto pp = 0ul; pp != sp.nprimpairs(); ++pp) {
+    const auto p1 = sp.p1()[pp];
+    const auto p2 = sp.p2()[pp];
+    const auto PCx = sp.P(0)[pp] - C[0];
+    const auto PCy = sp.P(1)[pp] - C[1];
+    const auto PCz = sp.P(2)[pp] - C[2];
+    const auto T = (s1.alpha[p1] + s2.alpha[p2]) * (PCx * PCx + PCy * PCy + PCz * PCz);
+    const auto F0_bound = (T > PI_over_4) ? sqrt(PI_over_4 / T) : scalar_type(1);
+    bound += two_PI * abs(sp.K()[pp] * s1.contr[0].coeff[p1] * s2.contr[0].coeff[p2]) * F0_bound;
+  }
+  return abs_q * bound < precision_;
+}
+
+__libint2_engine_inline size_t Engine::buildfnidx2(int l1, int l2, int l3,
+                                                   int l4) const {
+  switch (braket_) {
+    case BraKet::xx_xx:
+      return ((l1 * hard_lmax_ + l2) * hard_lmax_ + l3) * hard_lmax_ + l4;
+
+    case BraKet::xx_xs: assert(false && "this braket is not supported"); break;
+    case BraKet::xs_xx: {
+      /// lmax might be center dependent
+      int ket_lmax = hard_lmax_;
+      switch (deriv_order_) {
+        case 0:
+#ifdef LIBINT2_CENTER_DEPENDENT_MAX_AM_3eri
+          ket_lmax = hard_default_lmax_;
+#endif
+          break;
+        case 1:
+#ifdef LIBINT2_CENTER_DEPENDENT_MAX_AM_3eri1
+          ket_lmax = hard_default_lmax_;
+#endif
+          break;
+        case 2:
+#ifdef LIBINT2_CENTER_DEPENDENT_MAX_AM_3eri2
+          ket_lmax = hard_default_lmax_;
+#endif
+          break;
+        default:assert(false && "deriv_order>2 not yet supported");
+      }
+      return (l1 * ket_lmax + l3) * ket_lmax + l4;
+    }
+
+    case BraKet::xs_xs:
+      return l1 * hard_lmax_ + l3;
+
+    default:
+      assert(false && "invalid braket");
+  }
+  return 0;
+}
+
+__libint2_engine_inline Engine::Cost Engine::estimated_cost1(
+    const Shell& s1, const Shell& s2) const {
+  assert((s1.ncontr() == 1 && s2.ncontr() == 1) &&
+         "generally-contracted shells not yet supported");
+  const auto l1 = s1.contr[0].l;
+  const auto l2 = s2.contr[0].l;
+  assert(l1 <= lmax_ && "the angular momentum limit is exceeded");
+  assert(l2 <= lmax_ && "the angular momentum limit is exceeded");
+
+  const auto oper_is_nuclear =
+      (oper_ == Operator::nuclear || oper_ == Operator::erf_nuclear ||
+       oper_ == Operator::erfc_nuclear);
+  const auto nparam_sets = nparams();
+
+  // count the calls to the build function and the primitive combinations
+  // processed by them, as done by compute1()
+  std::size_t ncalls = 0;
+  std::size_t nprims = 0;
+  const auto batch_charges = oper_is_nuclear && deriv_order_ == 0;
+  if (batch_charges) {
+    const ShellPair sp(s1, s2, ln_precision_);
+    const auto npp = sp.nprimpairs();
+    const auto ncharges_per_batch = std::max(
+        primdata_.size() / std::max(npp, std::size_t(1)), std::size_t(1));
+    for (auto pset = 0u; pset < nparam_sets; pset += ncharges_per_batch) {
+      const auto pset_fence =
+          std::min<std::size_t>(pset + ncharges_per_batch, nparam_sets);
+      std::size_t nprims_batch = 0;
+      for (auto c = pset; c != pset_fence; ++c) {
+        if (charge_screening_ && charge_is_negligible(s1, s2, sp, c))
+          continue;
+        nprims_batch += npp;
+      }
+      if (nprims_batch != 0) {
+        ++ncalls;
+        nprims += nprims_batch;
+      }
+    }
+  } else {
+    ncalls = nparam_sets;
+    nprims = nparam_sets * s1.nprim() * s2.nprim();
+  }
+  if (ncalls == 0) return Cost();
+
+  const auto& cost = costs_[l1 * hard_lmax_ + l2];
+  Cost result;
+  result.nflops = static_cast<double>(ncalls) * cost.nflops_shellset +
+                  static_cast<double>(nprims) * cost.nflops_primitive;
+  result.stack_bytes = cost.stack_size * LIBINT2_MAX_VECLEN * sizeof(value_type);
+  result.target_size = cost.target_size;
+  return result;
+}
+
+__libint2_engine_inline Engine::Cost Engine::estimated_cost2(
+    const Shell& tbra1, const Shell& tbra2, const Shell& tket1,
+    const Shell& tket2) const {
+  assert((tbra1.ncontr() == 1 && tbra2.ncontr() == 1 && tket1.ncontr() == 1 &&
+          tket2.ncontr() == 1) && "generally-contracted shells are not yet supported");
+
+  // permute the shells to the canonical order, as done by compute2()
+#if LIBINT2_SHELLQUARTET_SET == \
+    LIBINT2_SHELLQUARTET_SET_STANDARD  // standard angular momentum ordering
+  const auto swap_tbra = (tbra1.contr[0].l < tbra2.contr[0].l);
+  const auto swap_tket = (tket1.contr[0].l < tket2.contr[0].l);
+  const auto swap_braket =
+      ((braket_ == BraKet::xx_xx) && (tbra1.contr[0].l + tbra2.contr[0].l >
+                                     tket1.contr[0].l + tket2.contr[0].l)) ||
+        braket_ == BraKet::xx_xs;
+#else  // orca angular momentum ordering
+  const auto swap_tbra = (tbra1.contr[0].l > tbra2.contr[0].l);
+  const auto swap_tket = (tket1.contr[0].l > tket2.contr[0].l);
+  const auto swap_braket =
+      ((braket_ == BraKet::xx_xx) && (tbra1.contr[0].l + tbra2.contr[0].l <
+                                     tket1.contr[0].l + tket2.contr[0].l)) ||
+        braket_ == BraKet::xx_xs;
+#endif
+  const auto& bra1 =
+      swap_braket ? (swap_tket ? tket2 : tket1) : (swap_tbra ? tbra2 : tbra1);
+  const auto& bra2 =
+      swap_braket ? (swap_tket ? tket1 : tket2) : (swap_tbra ? tbra1 : tbra2);
+  const auto& ket1 =
+      swap_braket ? (swap_tbra ? tbra2 : tbra1) : (swap_tket ? tket2 : tket1);
+  const auto& ket2 =
+      swap_braket ? (swap_tbra ? tbra1 : tbra2) : (swap_tket ? tket1 : tket2);
+
+  // count the primitive quartets that survive the screening in compute2()
+  const ShellPair spbra(bra1, bra2, ln_precision_);
+  const ShellPair spket(ket1, ket2, ln_precision_);
+  const auto npbra = spbra.nprimpairs();
+  const auto npket = spket.nprimpairs();
+  const auto* scr_bra = spbra.scr();
+  const auto* scr_ket = spket.scr();
+  std::size_t nprims = 0;
+  for (auto pb = 0ul; pb != npbra; ++pb) {
+    if (npket == 0 || !(scr_bra[pb] + scr_ket[0] > ln_precision_))
+      break;
+    for (auto pk = 0ul; pk != npket; ++pk, ++nprims) {
+      if (!(scr_bra[pb] + scr_ket[pk] > ln_precision_))
+        break;
+    }
+  }
+  if (nprims == 0) return Cost();
+
+  const auto& cost = costs_[buildfnidx2(bra1.contr[0].l, bra2.contr[0].l,
+                                        ket1.contr[0].l, ket2.contr[0].l)];
+  Cost result;
+  result.nflops = cost.nflops_shellset +
+                  static_cast<double>(nprims) * cost.nflops_primitive;
+  result.stack_bytes = cost.stack_size * LIBINT2_MAX_VECLEN * sizeof(value_type);
+  result.target_size = cost.target_size;
+  return result;
+}
+
 /// computes shell set of integrals of 2-body operator
 /// \note result is stored in the "chemists"/Mulliken form, (tbra1 tbra2 |tket1
 /// tket2), i.e. bra and ket are in chemists meaning; result is packed in
@@ -1162,6 +1534,14 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
   const auto lmax_bra = std::max(bra1.contr[0].l, bra2.contr[0].l);
   const auto lmax_ket = std::max(ket1.contr[0].l, ket2.contr[0].l);
 
+  // use the Rys quadrature instead of the library?
+  // N.B. the library contracts before HRR, the Rys quadrature after assembling each primitive quartet,
+  //      hence the latter only pays off for shells with few primitives
+  const auto use_rys = oper_ == Operator::coulomb && deriv_order == 0 && lmax != 0 &&
+                       bra1.contr[0].l + bra2.contr[0].l + ket1.contr[0].l +
+                               ket2.contr[0].l >= rys_am_threshold_ &&
+                       static_cast<size_t>(nprim_bra1) * nprim_bra2 * nprim_ket1 * nprim_ket2 <= rys_max_nprim_;
+
 #ifdef LIBINT2_ENGINE_PROFILE_CLASS
   class_id id(bra1.contr[0].l, bra2.contr[0].l, ket1.contr[0].l,
               ket2.contr[0].l);
@@ -1210,13 +1590,28 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
     const auto& D = ket2.O;
 
     // compute all primitive quartet data
-    const auto npbra = spbra.primpairs.size();
-    const auto npket = spket.primpairs.size();
+    // primitive pairs are sorted by descending screening factors, hence
+    // the loops stop at the first primitive quartet that fails the screening test
+    const auto npbra = spbra.nprimpairs();
+    const auto npket = spket.nprimpairs();
+    const auto* scr_bra = spbra.scr();
+    const auto* scr_ket = spket.scr();
+    // for the Coulomb operator the Boys function of all primitive quartets is evaluated at once
+    const auto batch_boys = (oper_ == Operator::coulomb) && !skip_core_ints && !use_rys;
+    if ((batch_boys || use_rys) && boys_T_.size() < npbra * npket) {
+      boys_T_.resize(npbra * npket);
+      boys_pfac_.resize(npbra * npket);
+    }
+    if (use_rys && rys_primdata_.size() < npbra * npket)
+      rys_primdata_.resize(npbra * npket);
     for (auto pb = 0; pb != npbra; ++pb) {
+      if (npket == 0 || !(scr_bra[pb] + scr_ket[0] > ln_precision_))
+        break;
       for (auto pk = 0; pk != npket; ++pk) {
         // primitive quartet screening
-        if (spbra.primpairs[pb].scr + spket.primpairs[pk].scr >
-            ln_precision_) {
+        if (!(scr_bra[pb] + scr_ket[pk] > ln_precision_))
+          break;
+        {
           Libint_t& primdata = primdata_[p];
           const auto& sbra1 = bra1;
           const auto& sbra2 = bra2;
@@ -1225,13 +1620,11 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
           auto pbra = pb;
           auto pket = pk;
 
-          const auto& spbrapp = spbra.primpairs[pbra];
-          const auto& spketpp = spket.primpairs[pket];
           // if shell-pair data given by user
-          const auto& pbra1 = spbra_is_swapped ? spbrapp.p2 : spbrapp.p1;
-          const auto& pbra2 = spbra_is_swapped ? spbrapp.p1 : spbrapp.p2;
-          const auto& pket1 = spket_is_swapped ? spketpp.p2 : spketpp.p1;
-          const auto& pket2 = spket_is_swapped ? spketpp.p1 : spketpp.p2;
+          const auto& pbra1 = spbra_is_swapped ? spbra.p2()[pbra] : spbra.p1()[pbra];
+          const auto& pbra2 = spbra_is_swapped ? spbra.p1()[pbra] : spbra.p2()[pbra];
+          const auto& pket1 = spket_is_swapped ? spket.p2()[pket] : spket.p1()[pket];
+          const auto& pket2 = spket_is_swapped ? spket.p1()[pket] : spket.p2()[pket];
 
           const auto alpha0 = sbra1.alpha[pbra1];
           const auto alpha1 = sbra2.alpha[pbra2];
@@ -1247,21 +1640,21 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
                              sbra2.contr[0].l + sket2.contr[0].l;
 
           const auto gammap = alpha0 + alpha1;
-          const auto oogammap = spbrapp.one_over_gamma;
+          const auto oogammap = spbra.one_over_gamma()[pbra];
           const auto rhop = alpha0 * alpha1 * oogammap;
 
           const auto gammaq = alpha2 + alpha3;
-          const auto oogammaq = spketpp.one_over_gamma;
+          const auto oogammaq = spket.one_over_gamma()[pket];
           const auto rhoq = alpha2 * alpha3 * oogammaq;
 
-          const auto& P = spbrapp.P;
-          const auto& Q = spketpp.P;
+          const real_t P[3] = {spbra.P(0)[pbra], spbra.P(1)[pbra], spbra.P(2)[pbra]};
+          const real_t Q[3] = {spket.P(0)[pket], spket.P(1)[pket], spket.P(2)[pket]};
           const auto PQx = P[0] - Q[0];
           const auto PQy = P[1] - Q[1];
           const auto PQz = P[2] - Q[2];
           const auto PQ2 = PQx * PQx + PQy * PQy + PQz * PQz;
 
-          const auto K12 = spbrapp.K * spketpp.K;
+          const auto K12 = spbra.K()[pbra] * spket.K()[pket];
           decltype(K12) two_times_M_PI_to_25(
               34.986836655249725693);  // (2 \pi)^{5/2}
           const auto gammapq = gammap + gammaq;
@@ -1273,16 +1666,36 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
           if (std::abs(pfac) >= precision_) {
             const scalar_type rho = gammap * gammaq * oogammapq;
             const scalar_type T = PQ2 * rho;
+
+            // the Rys quadrature needs only the data of the recurrence relations for the 2-d integrals
+            if (use_rys) {
+              boys_T_[p] = T;
+              boys_pfac_[p] = pfac;
+              auto& rysdata = rys_primdata_[p];
+              const real_t PQ[3] = {PQx, PQy, PQz};
+              for (auto xyz = 0; xyz != 3; ++xyz) {
+                rysdata.PA[xyz] = P[xyz] - A[xyz];
+                rysdata.QC[xyz] = Q[xyz] - C[xyz];
+                rysdata.WP[xyz] = -gammaq * oogammapq * PQ[xyz];
+                rysdata.WQ[xyz] = gammap * oogammapq * PQ[xyz];
+              }
+              rysdata.oo2z = 0.5 * oogammap;
+              rysdata.oo2e = 0.5 * oogammaq;
+              rysdata.oo2ze = 0.5 * oogammapq;
+              rysdata.roz = rho * oogammap;
+              rysdata.roe = rho * oogammaq;
+              ++p;
+              continue;
+            }
+
             auto* gm_ptr = &(primdata.LIBINT_T_SS_EREP_SS(0)[0]);
             const auto mmax = amtot + deriv_order;
 
             if (!skip_core_ints) {
               switch (oper_) {
                 case Operator::coulomb: {
-                  const auto& core_eval_ptr =
-                      any_cast<const detail::core_eval_pack_type<Operator::coulomb>&>(core_eval_pack_)
-                          .first();
-                  core_eval_ptr->eval(gm_ptr, T, mmax);
+                  boys_T_[p] = T;
+                  boys_pfac_[p] = pfac;
                 } break;
                 case Operator::cgtg_x_coulomb: {
                   const auto& core_eval_ptr =
@@ -1371,8 +1784,10 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
               }
             }
 
-            for (auto m = 0; m != mmax + 1; ++m) {
-              gm_ptr[m] *= pfac;
+            if (!batch_boys) {
+              for (auto m = 0; m != mmax + 1; ++m) {
+                gm_ptr[m] *= pfac;
+              }
             }
 
             if (mmax != 0) {
@@ -1628,6 +2043,25 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
       }    // ket prim pair
     }      // bra prim pair
     primdata_[0].contrdepth = p;
+
+    if (batch_boys && p != 0) {
+      const auto mmax = bra1.contr[0].l + bra2.contr[0].l + ket1.contr[0].l +
+                        ket2.contr[0].l + deriv_order;
+      const auto& core_eval_ptr =
+          any_cast<const detail::core_eval_pack_type<Operator::coulomb>&>(core_eval_pack_)
+              .first();
+      if (boys_Fm_.size() < static_cast<size_t>(p * (mmax + 1)))
+        boys_Fm_.resize(p * (mmax + 1));
+      core_eval_ptr->eval(boys_Fm_.data(), boys_T_.data(), p, mmax);
+      for (auto q = 0; q != p; ++q) {
+        auto* gm_ptr = &(primdata_[q].LIBINT_T_SS_EREP_SS(0)[0]);
+        const auto* fm_ptr = boys_Fm_.data() + q * (mmax + 1);
+        const auto pfac = boys_pfac_[q];
+        for (auto m = 0; m != mmax + 1; ++m) {
+          gm_ptr[m] = fm_ptr[m] * pfac;
+        }
+      }
+    }
   }
 
 #ifdef LIBINT2_ENGINE_TIMERS
@@ -1675,52 +2109,20 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
     timers.start(1);
 #endif
 
-    size_t buildfnidx;
-    switch (braket_) {
-      case BraKet::xx_xx:
-        buildfnidx =
-            ((bra1.contr[0].l * hard_lmax_ + bra2.contr[0].l) * hard_lmax_ +
-             ket1.contr[0].l) *
-                hard_lmax_ +
-            ket2.contr[0].l;
-        break;
-
-      case BraKet::xx_xs: assert(false && "this braket is not supported"); break;
-      case BraKet::xs_xx: {
-        /// lmax might be center dependent
-        int ket_lmax = hard_lmax_;
-        switch (deriv_order_) {
-          case 0:
-#ifdef LIBINT2_CENTER_DEPENDENT_MAX_AM_3eri
-            ket_lmax = hard_default_lmax_;
-#endif
-            break;
-          case 1:
-#ifdef LIBINT2_CENTER_DEPENDENT_MAX_AM_3eri1
-            ket_lmax = hard_default_lmax_;
-#endif
-            break;
-          case 2:
-#ifdef LIBINT2_CENTER_DEPENDENT_MAX_AM_3eri2
-            ket_lmax = hard_default_lmax_;
-#endif
-            break;
-          default:assert(false && "deriv_order>2 not yet supported");
-        }
-        buildfnidx =
-            (bra1.contr[0].l * ket_lmax + ket1.contr[0].l) * ket_lmax +
-                ket2.contr[0].l;
-#ifdef ERI3_PURE_SH
-        if (bra1.contr[0].l > 1)
-          assert(bra1.contr[0].pure &&
-                 "library assumes a solid harmonics shell in bra of a 3-center "
-                 "2-body int, but a cartesian shell given");
-#endif
-      } break;
-
-      case BraKet::xs_xs:
-        buildfnidx = bra1.contr[0].l * hard_lmax_ + ket1.contr[0].l;
-#ifdef ERI2_PURE_SH
+    if (use_rys) {
+      compute2_rys(bra1, bra2, ket1, ket2, primdata_[0].contrdepth, primdata_[0].stack);
+      primdata_[0].targets[0] = primdata_[0].stack;
+    } else {
+      const auto buildfnidx = buildfnidx2(bra1.contr[0].l, bra2.contr[0].l,
+                                          ket1.contr[0].l, ket2.contr[0].l);
+  #ifdef ERI3_PURE_SH
+      if (braket_ == BraKet::xs_xx && bra1.contr[0].l > 1)
+        assert(bra1.contr[0].pure &&
+               "library assumes a solid harmonics shell in bra of a 3-center "
+               "2-body int, but a cartesian shell given");
+  #endif
+  #ifdef ERI2_PURE_SH
+      if (braket_ == BraKet::xs_xs) {
         if (bra1.contr[0].l > 1)
           assert(bra1.contr[0].pure &&
                  "library assumes solid harmonics shells in a 2-center "
@@ -1729,16 +2131,13 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
           assert(ket1.contr[0].pure &&
                  "library assumes solid harmonics shells in a 2-center "
                  "2-body int, but a cartesian shell given in bra");
-#endif
-        break;
+      }
+  #endif
 
-      default:
-        assert(false && "invalid braket");
+      assert(buildfnptrs_[buildfnidx] && "null build function ptr");
+      buildfnptrs_[buildfnidx](&primdata_[0]);
     }
 
-    assert(buildfnptrs_[buildfnidx] && "null build function ptr");
-    buildfnptrs_[buildfnidx](&primdata_[0]);
-
 #ifdef LIBINT2_ENGINE_TIMERS
     const auto t1 = timers.stop(1);
 #ifdef LIBINT2_ENGINE_PROFILE_CLASS
@@ -1778,7 +2177,6 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
       const auto nc1 = ket1.size();
       const auto nc2 = ket2.size();
       const auto nrow = nr1 * nr2;
-      const auto ncol = nc1 * nc2;
 
       // a 2-d view of the 4-d target tensor
       const auto nr1_tgt = tbra1.size();
@@ -1788,48 +2186,28 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
       const auto ncol_tgt = nc1_tgt * nc2_tgt;
       const auto n_tgt = nr1_tgt * nr2_tgt * ncol_tgt;
 
+      // strides of the target tensor corresponding to the indices of the source tensor,
+      // used to unpermute the integrals while transforming the last index
+      std::array<size_t, 4> tgt_strides;
+      {
+        const size_t strides[4] = {nr2_tgt * ncol_tgt, ncol_tgt, nc2_tgt, 1};
+        tgt_strides[0] = strides[swap_braket ? (swap_tket ? 3 : 2) : (swap_tbra ? 1 : 0)];
+        tgt_strides[1] = strides[swap_braket ? (swap_tket ? 2 : 3) : (swap_tbra ? 0 : 1)];
+        tgt_strides[2] = strides[swap_braket ? (swap_tbra ? 1 : 0) : (swap_tket ? 3 : 2)];
+        tgt_strides[3] = strides[swap_braket ? (swap_tbra ? 0 : 1) : (swap_tket ? 2 : 3)];
+      }
+
       auto hotscr = &scratch_[0];  // points to the hot scratch
 
-      // transform to solid harmonics first, then unpermute, if necessary
+      // transform to solid harmonics, unpermuting (if necessary) in the last pass
       for (auto s = 0; s != ntargets; ++s) {
         // when permuting derivatives may need to permute shellsets also, not
         // just integrals
         // within shellsets; this will point to where source shellset s should end up
         auto s_target = s;
 
-        auto source =
-            primdata_[0].targets[s];  // points to the most recent result
-        auto target = hotscr;
-
-        if (bra1.contr[0].pure) {
-          libint2::solidharmonics::transform_first(
-              bra1.contr[0].l, nr2_cart * ncol_cart, source, target);
-          std::swap(source, target);
-        }
-        if (bra2.contr[0].pure) {
-          libint2::solidharmonics::transform_inner(bra1.size(), bra2.contr[0].l,
-                                                   ncol_cart, source, target);
-          std::swap(source, target);
-        }
-        if (ket1.contr[0].pure) {
-          libint2::solidharmonics::transform_inner(nrow, ket1.contr[0].l,
-                                                   nc2_cart, source, target);
-          std::swap(source, target);
-        }
-        if (ket2.contr[0].pure) {
-          libint2::solidharmonics::transform_last(
-              bra1.size() * bra2.size() * ket1.size(), ket2.contr[0].l, source,
-              target);
-          std::swap(source, target);
-        }
-
-        // need to permute?
+        // if permuting derivatives ints must update their derivative index
         if (permute) {
-          // loop over rows of the source matrix
-          const auto* src_row_ptr = source;
-          auto tgt_ptr = target;
-
-          // if permuting derivatives ints must update their derivative index
           switch (deriv_order) {
             case 0:
               break;  // nothing to do
@@ -1963,50 +2341,41 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
               assert(false &&
                      "3-rd and higher derivatives not yet generalized");
           }
+        }
 
-          for (auto r1 = 0; r1 != nr1; ++r1) {
-            for (auto r2 = 0; r2 != nr2; ++r2, src_row_ptr += ncol) {
-              typedef Eigen::Map<const Matrix> ConstMap;
-              typedef Eigen::Map<Matrix> Map;
-              typedef Eigen::Map<Matrix, Eigen::Unaligned,
-                                 Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>
-                  StridedMap;
-
-              // represent this source row as a matrix
-              ConstMap src_blk_mat(src_row_ptr, nc1, nc2);
-
-              // and copy to the block of the target matrix
-              if (swap_braket) {
-                // if swapped bra and ket, a row of source becomes a column
-                // of
-                // target
-                // source row {r1,r2} is mapped to target column {r1,r2} if
-                // !swap_tket, else to {r2,r1}
-                const auto tgt_col_idx =
-                    !swap_tket ? r1 * nr2 + r2 : r2 * nr1 + r1;
-                StridedMap tgt_blk_mat(
-                    tgt_ptr + tgt_col_idx, nr1_tgt, nr2_tgt,
-                    Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(
-                        nr2_tgt * ncol_tgt, ncol_tgt));
-                if (swap_tbra)
-                  tgt_blk_mat = src_blk_mat.transpose();
-                else
-                  tgt_blk_mat = src_blk_mat;
-              } else {
-                // source row {r1,r2} is mapped to target row {r1,r2} if
-                // !swap_tbra, else to {r2,r1}
-                const auto tgt_row_idx =
-                    !swap_tbra ? r1 * nr2 + r2 : r2 * nr1 + r1;
-                Map tgt_blk_mat(tgt_ptr + tgt_row_idx * ncol, nc1_tgt, nc2_tgt);
-                if (swap_tket)
-                  tgt_blk_mat = src_blk_mat.transpose();
-                else
-                  tgt_blk_mat = src_blk_mat;
-              }
-            }  // end of loop
-          }    // over rows of source
+        auto source =
+            primdata_[0].targets[s];  // points to the most recent result
+        auto target = hotscr;
+
+        // transform all but the last index to solid harmonics ...
+        if (bra1.contr[0].pure && bra2.contr[0].pure) {
+          libint2::solidharmonics::transform_first2(
+              bra1.contr[0].l, bra2.contr[0].l, ncol_cart, source, target);
           std::swap(source, target);
-        }  // need to permute?
+        } else {
+          if (bra1.contr[0].pure) {
+            libint2::solidharmonics::transform_first(
+                bra1.contr[0].l, nr2_cart * ncol_cart, source, target);
+            std::swap(source, target);
+          }
+          if (bra2.contr[0].pure) {
+            libint2::solidharmonics::transform_inner(bra1.size(), bra2.contr[0].l,
+                                                     ncol_cart, source, target);
+            std::swap(source, target);
+          }
+        }
+        if (ket1.contr[0].pure) {
+          libint2::solidharmonics::transform_inner(nrow, ket1.contr[0].l,
+                                                   nc2_cart, source, target);
+          std::swap(source, target);
+        }
+        // ... then transform the last index and unpermute in a single pass
+        if (ket2.contr[0].pure || permute) {
+          libint2::solidharmonics::transform_last_strided(
+              nr1, nr2, nc1, ket2.contr[0].l, ket2.contr[0].pure, source,
+              target, tgt_strides);
+          std::swap(source, target);
+        }
 
         // if the integrals ended up in scratch_, keep them there, update the
         // hot buffer
@@ -2052,6 +2421,203 @@ __libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
   return targets_;
 }
 
+__libint2_engine_inline void Engine::compute2_rys(const Shell& bra1, const Shell& bra2,
+                                                  const Shell& ket1, const Shell& ket2,
+                                                  size_t nprimquartets, value_type* result) {
+  const int la = bra1.contr[0].l;
+  const int lb = bra2.contr[0].l;
+  const int lc = ket1.contr[0].l;
+  const int ld = ket2.contr[0].l;
+  const int lab = la + lb;
+  const int lcd = lc + ld;
+  const int nroots = (lab + lcd) / 2 + 1;
+  const auto rys_eval = RysEval_Chebyshev7<scalar_type>::instance(nroots);
+
+  // primitive quartets are processed in batches, the 1-d integrals of all roots of a batch are
+  // stored contiguously: I[xyz][a][b][c][d][root]
+  const size_t max_batch_nroots = std::max(nroots, 32);
+  const size_t batch_size = max_batch_nroots / nroots;
+  const size_t nroots_stride = batch_size * nroots;
+  const size_t n1d = (la + 1) * (lb + 1) * (lc + 1) * (ld + 1);
+  // scratch for the 2-d integrals (e0|f0), the bra HRR intermediates (e b|f), and the ket HRR intermediates (a b|f d)
+  const size_t ng = (lab + 1) * (lcd + 1);
+  const size_t nh = (lb + 1) * ng;
+  const size_t nk = (ld + 1) * (lcd + 1);
+  const size_t scratch_size = 3 * n1d * nroots_stride + nh + nk + 2 * nroots;
+  if (rys_scratch_.size() < scratch_size) rys_scratch_.resize(scratch_size);
+  auto* I = rys_scratch_.data();
+  auto* H = I + 3 * n1d * nroots_stride;
+  auto* K = H + nh;
+  auto* u = K + nk;
+  auto* w = u + nroots;
+
+  const Shell::real_t AB[3] = {bra1.O[0] - bra2.O[0], bra1.O[1] - bra2.O[1], bra1.O[2] - bra2.O[2]};
+  const Shell::real_t CD[3] = {ket1.O[0] - ket2.O[0], ket1.O[1] - ket2.O[1], ket1.O[2] - ket2.O[2]};
+
+  const auto ncart = bra1.cartesian_size() * bra2.cartesian_size() *
+                     ket1.cartesian_size() * ket2.cartesian_size();
+  std::fill(result, result + ncart, value_type(0));
+
+  for (size_t q0 = 0; q0 < nprimquartets; q0 += batch_size) {
+    const auto nq = std::min(batch_size, nprimquartets - q0);
+    const auto nr = nq * nroots;
+
+    for (size_t q = 0; q != nq; ++q) {
+      const auto& data = rys_primdata_[q0 + q];
+      rys_eval->eval(u, w, boys_T_[q0 + q], nroots);
+      for (int r = 0; r != nroots; ++r) {
+        const auto ur = u[r];
+        const auto B10 = data.oo2z * (1 - data.roz * ur);
+        const auto B01 = data.oo2e * (1 - data.roe * ur);
+        const auto B00 = data.oo2ze * ur;
+        const auto ir = q * nroots + r;
+        for (int xyz = 0; xyz != 3; ++xyz) {
+          const auto C00 = data.PA[xyz] + data.WP[xyz] * ur;
+          const auto Cp00 = data.QC[xyz] + data.WQ[xyz] * ur;
+
+          // VRR for the 2-d integrals G(e,f) = H[0][e][f] ; the prefactor and the weight are
+          // included in the z component
+          auto* G = H;
+          G[0] = (xyz == 2) ? boys_pfac_[q0 + q] * w[r] : 1;
+          if (lab > 0) G[lcd + 1] = C00 * G[0];
+          for (int e = 1; e < lab; ++e)
+            G[(e + 1) * (lcd + 1)] = C00 * G[e * (lcd + 1)] + e * B10 * G[(e - 1) * (lcd + 1)];
+          for (int e = 0; e <= lab; ++e) {
+            auto* Ge = G + e * (lcd + 1);
+            const auto* Gem1 = e > 0 ? Ge - (lcd + 1) : Ge;
+            for (int f = 0; f < lcd; ++f) {
+              auto value = Cp00 * Ge[f];
+              if (f > 0) value += f * B01 * Ge[f - 1];
+              if (e > 0) value += e * B00 * Gem1[f];
+              Ge[f + 1] = value;
+            }
+          }
+
+          // bra HRR: (e b+1|f) = (e+1 b|f) + AB (e b|f)
+          for (int b = 0; b < lb; ++b) {
+            const auto* Hb = H + b * ng;
+            auto* Hbp1 = H + (b + 1) * ng;
+            for (int e = 0; e < lab - b; ++e)
+              for (int f = 0; f <= lcd; ++f)
+                Hbp1[e * (lcd + 1) + f] = Hb[(e + 1) * (lcd + 1) + f] + AB[xyz] * Hb[e * (lcd + 1) + f];
+          }
+
+          // ket HRR: (a b|f d+1) = (a b|f+1 d) + CD (a b|f d)
+          auto* Ixyz = I + xyz * n1d * nroots_stride;
+          for (int a = 0; a <= la; ++a) {
+            for (int b = 0; b <= lb; ++b) {
+              std::copy(H + b * ng + a * (lcd + 1), H + b * ng + (a + 1) * (lcd + 1), K);
+              for (int d = 0; d < ld; ++d) {
+                const auto* Kd = K + d * (lcd + 1);
+                auto* Kdp1 = K + (d + 1) * (lcd + 1);
+                for (int f = 0; f < lcd - d; ++f)
+                  Kdp1[f] = Kd[f + 1] + CD[xyz] * Kd[f];
+              }
+              for (int c = 0; c <= lc; ++c)
+                for (int d = 0; d <= ld; ++d)
+                  Ixyz[(((a * (lb + 1) + b) * (lc + 1) + c) * (ld + 1) + d) * nroots_stride + ir] =
+                      K[d * (lcd + 1) + c];
+            }
+          }
+        }  // xyz
+      }  // roots
+    }  // primitive quartets of the batch
+
+    // assemble the Cartesian integrals, in the ordering of the library
+    const auto* Ix = I;
+    const auto* Iy = I + n1d * nroots_stride;
+    const auto* Iz = I + 2 * n1d * nroots_stride;
+    const auto index1d = [=](int a, int b, int c, int d) {
+      return (((a * (lb + 1) + b) * (lc + 1) + c) * (ld + 1) + d) * nroots_stride;
+    };
+    auto* res = result;
+    int ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz;
+    FOR_CART(ax, ay, az, la)
+      FOR_CART(bx, by, bz, lb)
+        FOR_CART(cx, cy, cz, lc)
+          FOR_CART(dx, dy, dz, ld)
+            const auto* ix = Ix + index1d(ax, bx, cx, dx);
+            const auto* iy = Iy + index1d(ay, by, cy, dy);
+            const auto* iz = Iz + index1d(az, bz, cz, dz);
+            value_type value = 0;
+            for (size_t r = 0; r != nr; ++r)
+              value += ix[r] * iy[r] * iz[r];
+            *res++ += value;
+          END_FOR_CART
+        END_FOR_CART
+      END_FOR_CART
+    END_FOR_CART
+  }  // batches of primitive quartets
+}
+
+/// computes shell sets of 2-body integrals for a batch of quartets of the same
+/// class
+template <Operator op, BraKet bk, size_t deriv_order>
+__libint2_engine_inline size_t Engine::compute2_batch(
+    const ShellQuartet* quartets, size_t nquartets, value_type* result) {
+  if (nquartets == 0) return 0;
+
+  const auto& q0 = quartets[0];
+  const auto same_class = [](const Shell& s1, const Shell& s2) {
+    return s1.contr[0].l == s2.contr[0].l &&
+           s1.contr[0].pure == s2.contr[0].pure;
+  };
+  for (size_t q = 1; q != nquartets; ++q) {
+    assert(same_class(*quartets[q].bra1, *q0.bra1) &&
+           same_class(*quartets[q].bra2, *q0.bra2) &&
+           same_class(*quartets[q].ket1, *q0.ket1) &&
+           same_class(*quartets[q].ket2, *q0.ket2) &&
+           "Engine::compute2_batch -- all quartets must belong to the same class");
+  }
+
+  const auto nsets = nshellsets();
+  const auto setsize =
+      q0.bra1->size() * q0.bra2->size() * q0.ket1->size() * q0.ket2->size();
+  const auto quartet_size = nsets * setsize;
+
+  // shell pair data not provided by the user is computed once per distinct
+  // {bra1,bra2} (or {ket1,ket2}) pair of consecutive quartets, so
+  // that loops with fixed bra (or ket) do not recompute it for every quartet
+  ShellPair spbra, spket;
+  const Shell* spbra_shells[2] = {nullptr, nullptr};
+  const Shell* spket_shells[2] = {nullptr, nullptr};
+
+  size_t nnonzero = 0;
+  auto* result_q = result;
+  for (size_t q = 0; q != nquartets; ++q, result_q += quartet_size) {
+    const auto& quartet = quartets[q];
+    const ShellPair* spbra_q = quartet.spbra;
+    const ShellPair* spket_q = quartet.spket;
+    if (spbra_q == nullptr || spket_q == nullptr) {
+      if (spbra_shells[0] != quartet.bra1 || spbra_shells[1] != quartet.bra2) {
+        spbra.init(*quartet.bra1, *quartet.bra2, ln_precision_);
+        spbra_shells[0] = quartet.bra1;
+        spbra_shells[1] = quartet.bra2;
+      }
+      if (spket_shells[0] != quartet.ket1 || spket_shells[1] != quartet.ket2) {
+        spket.init(*quartet.ket1, *quartet.ket2, ln_precision_);
+        spket_shells[0] = quartet.ket1;
+        spket_shells[1] = quartet.ket2;
+      }
+      spbra_q = &spbra;
+      spket_q = &spket;
+    }
+
+    compute2<op, bk, deriv_order>(*quartet.bra1, *quartet.bra2, *quartet.ket1,
+                                  *quartet.ket2, spbra_q, spket_q);
+
+    if (targets_[0] == nullptr) {
+      std::fill(result_q, result_q + quartet_size, value_type(0));
+    } else {
+      ++nnonzero;
+      for (auto s = 0u; s != nsets; ++s)
+        std::copy(targets_[s], targets_[s] + setsize, result_q + s * setsize);
+    }
+  }
+
+  return nnonzero;
+}
+
 #undef BOOST_PP_NBODY_OPERATOR_LIST
 #undef BOOST_PP_NBODY_OPERATOR_INDEX_TUPLE
 #undef BOOST_PP_NBODY_OPERATOR_INDEX_LIST
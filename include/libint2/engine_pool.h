@@ -0,0 +1,189 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_enginepool_h_
+#define _libint2_src_lib_libint_enginepool_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/engine_pool.h requires C++11 support"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <libint2/engine.h>
+
+namespace libint2 {
+
+/// EnginePool recycles Engine objects, so that short-lived tasks can obtain a
+/// ready-to-use engine without constructing or copying one.
+
+/// Idle engines are kept in free lists keyed by {Operator, BraKet, derivative order}.
+/// acquire() takes an idle engine with the matching key (or constructs one if there
+/// is none), grows it if it cannot handle the requested maximum angular momentum
+/// or number of primitives, and resets its precision and operator parameters.
+/// The engine is returned to the pool when the EnginePool::handle is destroyed.
+/// Since the Boys function tables and the build function tables are shared by all
+/// engines, an engine only owns its scratch data; hence the pool never holds
+/// more engines than were in simultaneous use.
+/// acquire() and the release of handles can be called concurrently from any number of threads.
+/// \warning the pool must outlive the handles that it issued
+class EnginePool {
+ public:
+  /// tags the default parameters of an operator
+  struct default_params_t {};
+
+  /// a unique handle to an Engine borrowed from an EnginePool
+  class handle {
+   public:
+    handle() = default;
+    handle(handle&&) = default;
+    handle& operator=(handle&& other) {
+      release();
+      pool_ = other.pool_;
+      engine_ = std::move(other.engine_);
+      return *this;
+    }
+    ~handle() { release(); }
+
+    Engine& operator*() const { return *engine_; }
+    Engine* operator->() const { return engine_.get(); }
+    Engine* get() const { return engine_.get(); }
+    explicit operator bool() const { return static_cast<bool>(engine_); }
+
+   private:
+    friend class EnginePool;
+    handle(EnginePool* pool, std::unique_ptr<Engine> engine)
+        : pool_(pool), engine_(std::move(engine)) {}
+
+    void release() {
+      if (engine_) pool_->release(std::move(engine_));
+    }
+
+    EnginePool* pool_ = nullptr;
+    std::unique_ptr<Engine> engine_;
+  };
+
+  EnginePool() = default;
+  EnginePool(const EnginePool&) = delete;
+  EnginePool& operator=(const EnginePool&) = delete;
+
+  /// borrows an Engine from the pool; the arguments are the same as for the
+  /// corresponding Engine constructor
+  /// @return a handle to the engine, that returns the engine to the pool upon destruction
+  template <typename Params = default_params_t>
+  handle acquire(Operator oper, size_t max_nprim, int max_l, int deriv_order = 0,
+                 scalar_type precision = std::numeric_limits<scalar_type>::epsilon(),
+                 Params params = default_params_t(),
+                 BraKet braket = BraKet::invalid) {
+    assert(max_nprim > 0);
+    if (braket == BraKet::invalid) braket = default_braket(oper);
+    const key_type key{oper, braket, deriv_order};
+
+    std::unique_ptr<Engine> engine;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      auto it = free_.find(key);
+      if (it != free_.end() && !it->second.empty()) {
+        engine = std::move(it->second.back());
+        it->second.pop_back();
+      }
+    }
+
+    if (engine) {
+      engine->set_max_l(std::max(max_l, static_cast<int>(engine->max_l())));
+      engine->set_max_nprim(max_nprim);
+      engine->set_precision(precision);
+      reset_params(*engine, params);
+    } else {
+      engine = make_engine(oper, max_nprim, max_l, deriv_order, precision,
+                           params, braket);
+      ++nengines_;
+    }
+    return handle(this, std::move(engine));
+  }
+
+  /// @return the number of engines constructed by this pool
+  std::size_t nengines() const { return nengines_; }
+
+  /// @return the number of engines currently available in this pool
+  std::size_t nidle() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::size_t result = 0;
+    for (const auto& kv : free_) result += kv.second.size();
+    return result;
+  }
+
+  /// destroys the idle engines
+  void clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    free_.clear();
+  }
+
+ private:
+  typedef std::tuple<Operator, BraKet, int> key_type;
+
+  mutable std::mutex mtx_;
+  std::map<key_type, std::vector<std::unique_ptr<Engine>>> free_;
+  std::atomic<std::size_t> nengines_{0};
+
+  void release(std::unique_ptr<Engine> engine) {
+    // restore the defaults of the properties that acquire() does not reset
+    engine->set(CartesianShellNormalization::standard);
+    engine->set_charge_screening(false);
+    const key_type key{engine->oper(), engine->braket(), engine->deriv_order()};
+    std::lock_guard<std::mutex> lock(mtx_);
+    free_[key].emplace_back(std::move(engine));
+  }
+
+  static std::unique_ptr<Engine> make_engine(Operator oper, size_t max_nprim,
+                                             int max_l, int deriv_order,
+                                             scalar_type precision,
+                                             default_params_t, BraKet braket) {
+    return std::unique_ptr<Engine>(new Engine(oper, max_nprim, max_l, deriv_order,
+                                              precision, default_params(oper), braket));
+  }
+  template <typename Params>
+  static std::unique_ptr<Engine> make_engine(Operator oper, size_t max_nprim,
+                                             int max_l, int deriv_order,
+                                             scalar_type precision,
+                                             const Params& params, BraKet braket) {
+    return std::unique_ptr<Engine>(
+        new Engine(oper, max_nprim, max_l, deriv_order, precision, params, braket));
+  }
+
+  static void reset_params(Engine& engine, default_params_t) {
+    engine.set_params(default_params(engine.oper()));
+  }
+  template <typename Params>
+  static void reset_params(Engine& engine, const Params& params) {
+    engine.set_params(params);
+  }
+};
+
+}  // namespace libint2
+
+#endif /* _libint2_src_lib_libint_enginepool_h_ */
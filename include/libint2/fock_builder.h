@@ -0,0 +1,805 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_fockbuilder_h_
+#define _libint2_src_lib_libint_fockbuilder_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/fock_builder.h requires C++11 support"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <libint2/atom.h>
+#include <libint2/basis.h>
+#include <libint2/engine.h>
+#include <libint2/shellblock_file.h>
+#include <libint2/shellpair_database.h>
+#include <libint2/shellpair_tree.h>
+
+namespace libint2 {
+
+/// FockBuilder computes the Coulomb (J) and exchange (K) matrices,
+/// \f$ J_{\mu\nu} = \sum_{\kappa\lambda} (\mu\nu|\kappa\lambda) D_{\kappa\lambda} \f$ and
+/// \f$ K_{\mu\nu} = \sum_{\kappa\lambda} (\mu\kappa|\nu\lambda) D_{\kappa\lambda} \f$,
+/// for a symmetric density matrix \f$ D \f$ using multiple threads. It also computes the
+/// derivatives of the 2-body energy with respect to the nuclear coordinates
+/// (see compute_gradient() and compute_hessian()).
+
+/// The work is split into tasks, one per significant bra shell pair of the
+/// ShellPairDatabase; each task loops over the permutationally-unique ket shell pairs.
+/// The tasks are sorted by decreasing estimated cost and dealt out to
+/// per-thread queues; a thread whose queue is exhausted steals tasks from the others.
+/// Each thread accumulates its contributions into thread-local shell blocks that are
+/// flushed into the shared result in batches, hence no thread holds a replica of the
+/// result matrices.
+/// The integrals can also be computed once and kept in files (see store_integrals()), from
+/// which compute() then streams them.
+/// For incremental Fock builds, where compute() is called with density differences that shrink
+/// from one SCF iteration to the next, the integral norms of the shell quartets can be cached
+/// (see cache_integral_norms()), so that compute() only visits the quartets that can contribute.
+/// The quartets are screened with the Schwarz bound or, for spatially extended systems, with the
+/// distance-including QQR estimate (see enable_distance_screening()).
+class FockBuilder {
+ public:
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+
+  /// @param obs the orbital basis set
+  /// @param nthreads the number of threads to use
+  /// @param precision the target precision of the matrix elements; shell quartets whose contributions
+  ///        are estimated to be smaller than this are skipped
+  /// @param Schwarz the shell-pair Schwarz factors, \f$ Q_{ij} = \sqrt{ || (ij|ij) ||_\infty } \f$ ; if empty,
+  ///        they are computed here
+  /// \warning @c obs must outlive this object
+  FockBuilder(const BasisSet& obs, std::size_t nthreads = 1,
+              double precision = std::numeric_limits<double>::epsilon(),
+              const Matrix& Schwarz = Matrix())
+      : obs_(obs),
+        spdb_(obs),
+        nthreads_(std::max<std::size_t>(nthreads, 1)),
+        precision_(precision),
+        Schwarz_(Schwarz.size() != 0 ? Schwarz : compute_schwarz(obs)) {
+    assert(Schwarz_.rows() == obs.size() && Schwarz_.cols() == obs.size());
+    init_tasks();
+  }
+
+  ~FockBuilder() { remove_integral_files(); }
+
+  /// @return the shell pair database used to drive the computation
+  const ShellPairDatabase& shellpairs() const { return spdb_; }
+
+  /// @return the number of threads
+  std::size_t nthreads() const { return nthreads_; }
+
+  /// @return the target precision of the matrix elements
+  double precision() const { return precision_; }
+
+  /// changes the target precision of the matrix elements, e.g. to tighten it as the SCF converges
+  /// @param[in] precision the target precision
+  /// @note the quartets that were screened out by cache_integral_norms() or
+  ///       store_integrals() are not recovered by tightening the precision
+  FockBuilder& set_precision(double precision) {
+    precision_ = precision;
+    return *this;
+  }
+
+  /// the maximum number of elements that each thread accumulates before flushing
+  /// its contributions to the result matrices; the default is 2^18
+  /// @param[in] n the number of elements
+  FockBuilder& set_flush_size(std::size_t n) {
+    flush_size_ = n;
+    return *this;
+  }
+
+  /// the maximum number of integrals that each thread reads at once from the integral files
+  /// (see store_integrals()); the default is 2^22
+  /// @param[in] n the number of integrals
+  FockBuilder& set_read_size(std::size_t n) {
+    read_size_ = n;
+    return *this;
+  }
+
+  /// screens the shell quartets with the QQR estimate (see ShellPairTree), which accounts for the decay of the
+  /// integrals with the distance between the bra and ket charge distributions, rather than with the Schwarz bound;
+  /// the ket shell pairs of each bra shell pair are found with a spatial tree, without visiting the negligible
+  /// quartets. For large, spatially extended systems far fewer quartets survive than with the Schwarz bound.
+  /// @note the extents of the charge distributions are determined with the current precision; this should
+  ///       be called before cache_integral_norms() or store_integrals(), since their screening depends on it
+  FockBuilder& enable_distance_screening() {
+    tree_ = ShellPairTree(spdb_, Schwarz_, precision_);
+    return *this;
+  }
+
+  /// @return true if enable_distance_screening() was called
+  bool distance_screening() const { return tree_.size() != 0; }
+
+  /// computes the integrals of all shell quartets that survive the screening and writes them to
+  /// files, one per thread, named @c prefix.<thread id> ; the integrals of each task are a record keyed by
+  /// its bra shell pair, and the ket shell pairs of the records are kept in memory. Subsequent calls to
+  /// compute() read the integrals back, each thread reading the next batch of its file while it
+  /// contracts the current one, rather than recomputing them. This pays off when recomputing the
+  /// integrals in every SCF iteration is slower than reading them, e.g. from a fast local disk.
+  /// @param[in] prefix the prefix of the names of the files; the files are removed when this object is destroyed
+  /// @throw std::ios_base::failure if the files cannot be written
+  FockBuilder& store_integrals(const std::string& prefix) {
+    remove_integral_files();
+    integral_file_prefix_ = prefix;
+    stored_kets_.assign(spdb_.size(), std::vector<uint32_t>());
+
+    TaskQueues queues(tasks_, nthreads_);
+    auto thread_main = [&](std::size_t thread_id) {
+      Engine engine(Operator::coulomb, obs_.max_nprim(), obs_.max_l(), 0,
+                    precision_);
+      const auto& buf = engine.results();
+      ShellBlockFileWriter writer(integral_file(thread_id));
+      std::vector<double> record;
+
+      std::size_t sp12;
+      while (queues.next(thread_id, sp12)) {
+        const auto s1 = spdb_.shell1(sp12);
+        const auto s2 = spdb_.shell2(sp12);
+        const auto n12 = obs_[s1].size() * obs_[s2].size();
+        auto& kets = stored_kets_[sp12];
+        record.clear();
+        for_each_ket(sp12, precision_, [&](std::size_t sp34, double) {
+          const auto s3 = spdb_.shell1(sp34);
+          const auto s4 = spdb_.shell2(sp34);
+          engine.compute2<Operator::coulomb, BraKet::xx_xx, 0>(spdb_, sp12,
+                                                               sp34);
+          if (buf[0] == nullptr) return;  // screened out
+
+          const auto n1234 = n12 * obs_[s3].size() * obs_[s4].size();
+          record.insert(record.end(), buf[0], buf[0] + n1234);
+          kets.push_back(sp34);
+        });
+        if (!kets.empty()) writer.write(sp12, record.data(), record.size());
+      }
+      writer.close();
+    };
+
+    run_threads(thread_main);
+    return *this;
+  }
+
+  /// @return true if store_integrals() was called, i.e. compute() reads the integrals from files
+  bool integrals_stored() const { return !integral_file_prefix_.empty(); }
+
+  /// computes the integrals of all shell quartets that survive the screening (hence this costs
+  /// about as much as a call to compute()) and caches their norms, \f$ ||(12|34)||_\infty \f$ ,
+  /// sorted by decreasing value for each bra shell pair. Subsequent calls to compute()
+  /// screen the quartets with the cached norms rather than the estimates; moreover, for each
+  /// bra shell pair they stop at the first quartet whose norm times the largest norm of the shell
+  /// blocks of the density is below the precision. Hence, as the density differences of an incremental
+  /// Fock build shrink, so does the list of the quartets that are visited.
+  /// @note the quartets are screened with the current precision, hence the precision should not be
+  ///       tightened afterwards
+  /// @note the cached norms are not used if the integrals are stored (see store_integrals())
+  FockBuilder& cache_integral_norms() {
+    ket_norms_.assign(spdb_.size(), std::vector<std::pair<float, uint32_t>>());
+
+    TaskQueues queues(tasks_, nthreads_);
+    auto thread_main = [&](std::size_t thread_id) {
+      Engine engine(Operator::coulomb, obs_.max_nprim(), obs_.max_l(), 0,
+                    precision_);
+      const auto& buf = engine.results();
+
+      std::size_t sp12;
+      while (queues.next(thread_id, sp12)) {
+        const auto s1 = spdb_.shell1(sp12);
+        const auto s2 = spdb_.shell2(sp12);
+        const auto n12 = obs_[s1].size() * obs_[s2].size();
+        auto& kets = ket_norms_[sp12];
+        for_each_ket(sp12, precision_, [&](std::size_t sp34, double) {
+          const auto s3 = spdb_.shell1(sp34);
+          const auto s4 = spdb_.shell2(sp34);
+          engine.compute2<Operator::coulomb, BraKet::xx_xx, 0>(spdb_, sp12,
+                                                               sp34);
+          if (buf[0] == nullptr) return;  // screened out
+
+          const auto n1234 = n12 * obs_[s3].size() * obs_[s4].size();
+          double norm = 0.0;
+          for (auto f1234 = 0ul; f1234 != n1234; ++f1234)
+            norm = std::max(norm, std::abs(buf[0][f1234]));
+          if (norm >= precision_) kets.emplace_back(norm, sp34);
+        });
+        std::sort(kets.begin(), kets.end(),
+                  [](const std::pair<float, uint32_t>& a,
+                     const std::pair<float, uint32_t>& b) {
+                    return a.first > b.first;
+                  });
+        kets.shrink_to_fit();
+      }
+    };
+
+    run_threads(thread_main);
+    return *this;
+  }
+
+  /// @return true if cache_integral_norms() was called
+  bool integral_norms_cached() const { return !ket_norms_.empty(); }
+
+  /// computes the Coulomb and/or exchange matrices
+  /// @param[in] D the (symmetric) density matrix
+  /// @param[in] compute_J whether to compute the Coulomb matrix
+  /// @param[in] compute_K whether to compute the exchange matrix
+  /// @return {J,K}; the matrices that were not requested are empty
+  std::pair<Matrix, Matrix> compute(const Matrix& D, bool compute_J = true,
+                                    bool compute_K = true) const {
+    const auto n = obs_.nbf();
+    assert(D.rows() == n && D.cols() == n);
+    const auto nsh = obs_.size();
+
+    Matrix J, K;
+    if (compute_J) J = Matrix::Zero(n, n);
+    if (compute_K) K = Matrix::Zero(n, n);
+    if (!compute_J && !compute_K) return std::make_pair(J, K);
+
+    const auto Dnorm = shellblock_norm(D);
+    const auto Dnorm_max = Dnorm.maxCoeff();
+
+    TaskQueues queues(tasks_, nthreads_);
+    // locks protecting the rows of shell blocks of J and K
+    std::vector<std::mutex> row_mutexes(nsh);
+
+    auto thread_main = [&](std::size_t thread_id) {
+      const auto& shell2bf = obs_.shell2bf();
+
+      // thread-local shell blocks of J and K, keyed by {row shell, col shell}
+      std::unordered_map<std::size_t, std::size_t> Jblocks, Kblocks;
+      std::vector<double> Jpool, Kpool;
+      // returns the offset of block {s1,s2} in the pool, creating it if needed
+      auto block = [&](std::unordered_map<std::size_t, std::size_t>& blocks,
+                       std::vector<double>& pool, std::size_t s1,
+                       std::size_t s2) -> std::size_t {
+        const auto key = s1 * nsh + s2;
+        auto it = blocks.find(key);
+        if (it == blocks.end()) {
+          const auto offset = pool.size();
+          pool.resize(offset + obs_[s1].size() * obs_[s2].size(), 0.0);
+          it = blocks.emplace(key, offset).first;
+        }
+        return it->second;
+      };
+      auto flush = [&](std::unordered_map<std::size_t, std::size_t>& blocks,
+                       std::vector<double>& pool, Matrix& result) {
+        for (const auto& kv : blocks) {
+          const auto s1 = kv.first / nsh;
+          const auto s2 = kv.first % nsh;
+          const auto n1 = obs_[s1].size();
+          const auto n2 = obs_[s2].size();
+          Eigen::Map<const Matrix> blk(pool.data() + kv.second, n1, n2);
+          std::lock_guard<std::mutex> lock(row_mutexes[s1]);
+          result.block(shell2bf[s1], shell2bf[s2], n1, n2) += blk;
+        }
+        blocks.clear();
+        pool.clear();
+      };
+
+      // true if the contributions of shell quartet {s1,s2,s3,s4}, whose integrals are
+      // estimated to be at most norm1234, are negligible
+      auto screened = [&](std::size_t s1, std::size_t s2, std::size_t s3,
+                          std::size_t s4, double norm1234) {
+        const auto Dnorm1234 =
+            std::max({Dnorm(s1, s2), Dnorm(s3, s4), Dnorm(s1, s3),
+                      Dnorm(s1, s4), Dnorm(s2, s3), Dnorm(s2, s4)});
+        return Dnorm1234 * norm1234 < precision_;
+      };
+
+      // accumulates the contributions of the integrals of permutationally-unique
+      // shell quartet {s1,s2,s3,s4}
+      auto contract = [&](std::size_t s1, std::size_t s2, std::size_t s3,
+                          std::size_t s4, const double* buf_1234) {
+        const auto bf1_first = shell2bf[s1];
+        const auto bf2_first = shell2bf[s2];
+        const auto bf3_first = shell2bf[s3];
+        const auto bf4_first = shell2bf[s4];
+        const auto n1 = obs_[s1].size();
+        const auto n2 = obs_[s2].size();
+        const auto n3 = obs_[s3].size();
+        const auto n4 = obs_[s4].size();
+        const auto s12_deg = (s1 == s2) ? 1 : 2;
+        const auto s34_deg = (s3 == s4) ? 1 : 2;
+        const auto s12_34_deg = (s1 == s3) ? (s2 == s4 ? 1 : 2) : 2;
+        const auto s1234_deg = s12_deg * s34_deg * s12_34_deg;
+
+        // the pools may be reallocated by block(), hence get all offsets before making pointers
+        double *J12 = nullptr, *J34 = nullptr;
+        if (compute_J) {
+          const auto o12 = block(Jblocks, Jpool, s1, s2);
+          const auto o34 = block(Jblocks, Jpool, s3, s4);
+          J12 = Jpool.data() + o12;
+          J34 = Jpool.data() + o34;
+        }
+        double *K13 = nullptr, *K14 = nullptr, *K23 = nullptr, *K24 = nullptr;
+        if (compute_K) {
+          const auto o13 = block(Kblocks, Kpool, s1, s3);
+          const auto o14 = block(Kblocks, Kpool, s1, s4);
+          const auto o23 = block(Kblocks, Kpool, s2, s3);
+          const auto o24 = block(Kblocks, Kpool, s2, s4);
+          K13 = Kpool.data() + o13;
+          K14 = Kpool.data() + o14;
+          K23 = Kpool.data() + o23;
+          K24 = Kpool.data() + o24;
+        }
+
+        for (auto f1 = 0ul, f1234 = 0ul; f1 != n1; ++f1) {
+          const auto bf1 = f1 + bf1_first;
+          for (auto f2 = 0ul; f2 != n2; ++f2) {
+            const auto bf2 = f2 + bf2_first;
+            for (auto f3 = 0ul; f3 != n3; ++f3) {
+              const auto bf3 = f3 + bf3_first;
+              for (auto f4 = 0ul; f4 != n4; ++f4, ++f1234) {
+                const auto bf4 = f4 + bf4_first;
+                const auto value_scal_by_deg = buf_1234[f1234] * s1234_deg;
+                if (compute_J) {
+                  J12[f1 * n2 + f2] += D(bf3, bf4) * value_scal_by_deg;
+                  J34[f3 * n4 + f4] += D(bf1, bf2) * value_scal_by_deg;
+                }
+                if (compute_K) {
+                  K13[f1 * n3 + f3] += D(bf2, bf4) * value_scal_by_deg;
+                  K24[f2 * n4 + f4] += D(bf1, bf3) * value_scal_by_deg;
+                  K14[f1 * n4 + f4] += D(bf2, bf3) * value_scal_by_deg;
+                  K23[f2 * n3 + f3] += D(bf1, bf4) * value_scal_by_deg;
+                }
+              }
+            }
+          }
+        }
+
+        if (Jpool.size() > flush_size_) flush(Jblocks, Jpool, J);
+        if (Kpool.size() > flush_size_) flush(Kblocks, Kpool, K);
+      };
+
+      if (integrals_stored()) {
+        // each thread reads back the integrals that it stored
+        ShellBlockFileReader reader(integral_file(thread_id));
+        reader.stream(
+            [&](std::size_t first, std::size_t last, const double* data) {
+              for (auto r = first; r != last; ++r) {
+                const auto sp12 = reader.key(r);
+                const auto s1 = spdb_.shell1(sp12);
+                const auto s2 = spdb_.shell2(sp12);
+                const auto n12 = obs_[s1].size() * obs_[s2].size();
+                const auto* buf_1234 = data + reader.offset(r) - reader.offset(first);
+                for (const auto sp34 : stored_kets_[sp12]) {
+                  const auto s3 = spdb_.shell1(sp34);
+                  const auto s4 = spdb_.shell2(sp34);
+                  if (!screened(s1, s2, s3, s4, estimate(sp12, sp34)))
+                    contract(s1, s2, s3, s4, buf_1234);
+                  buf_1234 += n12 * obs_[s3].size() * obs_[s4].size();
+                }
+              }
+            },
+            read_size_);
+      } else {
+        Engine engine(Operator::coulomb, obs_.max_nprim(), obs_.max_l(), 0,
+                      precision_);
+        const auto& buf = engine.results();
+
+        auto compute_and_contract = [&](std::size_t sp12, std::size_t sp34) {
+          engine.compute2<Operator::coulomb, BraKet::xx_xx, 0>(spdb_, sp12,
+                                                               sp34);
+          const auto* buf_1234 = buf[0];
+          if (buf_1234 == nullptr) return;  // screened out
+          contract(spdb_.shell1(sp12), spdb_.shell2(sp12), spdb_.shell1(sp34),
+                   spdb_.shell2(sp34), buf_1234);
+        };
+
+        std::size_t sp12;
+        while (queues.next(thread_id, sp12)) {
+          const auto s1 = spdb_.shell1(sp12);
+          const auto s2 = spdb_.shell2(sp12);
+
+          if (integral_norms_cached()) {
+            for (const auto& ket : ket_norms_[sp12]) {
+              // the kets are sorted by decreasing norm, hence the rest are negligible too
+              if (ket.first * Dnorm_max < precision_) break;
+              const auto sp34 = ket.second;
+              const auto s3 = spdb_.shell1(sp34);
+              const auto s4 = spdb_.shell2(sp34);
+              if (screened(s1, s2, s3, s4, ket.first)) continue;
+              compute_and_contract(sp12, sp34);
+            }
+          } else if (Dnorm_max != 0.0) {
+            // the kets whose integrals are negligible even for the largest density block are skipped at once
+            for_each_ket(sp12, precision_ / Dnorm_max,
+                         [&](std::size_t sp34, double norm1234) {
+                           const auto s3 = spdb_.shell1(sp34);
+                           const auto s4 = spdb_.shell2(sp34);
+                           if (screened(s1, s2, s3, s4, norm1234)) return;
+                           compute_and_contract(sp12, sp34);
+                         });
+          }
+        }
+      }
+      if (compute_J) flush(Jblocks, Jpool, J);
+      if (compute_K) flush(Kblocks, Kpool, K);
+    };
+
+    run_threads(thread_main);
+
+    // symmetrize, accounting for the permutational degeneracy of the unique shell quartets
+    if (compute_J) {
+      Matrix Jt = J.transpose();
+      J = 0.25 * (J + Jt);
+    }
+    if (compute_K) {
+      Matrix Kt = K.transpose();
+      K = 0.125 * (K + Kt);
+    }
+    return std::make_pair(J, K);
+  }
+
+  /// computes the derivatives of the 2-body energy
+  /// \f$ E_2 = \mathrm{tr}(\mathbf{G}[\mathbf{D}] \mathbf{D}) = \sum_{\mu\nu\kappa\lambda} D_{\mu\nu} D_{\kappa\lambda}
+  /// [ 2 (\mu\nu|\kappa\lambda) - (\mu\kappa|\nu\lambda) ] \f$ with respect to the nuclear coordinates
+  /// at fixed density, i.e. the 2-body contribution to the closed-shell Hartree-Fock forces
+  /// for \f$ \mathbf{D} = \mathbf{C}_{\rm occ} \mathbf{C}_{\rm occ}^\dagger \f$ .
+  /// The derivative integrals are contracted with the density as they are computed, hence neither
+  /// the derivative Fock matrices nor per-thread copies of them are formed.
+  /// @param[in] D the (symmetric) density matrix
+  /// @param[in] atoms the atoms on which the shells of the basis are centered
+  /// @return the (natoms x 3) matrix of the derivatives
+  /// @note requires the derivatives of the Coulomb integrals (LIBINT2_DERIV_ERI_ORDER > 0)
+  Matrix compute_gradient(const Matrix& D, const std::vector<Atom>& atoms) const {
+    return compute_deriv<1>(D, atoms);
+  }
+
+  /// computes the second derivatives of the 2-body energy (see compute_gradient()) with respect to the nuclear
+  /// coordinates at fixed density
+  /// @param[in] D the (symmetric) density matrix
+  /// @param[in] atoms the atoms on which the shells of the basis are centered
+  /// @return the (3 natoms x 3 natoms) symmetric matrix of the second derivatives
+  /// @note requires the second derivatives of the Coulomb integrals (LIBINT2_DERIV_ERI_ORDER > 1)
+  Matrix compute_hessian(const Matrix& D, const std::vector<Atom>& atoms) const {
+    return compute_deriv<2>(D, atoms);
+  }
+
+  /// computes the Schwarz factors of all shell pairs of a basis,
+  /// \f$ Q_{ij} = \sqrt{ || (ij|ij) ||_\infty } \f$
+  /// @param[in] bs the basis
+  /// @return the matrix of Schwarz factors
+  static Matrix compute_schwarz(const BasisSet& bs) {
+    const auto nsh = bs.size();
+    Matrix Q = Matrix::Zero(nsh, nsh);
+    Engine engine(Operator::coulomb, bs.max_nprim(), bs.max_l(), 0, 0.0);
+    const auto& buf = engine.results();
+    for (auto s1 = 0ul; s1 != nsh; ++s1) {
+      for (auto s2 = 0ul; s2 <= s1; ++s2) {
+        engine.compute2<Operator::coulomb, BraKet::xx_xx, 0>(bs[s1], bs[s2],
+                                                             bs[s1], bs[s2]);
+        if (buf[0] == nullptr) continue;
+        const auto n1234 =
+            bs[s1].size() * bs[s2].size() * bs[s1].size() * bs[s2].size();
+        double max_abs = 0.0;
+        for (auto i = 0ul; i != n1234; ++i)
+          max_abs = std::max(max_abs, std::abs(buf[0][i]));
+        Q(s1, s2) = Q(s2, s1) = std::sqrt(max_abs);
+      }
+    }
+    return Q;
+  }
+
+ private:
+  const BasisSet& obs_;
+  ShellPairDatabase spdb_;
+  std::size_t nthreads_;
+  double precision_;
+  Matrix Schwarz_;
+  std::size_t flush_size_ = 1ul << 18;
+  std::size_t read_size_ = 1ul << 22;
+  std::vector<std::size_t> tasks_;  // bra shell pairs, by decreasing cost
+  std::string integral_file_prefix_;  // empty if the integrals are not stored
+  // the ket shell pairs of the stored integrals of each bra shell pair
+  std::vector<std::vector<uint32_t>> stored_kets_;
+  // the integral norms and the ket shell pairs of the quartets of each bra shell pair, by decreasing norm
+  std::vector<std::vector<std::pair<float, uint32_t>>> ket_norms_;
+  ShellPairTree tree_;  // empty unless the quartets are screened with the QQR estimate
+
+  /// @return the estimate of the integral norm of shell quartet {sp12,sp34}, i.e. the QQR estimate if
+  ///         distance_screening() is true, else the Schwarz bound
+  double estimate(std::size_t sp12, std::size_t sp34) const {
+    if (distance_screening()) return tree_.estimate(sp12, sp34);
+    return Schwarz_(spdb_.shell1(sp12), spdb_.shell2(sp12)) *
+           Schwarz_(spdb_.shell1(sp34), spdb_.shell2(sp34));
+  }
+
+  /// calls @c f(sp34,estimate(sp12,sp34)) for the permutationally-unique ket shell pairs @c sp34 of
+  /// bra shell pair @c sp12 , i.e. @c sp34<=sp12 , whose estimated integral norm is at least @c threshold
+  template <typename F>
+  void for_each_ket(std::size_t sp12, double threshold, const F& f) const {
+    if (distance_screening()) {
+      tree_.visit(sp12, threshold, [&](std::size_t sp34, double norm1234) {
+        if (sp34 <= sp12) f(sp34, norm1234);
+      });
+      return;
+    }
+    // ket shell pairs {s3,s4} with s3<=s1 and, if s3==s1, s4<=s2 precede {s1,s2} in the database
+    for (auto sp34 = 0ul; sp34 <= sp12; ++sp34) {
+      const auto norm1234 = estimate(sp12, sp34);
+      if (norm1234 >= threshold) f(sp34, norm1234);
+    }
+  }
+
+  /// @return the name of the integral file of thread @c thread_id
+  std::string integral_file(std::size_t thread_id) const {
+    return integral_file_prefix_ + "." + std::to_string(thread_id);
+  }
+
+  /// removes the integral files, if any
+  void remove_integral_files() {
+    if (!integrals_stored()) return;
+    for (auto thread_id = 0ul; thread_id != nthreads_; ++thread_id)
+      std::remove(integral_file(thread_id).c_str());
+    integral_file_prefix_.clear();
+    stored_kets_.clear();
+  }
+
+  /// the tasks, sorted by decreasing cost, dealt out to per-thread queues round-robin
+  class TaskQueues {
+   public:
+    TaskQueues(const std::vector<std::size_t>& tasks, std::size_t nthreads)
+        : queues_(nthreads), mutexes_(nthreads) {
+      for (auto t = 0ul; t != tasks.size(); ++t)
+        queues_[t % nthreads].push_back(tasks[t]);
+    }
+
+    /// fetches the next task of thread @c thread_id
+    /// @return false if no tasks are left
+    bool next(std::size_t thread_id, std::size_t& task) {
+      const auto nthreads = queues_.size();
+      // own queue first, from the front (most expensive tasks) ...
+      {
+        std::lock_guard<std::mutex> lock(mutexes_[thread_id]);
+        auto& q = queues_[thread_id];
+        if (!q.empty()) {
+          task = q.front();
+          q.pop_front();
+          return true;
+        }
+      }
+      // ... then steal from the back (cheapest tasks) of other queues
+      for (auto i = 1ul; i != nthreads; ++i) {
+        const auto victim = (thread_id + i) % nthreads;
+        std::lock_guard<std::mutex> lock(mutexes_[victim]);
+        auto& q = queues_[victim];
+        if (!q.empty()) {
+          task = q.back();
+          q.pop_back();
+          return true;
+        }
+      }
+      return false;
+    }
+
+   private:
+    std::vector<std::deque<std::size_t>> queues_;
+    std::vector<std::mutex> mutexes_;
+  };
+
+  /// runs @c thread_main(thread_id) on @c nthreads_ threads, including the calling thread
+  template <typename ThreadMain>
+  void run_threads(const ThreadMain& thread_main) const {
+    std::vector<std::thread> threads;
+    for (auto thread_id = 1ul; thread_id < nthreads_; ++thread_id)
+      threads.emplace_back(thread_main, thread_id);
+    thread_main(0);
+    for (auto& thread : threads) thread.join();
+  }
+
+  /// implements compute_gradient() and compute_hessian()
+  template <std::size_t deriv_order>
+  Matrix compute_deriv(const Matrix& D, const std::vector<Atom>& atoms) const {
+    static_assert(deriv_order == 1 || deriv_order == 2,
+                  "FockBuilder::compute_deriv only supports 1st and 2nd derivatives");
+    const auto n = obs_.nbf();
+    assert(D.rows() == n && D.cols() == n);
+    const auto ncoords = 3 * atoms.size();
+    const auto shell2atom = obs_.shell2atom(atoms);
+    const auto Dnorm = shellblock_norm(D);
+
+    // each thread accumulates into its own copy of the result, which is only as large as the result
+    std::vector<Matrix> results(
+        nthreads_, deriv_order == 1 ? Matrix::Zero(atoms.size(), 3)
+                                    : Matrix::Zero(ncoords, ncoords));
+    TaskQueues queues(tasks_, nthreads_);
+
+    auto thread_main = [&](std::size_t thread_id) {
+      Engine engine(Operator::coulomb, obs_.max_nprim(), obs_.max_l(),
+                    deriv_order, precision_);
+      const auto& buf = engine.results();
+      const auto& shell2bf = obs_.shell2bf();
+      auto& result = results[thread_id];
+
+      // the contraction weights of the integrals of a shell quartet
+      std::vector<double> W;
+      // the contracted derivative shell sets: 12 first derivatives w.r.t. the coordinates of
+      // the 4 centers, or 12x12 second derivatives
+      std::array<double, 12 * 12> g;
+      std::size_t coords[12];
+
+      std::size_t sp12;
+      while (queues.next(thread_id, sp12)) {
+        const auto s1 = spdb_.shell1(sp12);
+        const auto s2 = spdb_.shell2(sp12);
+        const auto bf1_first = shell2bf[s1];
+        const auto bf2_first = shell2bf[s2];
+        const auto n1 = obs_[s1].size();
+        const auto n2 = obs_[s2].size();
+        const auto s12_deg = (s1 == s2) ? 1 : 2;
+
+        for (auto sp34 = 0ul; sp34 <= sp12; ++sp34) {
+          const auto s3 = spdb_.shell1(sp34);
+          const auto s4 = spdb_.shell2(sp34);
+          const long shell_atoms[4] = {shell2atom[s1], shell2atom[s2],
+                                       shell2atom[s3], shell2atom[s4]};
+          // by translational invariance the derivatives of one-center quartets sum to zero
+          if (shell_atoms[0] == shell_atoms[1] &&
+              shell_atoms[0] == shell_atoms[2] &&
+              shell_atoms[0] == shell_atoms[3])
+            continue;
+
+          const auto Dnorm1234 =
+              std::max({Dnorm(s1, s2), Dnorm(s3, s4), Dnorm(s1, s3),
+                        Dnorm(s1, s4), Dnorm(s2, s3), Dnorm(s2, s4)});
+          if (Dnorm1234 * Schwarz_(s1, s2) * Schwarz_(s3, s4) < precision_)
+            continue;
+
+          engine.compute2<Operator::coulomb, BraKet::xx_xx, deriv_order>(
+              spdb_, sp12, sp34);
+          if (buf[0] == nullptr) continue;  // screened out
+
+          const auto bf3_first = shell2bf[s3];
+          const auto bf4_first = shell2bf[s4];
+          const auto n3 = obs_[s3].size();
+          const auto n4 = obs_[s4].size();
+          const auto n1234 = n1 * n2 * n3 * n4;
+          const auto s34_deg = (s3 == s4) ? 1 : 2;
+          const auto s12_34_deg = (s1 == s3) ? (s2 == s4 ? 1 : 2) : 2;
+          const auto s1234_deg = s12_deg * s34_deg * s12_34_deg;
+
+          // the weights are the same for all derivatives, hence compute them once
+          W.resize(n1234);
+          for (auto f1 = 0ul, f1234 = 0ul; f1 != n1; ++f1) {
+            const auto bf1 = f1 + bf1_first;
+            for (auto f2 = 0ul; f2 != n2; ++f2) {
+              const auto bf2 = f2 + bf2_first;
+              for (auto f3 = 0ul; f3 != n3; ++f3) {
+                const auto bf3 = f3 + bf3_first;
+                for (auto f4 = 0ul; f4 != n4; ++f4, ++f1234) {
+                  const auto bf4 = f4 + bf4_first;
+                  W[f1234] = s1234_deg * (2.0 * D(bf1, bf2) * D(bf3, bf4) -
+                                          0.5 * (D(bf1, bf3) * D(bf2, bf4) +
+                                                 D(bf1, bf4) * D(bf2, bf3)));
+                }
+              }
+            }
+          }
+          auto contract = [&](std::size_t set) {
+            const auto* shset = buf[set];
+            double value = 0.0;
+            for (auto f1234 = 0ul; f1234 != n1234; ++f1234)
+              value += W[f1234] * shset[f1234];
+            return value;
+          };
+
+          // only the derivatives w.r.t. the first 3 centers are contracted, those w.r.t. the 4th
+          // follow from translational invariance: d/dD = - d/dA - d/dB - d/dC
+          for (auto d = 0; d != 12; ++d) coords[d] = shell_atoms[d / 3] * 3 + d % 3;
+          switch (deriv_order) {
+            case 1: {
+              for (auto d = 0; d != 9; ++d) g[d] = contract(d);
+              for (auto xyz = 0; xyz != 3; ++xyz)
+                g[9 + xyz] = -(g[xyz] + g[3 + xyz] + g[6 + xyz]);
+              for (auto d = 0; d != 12; ++d)
+                result(coords[d] / 3, coords[d] % 3) += g[d];
+            } break;
+
+            case 2: {
+              // the shell sets are the upper triangle of the 12x12 matrix of second derivatives, by rows
+              for (auto d0 = 0, d01 = 0; d0 != 12; ++d0) {
+                for (auto d1 = d0; d1 != 12; ++d1, ++d01) {
+                  if (d1 < 9) g[d0 * 12 + d1] = g[d1 * 12 + d0] = contract(d01);
+                }
+              }
+              for (auto d1 = 0; d1 != 12; ++d1) {
+                for (auto xyz = 0; xyz != 3; ++xyz) {
+                  const auto d0 = 9 + xyz;
+                  if (d1 < 9 || d1 >= d0)
+                    g[d0 * 12 + d1] = g[d1 * 12 + d0] =
+                        -(g[xyz * 12 + d1] + g[(3 + xyz) * 12 + d1] +
+                          g[(6 + xyz) * 12 + d1]);
+                }
+              }
+              for (auto d0 = 0; d0 != 12; ++d0)
+                for (auto d1 = 0; d1 != 12; ++d1)
+                  result(coords[d0], coords[d1]) += g[d0 * 12 + d1];
+            } break;
+          }
+        }
+      }
+    };
+
+    run_threads(thread_main);
+
+    for (auto t = 1ul; t < nthreads_; ++t) results[0] += results[t];
+    return results[0];
+  }
+
+  /// makes the task list; the cost of a task is estimated as the product of the
+  /// bra cost and the total cost of its ket shell pairs, with the cost of a shell
+  /// pair estimated as the product of its number of basis function pairs and
+  /// its number of primitive pairs
+  void init_tasks() {
+    const auto npairs = spdb_.size();
+    std::vector<double> cost(npairs), ket_cost(npairs);
+    double ket_cost_sum = 0.0;
+    for (auto sp = 0ul; sp != npairs; ++sp) {
+      const auto& sh1 = obs_[spdb_.shell1(sp)];
+      const auto& sh2 = obs_[spdb_.shell2(sp)];
+      const auto pair_cost = static_cast<double>(sh1.size() * sh2.size()) *
+                             std::max<std::size_t>(spdb_[sp].nprimpairs(), 1);
+      ket_cost_sum += pair_cost;
+      cost[sp] = pair_cost * ket_cost_sum;
+    }
+    tasks_.resize(npairs);
+    std::iota(tasks_.begin(), tasks_.end(), 0);
+    std::stable_sort(tasks_.begin(), tasks_.end(),
+                     [&cost](std::size_t a, std::size_t b) {
+                       return cost[a] > cost[b];
+                     });
+  }
+
+  /// @return the matrix of the (infinity) norms of the shell blocks of @c A
+  Matrix shellblock_norm(const Matrix& A) const {
+    const auto nsh = obs_.size();
+    const auto& shell2bf = obs_.shell2bf();
+    Matrix result(nsh, nsh);
+    for (auto s1 = 0ul; s1 != nsh; ++s1) {
+      for (auto s2 = 0ul; s2 != nsh; ++s2) {
+        result(s1, s2) = A.block(shell2bf[s1], shell2bf[s2], obs_[s1].size(),
+                                 obs_[s2].size())
+                             .lpNorm<Eigen::Infinity>();
+      }
+    }
+    return result;
+  }
+};
+
+}  // namespace libint2
+
+#endif /* _libint2_src_lib_libint_fockbuilder_h_ */
@@ -54,6 +54,8 @@ namespace libint2 {
       static std::ostream* value = &std::clog;
       return value;
     }
+    // defined in boys.h
+    inline void init_core_eval_tables();
   } // namespace libint2::detail
 
   /// checks if the libint has been initialized.
@@ -72,6 +74,8 @@ namespace libint2 {
       (void) x;  // to suppress unused variable warning (not guaranteed to work) TODO revise when upgrade to C++17
       assert(x != nullptr);
       verbose_accessor() = verbose;
+      // create the (immutable) Boys function tables once, so that engines never wait for them
+      init_core_eval_tables();
     }
   }
 
@@ -110,5 +114,8 @@ namespace libint2 {
   }
 }
 
+// provides detail::init_core_eval_tables()
+#include <libint2/boys.h>
+
 #endif /* _libint2_src_lib_libint_initialize_h_ */
 
@@ -0,0 +1,347 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_pointchargepotential_h_
+#define _libint2_src_lib_libint_pointchargepotential_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/point_charge_potential.h requires C++11 support"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <libint2/basis.h>
+#include <libint2/engine.h>
+
+namespace libint2 {
+
+/// PointChargePotential computes the matrix of the electrostatic potential of a (large) set of
+/// point charges, \f$ V_{ab} = - \sum_C q_C \int \phi_a(\vec{r}) \phi_b(\vec{r}) / |\vec{r} - \vec{C}| \, {\rm d}\vec{r} \f$ ,
+/// i.e. the same matrix as computed with Operator::nuclear , using a Barnes-Hut-like multipole approximation
+/// for the far field.
+
+/// The charges are sorted into an octree whose cells carry the (Cartesian) multipole moments
+/// of their charges up to the quadrupole. For each shell pair the tree is traversed from the root:
+/// the potential of a cell that is well separated from the pair, i.e. for which
+/// \f$ (r_{\rm cell} + r_{\rm pair}) < \theta \, d \f$ where \f$ d \f$ is the distance between
+/// the cell and the pair centers, is represented by its Taylor expansion (up to the 3rd order) about
+/// the pair center and contracted with the Cartesian multipole integrals of the pair
+/// (Operator::emultipole3 ); the charges in the leaves that are not well separated are
+/// treated exactly (Operator::nuclear ). The cost per shell pair is thus
+/// \f$ \mathcal{O}(\log N_{\rm charges}) \f$ for far charges rather than \f$ \mathcal{O}(N_{\rm charges}) \f$ .
+class PointChargePotential {
+ public:
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+  /// point charges and their positions, same as the parameters of Operator::nuclear
+  typedef operator_traits<Operator::nuclear>::oper_params_type charges_type;
+
+  /// @param charges the point charges
+  /// @param max_leaf_size the maximum number of charges in a leaf of the octree
+  PointChargePotential(const charges_type& charges,
+                       std::size_t max_leaf_size = 32)
+      : charges_(charges), max_leaf_size_(std::max<std::size_t>(max_leaf_size, 1)) {
+    build_tree();
+  }
+
+  /// @return the charges, in the order in which they appear in the leaves of the octree
+  const charges_type& charges() const { return charges_; }
+
+  /// @return the number of cells of the octree
+  std::size_t ncells() const { return cells_.size(); }
+
+  /// computes the potential matrix
+  /// @param obs the basis
+  /// @param theta the opening parameter; smaller values are more accurate (the error decreases roughly as
+  ///        \f$ \theta^3 \f$ ), @c theta=0 computes all integrals exactly
+  /// @param precision the target precision of the exact integrals, also used to estimate the extent of
+  ///        the shell pairs
+  /// @return the potential matrix
+  Matrix compute(const BasisSet& obs, double theta = 0.2,
+                 double precision = std::numeric_limits<double>::epsilon()) const {
+    const auto n = obs.nbf();
+    Matrix result = Matrix::Zero(n, n);
+    if (charges_.empty()) return result;
+
+    Engine nuclear_engine(Operator::nuclear, obs.max_nprim(), obs.max_l(), 0,
+                          precision);
+    Engine multipole_engine(Operator::emultipole3, obs.max_nprim(),
+                            obs.max_l(), 0);
+    const auto& nuclear_buf = nuclear_engine.results();
+    const auto& multipole_buf = multipole_engine.results();
+    const auto& shell2bf = obs.shell2bf();
+    const auto ln_precision = std::log(std::max(precision, 1e-300));
+
+    charges_type near_charges;
+    std::vector<std::size_t> stack;
+    for (auto s1 = 0ul; s1 != obs.size(); ++s1) {
+      const auto& sh1 = obs[s1];
+      const auto n1 = sh1.size();
+      for (auto s2 = 0ul; s2 <= s1; ++s2) {
+        const auto& sh2 = obs[s2];
+        const auto n2 = sh2.size();
+
+        // the center and (estimated) radius of the product distribution
+        std::array<double, 3> O;
+        double AB2 = 0;
+        for (auto xyz = 0; xyz != 3; ++xyz) {
+          O[xyz] = 0.5 * (sh1.O[xyz] + sh2.O[xyz]);
+          AB2 += (sh1.O[xyz] - sh2.O[xyz]) * (sh1.O[xyz] - sh2.O[xyz]);
+        }
+        const auto gamma_min = *std::min_element(sh1.alpha.begin(), sh1.alpha.end()) +
+                               *std::min_element(sh2.alpha.begin(), sh2.alpha.end());
+        const auto r_pair = 0.5 * std::sqrt(AB2) + std::sqrt(-ln_precision / gamma_min);
+
+        // local expansion of the potential of the far cells: derivatives of orders 0..3
+        // in the order of Operator::emultipole3 operators, already divided by the factorials
+        std::array<double, nlocal> local;
+        local.fill(0.0);
+        bool have_far = false;
+        near_charges.clear();
+        stack.assign(1, 0);
+        while (!stack.empty()) {
+          const auto& cell = cells_[stack.back()];
+          stack.pop_back();
+          double d2 = 0;
+          for (auto xyz = 0; xyz != 3; ++xyz)
+            d2 += (O[xyz] - cell.center[xyz]) * (O[xyz] - cell.center[xyz]);
+          const auto rr = cell.radius + r_pair;
+          if (rr * rr < theta * theta * d2) {
+            add_local_expansion(cell, O, local);
+            have_far = true;
+          } else if (cell.leaf()) {
+            near_charges.insert(near_charges.end(), charges_.begin() + cell.begin,
+                                charges_.begin() + cell.end);
+          } else {
+            for (const auto c : cell.children)
+              if (c != 0) stack.push_back(c);
+          }
+        }
+
+        std::vector<double> buf12(n1 * n2, 0.0);
+        if (!near_charges.empty()) {
+          nuclear_engine.set_params(near_charges);
+          nuclear_engine.compute(sh1, sh2);
+          if (nuclear_buf[0] != nullptr)
+            std::copy(nuclear_buf[0], nuclear_buf[0] + n1 * n2, buf12.begin());
+        }
+        if (have_far) {
+          multipole_engine.set_params(O);
+          multipole_engine.compute(sh1, sh2);
+          // N.B. the nuclear potential integrals include the minus sign
+          for (auto op = 0; op != nlocal; ++op) {
+            if (multipole_buf[op] == nullptr) continue;
+            const auto* ints = multipole_buf[op];
+            const auto coeff = -local[op];
+            for (auto i = 0ul; i != n1 * n2; ++i) buf12[i] += coeff * ints[i];
+          }
+        }
+
+        const auto bf1 = shell2bf[s1];
+        const auto bf2 = shell2bf[s2];
+        Eigen::Map<const Matrix> buf12_map(buf12.data(), n1, n2);
+        result.block(bf1, bf2, n1, n2) = buf12_map;
+        if (s1 != s2) result.block(bf2, bf1, n2, n1) = buf12_map.transpose();
+      }
+    }
+
+    return result;
+  }
+
+ private:
+  static constexpr int nlocal = 20;     // # of Cartesian monomials of degree 0..3
+  static constexpr int nmoments = 10;   // # of Cartesian monomials of degree 0..2
+  static constexpr int max_tree_depth = 24;
+
+  struct Cell {
+    std::array<double, 3> center;
+    double radius;  // max distance from center to any charge
+    /// multipole moments \f$ \sum_C q_C (\vec{C}-\vec{Z})^\nu \f$ about the center, in the order
+    /// 1, x, y, z, xx, xy, xz, yy, yz, zz
+    std::array<double, nmoments> moments;
+    std::size_t begin, end;   // charge range
+    std::array<std::size_t, 8> children;  // 0 = no child (the root cannot be a child)
+    bool leaf() const {
+      return std::all_of(children.begin(), children.end(),
+                         [](std::size_t c) { return c == 0; });
+    }
+  };
+
+  charges_type charges_;
+  std::size_t max_leaf_size_;
+  std::vector<Cell> cells_;
+
+  /// exponents of the Cartesian monomials of degree 0..3, in the order of the Operator::emultipole3 operators
+  static const std::array<std::array<int, 3>, nlocal>& monomials() {
+    static const std::array<std::array<int, 3>, nlocal> result{{
+        {{0, 0, 0}},
+        {{1, 0, 0}}, {{0, 1, 0}}, {{0, 0, 1}},
+        {{2, 0, 0}}, {{1, 1, 0}}, {{1, 0, 1}}, {{0, 2, 0}}, {{0, 1, 1}}, {{0, 0, 2}},
+        {{3, 0, 0}}, {{2, 1, 0}}, {{2, 0, 1}}, {{1, 2, 0}}, {{1, 1, 1}},
+        {{1, 0, 2}}, {{0, 3, 0}}, {{0, 2, 1}}, {{0, 1, 2}}, {{0, 0, 3}}}};
+    return result;
+  }
+
+  static double factorial(int n) {
+    double result = 1;
+    for (int i = 2; i <= n; ++i) result *= i;
+    return result;
+  }
+
+  void build_tree() {
+    cells_.clear();
+    if (charges_.empty()) return;
+    cells_.reserve(2 * charges_.size() / max_leaf_size_ + 1);
+    build_cell(0, charges_.size(), 0);
+  }
+
+  /// makes the cell holding charges [begin,end) and, recursively, its children
+  /// @return the index of the cell
+  std::size_t build_cell(std::size_t begin, std::size_t end, int depth) {
+    const auto index = cells_.size();
+    cells_.emplace_back();
+    {
+      auto& cell = cells_.back();
+      cell.begin = begin;
+      cell.end = end;
+      cell.children.fill(0);
+      // center = center of the bounding box
+      std::array<double, 3> lo, hi;
+      lo.fill(std::numeric_limits<double>::max());
+      hi.fill(std::numeric_limits<double>::lowest());
+      for (auto c = begin; c != end; ++c)
+        for (auto xyz = 0; xyz != 3; ++xyz) {
+          lo[xyz] = std::min(lo[xyz], charges_[c].second[xyz]);
+          hi[xyz] = std::max(hi[xyz], charges_[c].second[xyz]);
+        }
+      for (auto xyz = 0; xyz != 3; ++xyz) cell.center[xyz] = 0.5 * (lo[xyz] + hi[xyz]);
+      cell.radius = 0;
+      cell.moments.fill(0.0);
+      const auto& mono = monomials();
+      for (auto c = begin; c != end; ++c) {
+        const auto q = charges_[c].first;
+        std::array<double, 3> r;
+        double r2 = 0;
+        for (auto xyz = 0; xyz != 3; ++xyz) {
+          r[xyz] = charges_[c].second[xyz] - cell.center[xyz];
+          r2 += r[xyz] * r[xyz];
+        }
+        cell.radius = std::max(cell.radius, std::sqrt(r2));
+        for (auto m = 0; m != nmoments; ++m)
+          cell.moments[m] += q * std::pow(r[0], mono[m][0]) *
+                             std::pow(r[1], mono[m][1]) *
+                             std::pow(r[2], mono[m][2]);
+      }
+    }
+    if (end - begin <= max_leaf_size_ || depth == max_tree_depth ||
+        cells_[index].radius == 0)
+      return index;
+
+    // sort the charges into octants and make the children
+    const auto center = cells_[index].center;
+    auto octant = [&center](const std::pair<double, std::array<double, 3>>& q) {
+      return (q.second[0] > center[0] ? 1 : 0) +
+             (q.second[1] > center[1] ? 2 : 0) +
+             (q.second[2] > center[2] ? 4 : 0);
+    };
+    std::stable_sort(charges_.begin() + begin, charges_.begin() + end,
+                     [&octant](const std::pair<double, std::array<double, 3>>& a,
+                               const std::pair<double, std::array<double, 3>>& b) {
+                       return octant(a) < octant(b);
+                     });
+    auto child_begin = begin;
+    for (int o = 0; o != 8; ++o) {
+      auto child_end = child_begin;
+      while (child_end != end && octant(charges_[child_end]) == o) ++child_end;
+      if (child_end != child_begin) {
+        const auto child = build_cell(child_begin, child_end, depth + 1);
+        cells_[index].children[o] = child;
+      }
+      child_begin = child_end;
+    }
+    return index;
+  }
+
+  /// adds the Taylor expansion about @c O of the potential of the charges in @c cell to @c local ;
+  /// \f$ \partial^\kappa \Phi(\vec{O}) / \kappa! = \sum_\nu (-1)^{|\nu|} M_\nu / (\nu! \kappa!) \, \partial^{\nu+\kappa} (1/R) \f$ ,
+  /// with \f$ \vec{R} = \vec{O} - \vec{Z} \f$ and the derivatives of \f$ 1/R \f$ computed by the McMurchie-Davidson recursion
+  static void add_local_expansion(const Cell& cell,
+                                  const std::array<double, 3>& O,
+                                  std::array<double, nlocal>& local) {
+    constexpr int L = 5;  // max total order of derivatives = 2 (moments) + 3 (local expansion)
+    const double X[3] = {O[0] - cell.center[0], O[1] - cell.center[1],
+                         O[2] - cell.center[2]};
+    const auto R2 = X[0] * X[0] + X[1] * X[1] + X[2] * X[2];
+    const auto oneoverR2 = 1 / R2;
+
+    // R[n][t][u][v], t+u+v <= L-n
+    double R[L + 1][L + 1][L + 1][L + 1];
+    // R_{000}^{(n)} = (-1)^n (2n-1)!! / R^{2n+1}
+    R[0][0][0][0] = std::sqrt(oneoverR2);
+    for (int n = 1; n <= L; ++n)
+      R[n][0][0][0] = -(2 * n - 1) * oneoverR2 * R[n - 1][0][0][0];
+    for (int n = L - 1; n >= 0; --n) {
+      const auto m = L - n;  // max t+u+v at this n
+      for (int t = 0; t <= m; ++t)
+        for (int u = 0; u <= m - t; ++u)
+          for (int v = 0; v <= m - t - u; ++v) {
+            if (t + u + v == 0) continue;
+            double value;
+            if (t > 0)
+              value = X[0] * R[n + 1][t - 1][u][v] +
+                      (t > 1 ? (t - 1) * R[n + 1][t - 2][u][v] : 0.0);
+            else if (u > 0)
+              value = X[1] * R[n + 1][t][u - 1][v] +
+                      (u > 1 ? (u - 1) * R[n + 1][t][u - 2][v] : 0.0);
+            else
+              value = X[2] * R[n + 1][t][u][v - 1] +
+                      (v > 1 ? (v - 1) * R[n + 1][t][u][v - 2] : 0.0);
+            R[n][t][u][v] = value;
+          }
+    }
+
+    const auto& mono = monomials();
+    for (auto k = 0; k != nlocal; ++k) {
+      const auto& kappa = mono[k];
+      double value = 0;
+      for (auto m = 0; m != nmoments; ++m) {
+        const auto& nu = mono[m];
+        const auto sign = ((nu[0] + nu[1] + nu[2]) % 2) ? -1.0 : 1.0;
+        const auto nu_factorial =
+            factorial(nu[0]) * factorial(nu[1]) * factorial(nu[2]);
+        value += sign * cell.moments[m] / nu_factorial *
+                 R[0][nu[0] + kappa[0]][nu[1] + kappa[1]][nu[2] + kappa[2]];
+      }
+      local[k] += value / (factorial(kappa[0]) * factorial(kappa[1]) *
+                           factorial(kappa[2]));
+    }
+  }
+};
+
+}  // namespace libint2
+
+#endif /* _libint2_src_lib_libint_pointchargepotential_h_ */
@@ -0,0 +1,439 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_rys_h_
+#define _libint2_src_lib_libint_rys_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/rys.h requires C++11 support"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <libint2/boys.h>
+
+namespace libint2 {
+
+  /** Computes the roots and weights of the Rys quadrature, i.e. the \f$ n \f$-point Gauss quadrature
+    * for the weight function \f$ \exp(-T t^2) \f$ on \f$ t \in [0,1] \f$, expressed in terms of \f$ u = t^2 \f$ ,
+    * hence \f$ \sum_{i=1}^{n} w_i u_i^m = F_m(T) \f$ exactly for \f$ 0 \leq m < 2n \f$ .
+    * The quadrature is obtained from the recurrence coefficients of the Rys polynomials, computed by the discretized
+    * Stieltjes procedure, by diagonalizing the Jacobi matrix (the Golub-Welsch algorithm).
+    * This is slow and should be used for reference purposes, e.g. computing the interpolation tables.
+    *
+    * @tparam Real the type to use for all floating-point computations.
+    */
+  template <typename Real = double>
+  struct RysEval_Reference {
+
+      /// computes the roots and weights of the @c n -point Rys quadrature
+      /// @param[out] u the roots, \f$ u_i = t_i^2 \f$ , in increasing order; must be at least @c n elements long
+      /// @param[out] w the weights; must be at least @c n elements long
+      /// @param[in] T the argument of the Boys function
+      /// @param[in] n the number of roots
+      static void eval(Real* u, Real* w, Real T, int n) {
+        assert(n > 0);
+        std::vector<Real> alpha(n), beta(n);
+        const auto mu0 = recurrence_coefficients(alpha.data(), beta.data(), T, n);
+        gauss(u, w, alpha.data(), beta.data(), mu0, n);
+      }
+
+      /// computes the roots and weights of the Rys quadratures with 1 to @c n_max points; this is cheaper
+      /// than computing each quadrature with eval() since all share the recurrence coefficients
+      /// @param[out] uw for each @c n the @c n roots followed by the @c n weights are stored at \c uw+n*(n-1) ;
+      ///             must be at least @c n_max*(n_max+1) elements long
+      /// @param[in] T the argument of the Boys function
+      /// @param[in] n_max the maximum number of roots
+      static void eval_all(Real* uw, Real T, int n_max) {
+        assert(n_max > 0);
+        std::vector<Real> alpha(n_max), beta(n_max);
+        const auto mu0 = recurrence_coefficients(alpha.data(), beta.data(), T, n_max);
+        for(int n=1; n<=n_max; ++n) {
+          Real* u = uw + n*(n-1);
+          gauss(u, u + n, alpha.data(), beta.data(), mu0, n);
+        }
+      }
+
+      /// computes the roots and weights of the @c n -point Rys quadrature for \f$ T \to \infty \f$ , scaled by \f$ T \f$ and
+      /// \f$ \sqrt{T} \f$ , respectively, i.e. the squares of the positive roots of the Hermite polynomial \f$ H_{2n} \f$ and
+      /// the corresponding Gauss-Hermite weights
+      /// @param[out] u the scaled roots in increasing order; must be at least @c n elements long
+      /// @param[out] w the scaled weights; must be at least @c n elements long
+      /// @param[in] n the number of roots
+      static void eval_asymptotic(Real* u, Real* w, int n) {
+        assert(n > 0);
+        const auto n2 = 2*n;
+        std::vector<Real> d(n2, Real(0)), e(n2), z(n2, Real(0));
+        using std::sqrt;
+        e[0] = 0;
+        for(int k=1; k!=n2; ++k)
+          e[k] = sqrt(Real(k)/2);
+        z[0] = 1;
+        eigen_tridiagonal(d.data(), e.data(), z.data(), n2);
+        const Real sqrt_pi = sqrt(Real(4) * atan(Real(1)));
+        int i = 0;
+        for(int k=0; k!=n2; ++k) {
+          if (d[k] > 0) {
+            u[i] = d[k] * d[k];
+            w[i] = sqrt_pi * z[k] * z[k];
+            ++i;
+          }
+        }
+        assert(i == n);
+        sort(u, w, n);
+      }
+
+    private:
+
+      /// computes the recurrence coefficients of the orthonormal Rys polynomials in \f$ u \f$ by the Stieltjes procedure
+      /// applied to a discretization of the weight function
+      /// @param[out] alpha the diagonal of the Jacobi matrix
+      /// @param[out] beta beta[k] , k=1 .. n-1, are the off-diagonal elements of the Jacobi matrix; beta[0] = 0
+      /// @return the zeroth moment of the weight function, \f$ F_0(T) \f$
+      static Real recurrence_coefficients(Real* alpha, Real* beta, Real T, int n) {
+        const auto& quad = discretization();
+        const auto npts = quad.size() / 2;
+
+        // the discrete measure: x_j = t_j^2 with weights W_j = w_j exp(-T t_j^2)
+        std::vector<Real> x(npts), W(npts), q0(npts, Real(0)), q1(npts);
+        Real mu0 = 0;
+        using std::exp;
+        using std::sqrt;
+        for(size_t j=0; j!=npts; ++j) {
+          const auto t = quad[2*j];
+          x[j] = t*t;
+          W[j] = quad[2*j+1] * exp(-T * x[j]);
+          mu0 += W[j];
+        }
+
+        // q1 = q_k, q0 = q_{k-1}
+        std::fill(q1.begin(), q1.end(), 1 / sqrt(mu0));
+        beta[0] = 0;
+        for(int k=0; k!=n; ++k) {
+          Real a = 0;
+          for(size_t j=0; j!=npts; ++j)
+            a += W[j] * x[j] * q1[j] * q1[j];
+          alpha[k] = a;
+          if (k+1 == n)
+            break;
+          Real b2 = 0;
+          for(size_t j=0; j!=npts; ++j) {
+            const auto r = (x[j] - a) * q1[j] - beta[k] * q0[j];
+            q0[j] = r;
+            b2 += W[j] * r * r;
+          }
+          beta[k+1] = sqrt(b2);
+          const auto oob = 1 / beta[k+1];
+          for(size_t j=0; j!=npts; ++j) {
+            const auto r = q0[j] * oob;
+            q0[j] = q1[j];
+            q1[j] = r;
+          }
+        }
+        return mu0;
+      }
+
+      /// computes the @c n -point Gauss quadrature from the leading @c n recurrence coefficients (the Golub-Welsch algorithm)
+      static void gauss(Real* u, Real* w, const Real* alpha, const Real* beta, Real mu0, int n) {
+        std::vector<Real> e(beta, beta + n), z(n, Real(0));
+        z[0] = 1;
+        std::copy(alpha, alpha + n, u);
+        eigen_tridiagonal(u, e.data(), z.data(), n);
+        for(int i=0; i!=n; ++i)
+          w[i] = mu0 * z[i] * z[i];
+        sort(u, w, n);
+      }
+
+      /// sorts the quadrature by increasing root
+      static void sort(Real* u, Real* w, int n) {
+        for(int i=1; i<n; ++i) {
+          for(int j=i; j>0 && u[j-1] > u[j]; --j) {
+            std::swap(u[j-1], u[j]);
+            std::swap(w[j-1], w[j]);
+          }
+        }
+      }
+
+      /// composite Gauss-Legendre quadrature on [0,1], as pairs {node, weight}
+      static const std::vector<Real>& discretization() {
+        // thread-safe per C++11 standard [6.7.4]
+        static const std::vector<Real> result = make_discretization(16, 20);
+        return result;
+      }
+
+      static std::vector<Real> make_discretization(int npanels, int npts_per_panel) {
+        using std::cos;
+        using std::abs;
+        const Real pi = Real(4) * atan(Real(1));
+        const auto m = npts_per_panel;
+        // Gauss-Legendre nodes and weights on [-1,1] by Newton iterations
+        std::vector<Real> t(m), w(m);
+        for(int i=0; i!=m; ++i) {
+          Real x = cos(pi * (i + Real(0.75)) / (m + Real(0.5)));
+          Real dp = 0;
+          for(int iter=0; iter!=100; ++iter) {
+            Real p0 = 1, p1 = x;
+            for(int k=2; k<=m; ++k) {
+              const Real p2 = ((2*k-1) * x * p1 - (k-1) * p0) / k;
+              p0 = p1;
+              p1 = p2;
+            }
+            dp = m * (x * p1 - p0) / (x*x - 1);
+            const auto dx = p1 / dp;
+            x -= dx;
+            if (abs(dx) <= std::numeric_limits<Real>::epsilon())
+              break;
+          }
+          t[i] = x;
+          w[i] = 2 / ((1 - x*x) * dp * dp);
+        }
+        std::vector<Real> result;
+        result.reserve(2 * npanels * m);
+        const Real h = Real(1) / npanels;
+        for(int p=0; p!=npanels; ++p) {
+          for(int i=0; i!=m; ++i) {
+            result.push_back(h * (p + (t[i] + 1) / 2));
+            result.push_back(h * w[i] / 2);
+          }
+        }
+        return result;
+      }
+
+      /// computes the eigenvalues and the first components of the eigenvectors of a symmetric tridiagonal matrix
+      /// by the implicit QL algorithm
+      /// @param[in,out] d on input the diagonal, on output the eigenvalues (unsorted)
+      /// @param[in,out] e e[1] ... e[n-1] are the subdiagonal elements on input, destroyed on output
+      /// @param[in,out] z on input the first row of the identity matrix, on output the first components of the eigenvectors
+      static void eigen_tridiagonal(Real* d, Real* e, Real* z, int n) {
+        using std::abs;
+        using std::sqrt;
+        for(int i=1; i<n; ++i)
+          e[i-1] = e[i];
+        e[n-1] = 0;
+        for(int l=0; l<n; ++l) {
+          int iter = 0;
+          int m;
+          do {
+            for(m=l; m<n-1; ++m) {
+              const Real dd = abs(d[m]) + abs(d[m+1]);
+              if (abs(e[m]) <= std::numeric_limits<Real>::epsilon() * dd)
+                break;
+            }
+            if (m != l) {
+              if (++iter == 60)
+                throw std::runtime_error("RysEval_Reference: the QL algorithm did not converge");
+              Real g = (d[l+1] - d[l]) / (2 * e[l]);
+              Real r = hypot(g, Real(1));
+              g = d[m] - d[l] + e[l] / (g + (g >= 0 ? abs(r) : -abs(r)));
+              Real s = 1, c = 1, p = 0;
+              int i;
+              for(i=m-1; i>=l; --i) {
+                Real f = s * e[i];
+                const Real b = c * e[i];
+                e[i+1] = (r = hypot(f, g));
+                if (r == 0) {
+                  d[i+1] -= p;
+                  e[m] = 0;
+                  break;
+                }
+                s = f / r;
+                c = g / r;
+                g = d[i+1] - p;
+                r = (d[i] - g) * s + 2 * c * b;
+                d[i+1] = g + (p = s * r);
+                g = c * r - b;
+                f = z[i+1];
+                z[i+1] = s * z[i] + c * f;
+                z[i] = c * z[i] - s * f;
+              }
+              if (r == 0 && i >= l)
+                continue;
+              d[l] -= p;
+              e[l] = g;
+              e[m] = 0;
+            }
+          } while (m != l);
+        }
+      }
+
+  };
+
+  /** Computes the roots and weights of the Rys quadrature (see RysEval_Reference )
+    * using 7-th order Chebyshev interpolation for \f$ T \leq T_{\rm crit} \f$ and the asymptotic (Gauss-Hermite)
+    * quadrature for \f$ T > T_{\rm crit} \f$ . The interpolation tables are computed by the constructor.
+    */
+  template <typename Real = double>
+  class RysEval_Chebyshev7 {
+
+      static_assert(std::is_same<Real,double>::value, "RysEval_Chebyshev7 only supports double as the real type");
+
+      static constexpr const int ORDER = 7;           //!< interpolation order
+      static constexpr const int ORDERp1 = ORDER+1;   //!< ORDER + 1
+
+      static constexpr const int nintervals = 512;    //!< the number of interpolation intervals
+      static constexpr const Real T_crit = 117.0;     //!< critical value of T above which the asymptotic quadrature is exact in double precision
+      static constexpr const Real delta = T_crit / nintervals;   //!< interval size
+      static constexpr const Real one_over_delta = 1/delta;      //!< 1/delta
+
+      int nmax;                   //!< the maximum number of roots that is tabulated
+      std::vector<Real> c_;       //!< the interpolation coefficients, for each interval and n the roots and then the weights
+      std::vector<Real> u_asymptotic_, w_asymptotic_;  //!< the scaled asymptotic roots and weights, for n = 1 .. nmax
+
+    public:
+      /// \param n_max maximum number of roots; set to 0 to skip initialization
+      /// \throw std::invalid_argument if \c n_max is greater than max_n_tabulated()
+      RysEval_Chebyshev7(int n_max) : nmax(n_max) {
+        if (nmax > max_n_tabulated())
+          throw std::invalid_argument(
+              "RysEval_Chebyshev7 : requested n_max exceeds the hard-coded n_max");
+        if (nmax > 0)
+          init_table();
+      }
+
+      /// Singleton interface allows to manage the lone instance; adjusts max n values as needed in thread-safe fashion
+      /// @note lock-free unless a larger instance must be created
+      static std::shared_ptr<const RysEval_Chebyshev7> instance(int n_max) {
+        assert(n_max > 0);
+        typedef detail::core_eval_registry<const RysEval_Chebyshev7> registry;
+        return registry::nonowning_ptr(registry::instance(
+            [n_max](const RysEval_Chebyshev7& x) { return x.max_n() >= n_max; },
+            [n_max](const RysEval_Chebyshev7* x) {
+              return new RysEval_Chebyshev7(std::max(n_max, x ? x->max_n() : 0));
+            }));
+      }
+
+      /// @return the maximum number of roots that can be tabulated
+      static constexpr int max_n_tabulated() { return 20; }
+
+      /// @return the maximum number of roots that can be computed with this object
+      int max_n() const { return nmax; }
+
+      /// computes the roots and weights of the @c n -point Rys quadrature
+      /// @param[out] u the roots, \f$ u_i = t_i^2 \f$ , in increasing order; must be at least @c n elements long
+      /// @param[out] w the weights; must be at least @c n elements long
+      /// @param[in] T the argument of the Boys function
+      /// @param[in] n the number of roots; must be <= the value returned by max_n
+      inline void eval(Real* u, Real* w, Real T, int n) const {
+        assert(n > 0 && n <= nmax);
+
+        // large T => asymptotic quadrature
+        if (T > T_crit) {
+          using std::sqrt;
+          const auto one_over_T = 1 / T;
+          const auto one_over_sqrt_T = sqrt(one_over_T);
+          const auto offset = n * (n-1) / 2;
+          const auto* ua = &u_asymptotic_[offset];
+          const auto* wa = &w_asymptotic_[offset];
+          for(int i=0; i!=n; ++i) {
+            u[i] = ua[i] * one_over_T;
+            w[i] = wa[i] * one_over_sqrt_T;
+          }
+          return;
+        }
+
+        // which interval does this T fall into?
+        const Real T_over_delta = T * one_over_delta;
+        const int iv = std::min(int(T_over_delta), nintervals - 1); // the interval index
+        const Real xd = T_over_delta - (Real)iv - 0.5; // this ranges from -0.5 to 0.5
+        const Real* d = &c_[(iv * nmax * (nmax + 1) + n * (n-1)) * ORDERp1];
+        for(int i=0; i!=n; ++i, d+=ORDERp1)
+          u[i] = interpolate(d, xd);
+        for(int i=0; i!=n; ++i, d+=ORDERp1)
+          w[i] = interpolate(d, xd);
+      }
+
+    private:
+
+      static Real interpolate(const Real* d, Real xd) {
+        return d[0]
+             + xd * (d[1]
+             + xd * (d[2]
+             + xd * (d[3]
+             + xd * (d[4]
+             + xd * (d[5]
+             + xd * (d[6]
+             + xd * (d[7])))))));
+      }
+
+      void init_table() {
+        using std::cos;
+        const Real pi = Real(4) * atan(Real(1));
+
+        // asymptotic roots and weights
+        u_asymptotic_.resize(nmax * (nmax + 1) / 2);
+        w_asymptotic_.resize(nmax * (nmax + 1) / 2);
+        for(int n=1; n<=nmax; ++n)
+          RysEval_Reference<Real>::eval_asymptotic(&u_asymptotic_[n*(n-1)/2], &w_asymptotic_[n*(n-1)/2], n);
+
+        // the Chebyshev interpolation nodes in [-1,1], and the monomial coefficients of the Chebyshev polynomials
+        // in terms of the reduced argument xd = s/2
+        Real s[ORDERp1];
+        for(int k=0; k!=ORDERp1; ++k)
+          s[k] = cos(pi * (k + Real(0.5)) / ORDERp1);
+        Real tcoef[ORDERp1][ORDERp1] = {};  // tcoef[j][p] = coefficient of s^p in T_j(s)
+        tcoef[0][0] = 1;
+        tcoef[1][1] = 1;
+        for(int j=2; j!=ORDERp1; ++j) {
+          for(int p=0; p!=ORDERp1; ++p)
+            tcoef[j][p] = (p > 0 ? 2 * tcoef[j-1][p-1] : Real(0)) - tcoef[j-2][p];
+        }
+
+        const auto ncoefs_per_interval = nmax * (nmax + 1) * ORDERp1;
+        c_.resize(nintervals * ncoefs_per_interval);
+        std::vector<Real> values(ORDERp1 * nmax * (nmax + 1));  // for each node, the roots and weights of n = 1 .. nmax
+        for(int iv=0; iv!=nintervals; ++iv) {
+          for(int k=0; k!=ORDERp1; ++k) {
+            const Real T = delta * (iv + Real(0.5) + s[k] / 2);
+            RysEval_Reference<Real>::eval_all(&values[k * nmax * (nmax + 1)], T, nmax);
+          }
+          // Chebyshev coefficients of each tabulated function, converted to the monomial basis in xd
+          Real* civ = &c_[iv * ncoefs_per_interval];
+          for(int f=0; f!=nmax * (nmax + 1); ++f) {
+            Real cheb[ORDERp1];
+            for(int j=0; j!=ORDERp1; ++j) {
+              Real sum = 0;
+              for(int k=0; k!=ORDERp1; ++k)
+                sum += values[k * nmax * (nmax + 1) + f] * cos(pi * j * (k + Real(0.5)) / ORDERp1);
+              cheb[j] = sum * (j == 0 ? Real(1) : Real(2)) / ORDERp1;
+            }
+            Real* d = civ + f * ORDERp1;
+            Real two_to_p = 1;
+            for(int p=0; p!=ORDERp1; ++p, two_to_p *= 2) {
+              Real sum = 0;
+              for(int j=p; j!=ORDERp1; ++j)
+                sum += cheb[j] * tcoef[j][p];
+              d[p] = sum * two_to_p;
+            }
+          }
+        }
+      }
+
+  };
+
+}  // namespace libint2
+
+#endif // header guard
@@ -31,6 +31,8 @@
 #include <vector>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
+#include <cstdint>
 
 #include <libint2.h>
 
@@ -319,46 +321,96 @@ namespace libint2 {
     return os;
   }
 
-  /// ShellPair pre-computes shell-pair data, primitive pairs are screened to finite precision
+  /// ShellPair pre-computes shell-pair data, primitive pairs are screened to finite precision.
+  /// Primitive pair data is stored as a structure of arrays, i.e. each field is a contiguous
+  /// array of nprimpairs() elements aligned to ShellPair::align_size bytes. Primitive pairs are
+  /// sorted by descending screening factor (see ShellPair::scr()), hence screening of primitive
+  /// pairs (and quartets) can stop at the first primitive pair that fails the screening test.
+  /// A ShellPair either owns its primitive pair data or is a read-only view of the data
+  /// kept by a ShellPairDatabase.
   struct ShellPair {
       typedef Shell::real_t real_t;
 
-      struct PrimPairData {
-          real_t P[3]; //!< \f$ (\alpha_1 \vec{A} + \alpha_2 \vec{B})/(\alpha_1 + \alpha_2) \f$
-          real_t K;
-          real_t one_over_gamma;
-          real_t scr;
-          int p1;
-          int p2;
-      };
+      /// alignment of the primitive pair data arrays, in bytes
+      static constexpr std::size_t align_size = 32;
 
-      std::vector<PrimPairData> primpairs;
       real_t AB[3];
 
-      ShellPair() : primpairs() { for(int i=0; i!=3; ++i) AB[i] = 0.; }
+      ShellPair() : nprimpairs_(0), capacity_(0), stride_(0) { for(int i=0; i!=3; ++i) AB[i] = 0.; }
 
-      ShellPair(size_t max_nprim) : primpairs() {
-        primpairs.reserve(max_nprim*max_nprim);
-        for(int i=0; i!=3; ++i) AB[i] = 0.;
+      ShellPair(size_t max_nprim) : ShellPair() {
+        resize(max_nprim);
       }
-      template <typename Real> ShellPair(const Shell& s1, const Shell& s2, Real ln_prec) {
+      template <typename Real> ShellPair(const Shell& s1, const Shell& s2, Real ln_prec) : ShellPair() {
         init(s1, s2, ln_prec);
       }
 
+      // the aligned arrays can start at different offsets in the copy, hence copy field by field;
+      // copies of views are views of the same data
+      ShellPair(const ShellPair& other) : ShellPair() {
+        *this = other;
+      }
+      ShellPair(ShellPair&&) = default;
+      ShellPair& operator=(const ShellPair& other) {
+        if (this != &other && other.is_view()) {
+          for(int i=0; i!=3; ++i) AB[i] = other.AB[i];
+          nprimpairs_ = other.nprimpairs_;
+          capacity_ = other.capacity_;
+          stride_ = other.stride_;
+          rview_ = other.rview_;
+          iview_ = other.iview_;
+        }
+        else if (this != &other) {
+          for(int i=0; i!=3; ++i) AB[i] = other.AB[i];
+          make_owner();
+          reserve(other.capacity_);
+          nprimpairs_ = other.nprimpairs_;
+          for(int f=0; f!=nrealfields; ++f)
+            std::copy(other.field(f), other.field(f) + nprimpairs_, field(f));
+          std::copy(other.p1(), other.p1() + nprimpairs_, p1_ptr());
+          std::copy(other.p2(), other.p2() + nprimpairs_, p2_ptr());
+        }
+        return *this;
+      }
+      ShellPair& operator=(ShellPair&&) = default;
+
+      /// ensures that pairs of shells with up to @c max_nprim primitives each can be initialized
+      /// without reallocating memory
+      /// @note if memory is reallocated the primitive pair data is discarded, i.e. nprimpairs() is reset to 0
       void resize(std::size_t max_nprim) {
-        const auto max_nprim2 = max_nprim * max_nprim;
-        if (max_nprim * max_nprim > primpairs.size())
-          primpairs.resize(max_nprim2);
+        reserve(max_nprim * max_nprim);
       }
 
+      /// @return the number of primitive pairs that can be stored without reallocating memory
+      std::size_t max_nprimpairs() const { return capacity_; }
+
+      /// @return the number of primitive pairs that survived the screening
+      std::size_t nprimpairs() const { return nprimpairs_; }
+
+      /// @return true if this object does not own its primitive pair data, i.e. it refers to the data of a ShellPairDatabase
+      bool is_view() const { return rview_ != nullptr; }
+
+      /// @param xyz the Cartesian component
+      /// @return pointer to the @c xyz component of \f$ (\alpha_1 \vec{A} + \alpha_2 \vec{B})/(\alpha_1 + \alpha_2) \f$ of each primitive pair
+      const real_t* P(int xyz) const { return field(xyz); }
+      /// @return pointer to \f$ \exp(-|\vec{A}-\vec{B}|^2 \alpha_1 \alpha_2 / (\alpha_1 + \alpha_2)) / (\alpha_1 + \alpha_2) \f$ of each primitive pair
+      const real_t* K() const { return field(3); }
+      /// @return pointer to \f$ 1 / (\alpha_1 + \alpha_2) \f$ of each primitive pair
+      const real_t* one_over_gamma() const { return field(4); }
+      /// @return pointer to the (log of the) screening factor of each primitive pair; the values are in descending order
+      const real_t* scr() const { return field(5); }
+      /// @return pointer to the index of the primitive in the first shell of each primitive pair
+      const int* p1() const { return is_view() ? iview_ : idata_.data(); }
+      /// @return pointer to the index of the primitive in the second shell of each primitive pair
+      const int* p2() const { return p1() + stride_; }
+
       /// initializes "expensive" primitive pair data; a pair of primitives with exponents \f$ \{\alpha_a,\alpha_b\} \f$
       /// located at \f$ \{ \vec{A},\vec{B} \} \f$ whose max coefficients in contractions are \f$ \{ \max{|c_a|} , \max{|c_b|} \} \f$ is screened-out (omitted)
       /// if \f$ \exp(-|\vec{A}-\vec{B}|^2 \alpha_a * \alpha_b / (\alpha_a + \alpha_b)) \max{|c_a|} \max{|c_b|} \leq \epsilon \f$
       /// where \f$ \epsilon \f$ is the desired precision of the integrals.
+      /// @note memory is only (re)allocated if the number of primitive pairs exceeds max_nprimpairs()
       template <typename Real> void init(const Shell& s1, const Shell& s2, Real ln_prec) {
 
-        primpairs.clear();
-
         const auto& A = s1.O;
         const auto& B = s2.O;
         real_t AB2 = 0.;
@@ -367,43 +419,144 @@ namespace libint2 {
           AB2 += AB[i]*AB[i];
         }
 
+        const auto nprim1 = s1.alpha.size();
+        const auto nprim2 = s2.alpha.size();
+        make_owner();
+        reserve(nprim1 * nprim2);
+
+        // screen primitive pairs, keep the screening factors of the survivors in the scratch arrays ...
         size_t c = 0;
-        for(size_t p1=0; p1!=s1.alpha.size(); ++p1) {
-          for(size_t p2=0; p2!=s2.alpha.size(); ++p2) {
+        for(size_t p1=0; p1!=nprim1; ++p1) {
+          for(size_t p2=0; p2!=nprim2; ++p2) {
 
             const auto& a1 = s1.alpha[p1];
             const auto& a2 = s2.alpha[p2];
-            const auto gamma = a1 + a2;
-            const auto oogamma = 1 / gamma;
-
-            const auto rho = a1 * a2 * oogamma;
-            const auto minus_rho_times_AB2 = -rho*AB2;
-            const auto screen_fac = minus_rho_times_AB2 + s1.max_ln_coeff[p1] + s2.max_ln_coeff[p2];
+            const auto rho = a1 * a2 / (a1 + a2);
+            const auto screen_fac = -rho*AB2 + s1.max_ln_coeff[p1] + s2.max_ln_coeff[p2];
             if (screen_fac < ln_prec)
               continue;
 
-            primpairs.resize(c+1);
-            PrimPairData& p = primpairs[c];
-            p.scr = screen_fac;
-            p.p1 = p1;
-            p.p2 = p2;
-            p.K = exp(minus_rho_times_AB2) * oogamma;
-            if (AB2 == 0.) {  // this buys a bit more precision
-              p.P[0] = A[0];
-              p.P[1] = A[1];
-              p.P[2] = A[2];
-            } else {
-              p.P[0] = (a1 * A[0] + a2 * B[0]) * oogamma;
-              p.P[1] = (a1 * A[1] + a2 * B[1]) * oogamma;
-              p.P[2] = (a1 * A[2] + a2 * B[2]) * oogamma;
-            }
-            p.one_over_gamma = oogamma;
-
+            scr_unsorted_[c] = screen_fac;
+            order_[c] = p1 * nprim2 + p2;
             ++c;
           }
         }
+        nprimpairs_ = c;
+
+        // ... sort them by descending screening factor (ties are broken by primitive indices, to be deterministic) ...
+        const auto* scr_unsorted = scr_unsorted_.data();
+        for(size_t i=0; i!=c; ++i) perm_[i] = i;
+        std::sort(perm_.begin(), perm_.begin() + c, [scr_unsorted](int i, int j) {
+          return scr_unsorted[i] > scr_unsorted[j] || (scr_unsorted[i] == scr_unsorted[j] && i < j);
+        });
+
+        // ... and compute the rest of the primitive pair data in sorted order
+        real_t* Px = field(0);
+        real_t* Py = field(1);
+        real_t* Pz = field(2);
+        real_t* K = field(3);
+        real_t* one_over_gamma = field(4);
+        real_t* scr = field(5);
+        int* pp1 = p1_ptr();
+        int* pp2 = p2_ptr();
+        for(size_t i=0; i!=c; ++i) {
+          const auto u = perm_[i];
+          const auto p1 = order_[u] / nprim2;
+          const auto p2 = order_[u] % nprim2;
+
+          const auto& a1 = s1.alpha[p1];
+          const auto& a2 = s2.alpha[p2];
+          const auto gamma = a1 + a2;
+          const auto oogamma = 1 / gamma;
+          const auto rho = a1 * a2 * oogamma;
+
+          scr[i] = scr_unsorted[u];
+          pp1[i] = p1;
+          pp2[i] = p2;
+          K[i] = exp(-rho*AB2) * oogamma;
+          if (AB2 == 0.) {  // this buys a bit more precision
+            Px[i] = A[0];
+            Py[i] = A[1];
+            Pz[i] = A[2];
+          } else {
+            Px[i] = (a1 * A[0] + a2 * B[0]) * oogamma;
+            Py[i] = (a1 * A[1] + a2 * B[1]) * oogamma;
+            Pz[i] = (a1 * A[2] + a2 * B[2]) * oogamma;
+          }
+          one_over_gamma[i] = oogamma;
+        }
       }
 
+    private:
+      friend class ShellPairDatabase;
+
+      static constexpr int nrealfields = 6;  // P[3], K, one_over_gamma, scr
+      static constexpr std::size_t align_nreal = align_size / sizeof(real_t);
+
+      /// @return @c n rounded up to a multiple of align_nreal
+      static std::size_t padded_size(std::size_t n) {
+        return (n + align_nreal - 1) / align_nreal * align_nreal;
+      }
+
+      /// constructs a view of primitive pair data
+      /// @param rdata the real fields, each @c stride elements long, must be aligned to align_size bytes
+      /// @param idata the primitive indices, each @c stride elements long
+      ShellPair(const real_t (&ab)[3], std::size_t nprimpairs, std::size_t stride,
+                const real_t* rdata, const int* idata)
+          : nprimpairs_(nprimpairs), capacity_(nprimpairs), stride_(stride),
+            rview_(rdata), iview_(idata) {
+        for(int i=0; i!=3; ++i) AB[i] = ab[i];
+      }
+
+      std::size_t nprimpairs_;
+      std::size_t capacity_;  // max # of primitive pairs
+      std::size_t stride_;    // capacity_ rounded up to a multiple of align_nreal
+      std::vector<real_t> rdata_;  // real fields, each stride_ long, plus padding for alignment
+      std::vector<int> idata_;     // p1 and p2, each stride_ long
+      // scratch used by init()
+      std::vector<real_t> scr_unsorted_;
+      std::vector<int> order_;
+      std::vector<int> perm_;
+      // non-null if this is a view
+      const real_t* rview_ = nullptr;
+      const int* iview_ = nullptr;
+
+      /// turns a view into an (empty) owner of primitive pair data
+      void make_owner() {
+        if (is_view()) {
+          rview_ = nullptr;
+          iview_ = nullptr;
+          nprimpairs_ = 0;
+          capacity_ = 0;
+          stride_ = 0;
+        }
+      }
+
+      /// grows the storage to hold at least @c n primitive pairs, never shrinks
+      /// @note if the storage grows the primitive pair data is discarded
+      void reserve(std::size_t n) {
+        if (n <= capacity_)
+          return;
+        nprimpairs_ = 0;
+        capacity_ = n;
+        stride_ = padded_size(n);
+        rdata_.resize(nrealfields * stride_ + align_nreal);
+        idata_.resize(2 * stride_);
+        scr_unsorted_.resize(n);
+        order_.resize(n);
+        perm_.resize(n);
+      }
+
+      const real_t* field(int f) const {
+        return is_view() ? rview_ + f * stride_ : const_cast<ShellPair*>(this)->field(f);
+      }
+      real_t* field(int f) {
+        auto base = reinterpret_cast<std::uintptr_t>(rdata_.data());
+        base = (base + align_size - 1) & ~(align_size - 1);
+        return reinterpret_cast<real_t*>(base) + f * stride_;
+      }
+      int* p1_ptr() { return idata_.data(); }
+      int* p2_ptr() { return idata_.data() + stride_; }
   };
 
 } // namespace libint2
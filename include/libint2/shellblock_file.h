@@ -0,0 +1,209 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_shellblockfile_h_
+#define _libint2_src_lib_libint_shellblockfile_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/shellblock_file.h requires C++11 support"
+#endif
+
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <ios>
+#include <string>
+#include <vector>
+
+namespace libint2 {
+
+/// ShellBlockFileWriter writes blocks of integrals, e.g. the shell sets computed by Engine, to a file.
+
+/// Each call to write() appends a record, i.e. a block of doubles tagged by an integer key (such as
+/// a shell-pair index). The records are stored back to back, and close() appends the index of the
+/// records, i.e. their keys and sizes, hence the file can be read with ShellBlockFileReader.
+class ShellBlockFileWriter {
+ public:
+  /// @param filename the name of the file; an existing file is overwritten
+  /// @throw std::ios_base::failure if the file cannot be opened
+  explicit ShellBlockFileWriter(const std::string& filename)
+      : os_(filename, std::ios::binary | std::ios::trunc), filename_(filename) {
+    if (!os_)
+      throw std::ios_base::failure("ShellBlockFileWriter: could not open " +
+                                   filename);
+  }
+  ShellBlockFileWriter(const ShellBlockFileWriter&) = delete;
+  ShellBlockFileWriter& operator=(const ShellBlockFileWriter&) = delete;
+
+  ~ShellBlockFileWriter() {
+    if (os_.is_open()) {
+      try {
+        close();
+      } catch (...) {
+      }
+    }
+  }
+
+  /// appends a record
+  /// @param[in] key the key of the record
+  /// @param[in] data the data of the record
+  /// @param[in] size the number of elements in @c data
+  /// @throw std::ios_base::failure if the data could not be written
+  void write(std::size_t key, const double* data, std::size_t size) {
+    assert(os_.is_open());
+    os_.write(reinterpret_cast<const char*>(data), size * sizeof(double));
+    if (!os_)
+      throw std::ios_base::failure("ShellBlockFileWriter: could not write " +
+                                   filename_);
+    keys_.push_back(key);
+    sizes_.push_back(size);
+  }
+
+  /// writes the index and closes the file
+  /// @throw std::ios_base::failure if the index could not be written
+  void close() {
+    const uint64_t nrecords = keys_.size();
+    os_.write(reinterpret_cast<const char*>(keys_.data()),
+              nrecords * sizeof(uint64_t));
+    os_.write(reinterpret_cast<const char*>(sizes_.data()),
+              nrecords * sizeof(uint64_t));
+    os_.write(reinterpret_cast<const char*>(&nrecords), sizeof(uint64_t));
+    os_.close();
+    if (!os_)
+      throw std::ios_base::failure("ShellBlockFileWriter: could not write " +
+                                   filename_);
+  }
+
+ private:
+  std::ofstream os_;
+  std::string filename_;
+  std::vector<uint64_t> keys_;
+  std::vector<uint64_t> sizes_;
+};
+
+/// ShellBlockFileReader reads the records written by ShellBlockFileWriter.
+
+/// The records can be read in any order with read(), or all of them in order with stream(), which
+/// overlaps reading the next batch of records with processing the current one.
+class ShellBlockFileReader {
+ public:
+  /// reads the index of the records
+  /// @param filename the name of the file
+  /// @throw std::ios_base::failure if the file cannot be opened or is not a valid file
+  explicit ShellBlockFileReader(const std::string& filename)
+      : is_(filename, std::ios::binary), filename_(filename) {
+    uint64_t nrecords = 0;
+    is_.seekg(-static_cast<std::streamoff>(sizeof(uint64_t)), std::ios::end);
+    is_.read(reinterpret_cast<char*>(&nrecords), sizeof(uint64_t));
+    if (is_) {
+      keys_.resize(nrecords);
+      std::vector<uint64_t> sizes(nrecords);
+      is_.seekg(-static_cast<std::streamoff>((2 * nrecords + 1) * sizeof(uint64_t)),
+                std::ios::end);
+      is_.read(reinterpret_cast<char*>(keys_.data()), nrecords * sizeof(uint64_t));
+      is_.read(reinterpret_cast<char*>(sizes.data()), nrecords * sizeof(uint64_t));
+      offsets_.resize(nrecords + 1, 0);
+      for (auto r = 0ul; r != nrecords; ++r)
+        offsets_[r + 1] = offsets_[r] + sizes[r];
+    }
+    if (!is_)
+      throw std::ios_base::failure("ShellBlockFileReader: could not read " +
+                                   filename);
+  }
+
+  /// @return the number of records
+  std::size_t nrecords() const { return keys_.size(); }
+
+  /// @param[in] r record index
+  /// @return the key of record @c r
+  std::size_t key(std::size_t r) const { return keys_[r]; }
+
+  /// @param[in] r record index
+  /// @return the number of elements of record @c r
+  std::size_t size(std::size_t r) const { return offsets_[r + 1] - offsets_[r]; }
+
+  /// @param[in] r record index, may be equal to nrecords()
+  /// @return the position of record @c r in the file, in elements
+  std::size_t offset(std::size_t r) const { return offsets_[r]; }
+
+  /// reads consecutive records
+  /// @param[in] first the index of the first record
+  /// @param[in] last the index past the last record
+  /// @param[out] data the buffer for the data of the records, of size @c offset(last)-offset(first)
+  /// @throw std::ios_base::failure if the data could not be read
+  void read(std::size_t first, std::size_t last, double* data) {
+    assert(first <= last && last <= nrecords());
+    is_.seekg(offsets_[first] * sizeof(double));
+    is_.read(reinterpret_cast<char*>(data),
+             (offsets_[last] - offsets_[first]) * sizeof(double));
+    if (!is_)
+      throw std::ios_base::failure("ShellBlockFileReader: could not read " +
+                                   filename_);
+  }
+
+  /// reads all records in order, in batches of consecutive records; while a batch is
+  /// processed, the next one is read asynchronously
+  /// @param[in] f the function that processes the batches; it is called as @c f(first,last,data) , where
+  ///            @c [first,last) is the range of records in the batch and @c data points to the data of record
+  ///            @c first , followed by the data of the other records
+  /// @param[in] batch_size the maximum number of elements in a batch; a record larger than this is
+  ///            read as a batch of its own
+  template <typename F>
+  void stream(const F& f, std::size_t batch_size) {
+    const auto nrec = nrecords();
+    std::vector<std::size_t> batches(1, 0);  // the first record of each batch
+    while (batches.back() != nrec) {
+      const auto first = batches.back();
+      auto last = first + 1;
+      while (last != nrec && offsets_[last + 1] - offsets_[first] <= batch_size)
+        ++last;
+      batches.push_back(last);
+    }
+    const auto nbatches = batches.size() - 1;
+
+    std::vector<double> buffers[2];
+    auto read_batch = [&](std::size_t b) {
+      auto& buffer = buffers[b % 2];
+      buffer.resize(offsets_[batches[b + 1]] - offsets_[batches[b]]);
+      read(batches[b], batches[b + 1], buffer.data());
+    };
+    if (nbatches != 0) read_batch(0);
+    for (auto b = 0ul; b < nbatches; ++b) {
+      std::future<void> next;
+      if (b + 1 != nbatches)
+        next = std::async(std::launch::async, read_batch, b + 1);
+      f(batches[b], batches[b + 1],
+        static_cast<const double*>(buffers[b % 2].data()));
+      if (next.valid()) next.get();
+    }
+  }
+
+ private:
+  std::ifstream is_;
+  std::string filename_;
+  std::vector<uint64_t> keys_;
+  std::vector<std::size_t> offsets_;
+};
+
+}  // namespace libint2
+
+#endif /* _libint2_src_lib_libint_shellblockfile_h_ */
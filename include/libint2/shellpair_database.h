@@ -0,0 +1,250 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_shellpairdatabase_h_
+#define _libint2_src_lib_libint_shellpairdatabase_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/shellpair_database.h requires C++11 support"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <libint2/shell.h>
+#include <libint2/engine.h>
+
+namespace libint2 {
+
+/// ShellPairDatabase holds the ShellPair data for all significant pairs of shells
+/// from a pair of basis sets.
+
+/// The significant shell pairs are stored in compressed sparse row (CSR) form: the pairs
+/// \c {s1,s2} of shell \c s1 have shell-pair indices \c [row_offsets()[s1],row_offsets()[s1+1]) ,
+/// sorted by \c s2 . The primitive pair data of all shell pairs is kept in a single contiguous
+/// arena, in the layout used by ShellPair, and ShellPairDatabase::operator[] returns
+/// a ShellPair that is a view of this data. The database is immutable once constructed,
+/// hence it can be read concurrently from any number of threads.
+/// \warning the basis sets must outlive the database
+class ShellPairDatabase {
+ public:
+  typedef ShellPair::real_t real_t;
+
+  /// the value returned by find() for shell pairs that are not significant
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  ShellPairDatabase() = default;
+  ShellPairDatabase(ShellPairDatabase&&) = default;
+  ShellPairDatabase& operator=(ShellPairDatabase&&) = default;
+  // the arena may start at a different alignment offset in a copy
+  ShellPairDatabase(const ShellPairDatabase&) = delete;
+  ShellPairDatabase& operator=(const ShellPairDatabase&) = delete;
+
+  /// @param bs1 the first basis set
+  /// @param bs2 the second basis set; if empty, @c bs1 is used and only the pairs \c {s1,s2} with
+  ///            \c s2<=s1 are stored
+  /// @param threshold shells @c s1 and @c s2 form a significant pair if they share
+  ///        a center or the Frobenius norm of their overlap is greater than or equal to @c threshold
+  /// @param ln_prec the (natural) log of the precision used to screen the primitive pairs
+  ///        (see ShellPair::init() )
+  ShellPairDatabase(const std::vector<Shell>& bs1,
+                    const std::vector<Shell>& bs2 = std::vector<Shell>(),
+                    real_t threshold = 1e-12,
+                    real_t ln_prec = std::log(std::numeric_limits<real_t>::epsilon()))
+      : bs1_(&bs1), bs2_(bs2.empty() ? &bs1 : &bs2), symmetric_(bs2.empty()) {
+    init(threshold, ln_prec);
+  }
+
+  /// @return the number of significant shell pairs
+  std::size_t size() const { return shell2_.size(); }
+
+  /// @return true if the pairs refer to the same basis set and only the pairs \c {s1,s2} with \c s2<=s1 are stored
+  bool symmetric() const { return symmetric_; }
+
+  /// @return the first basis set
+  const std::vector<Shell>& basis1() const { return *bs1_; }
+  /// @return the second basis set
+  const std::vector<Shell>& basis2() const { return *bs2_; }
+
+  /// @return the row offsets of the CSR representation, of size @c basis1().size()+1
+  const std::vector<std::size_t>& row_offsets() const { return row_offsets_; }
+
+  /// @param sp shell-pair index
+  /// @return the index of the first shell in shell pair @c sp
+  std::size_t shell1(std::size_t sp) const {
+    assert(sp < size());
+    return std::upper_bound(row_offsets_.begin(), row_offsets_.end(), sp) -
+           row_offsets_.begin() - 1;
+  }
+  /// @param sp shell-pair index
+  /// @return the index of the second shell in shell pair @c sp
+  std::size_t shell2(std::size_t sp) const { return shell2_[sp]; }
+
+  /// @return the index of shell pair \c {s1,s2} , or ShellPairDatabase::npos if the pair is not significant
+  /// @note if symmetric() is true, only the pairs with @c s2<=s1 can be found
+  std::size_t find(std::size_t s1, std::size_t s2) const {
+    assert(s1 + 1 < row_offsets_.size());
+    const auto begin = shell2_.begin() + row_offsets_[s1];
+    const auto end = shell2_.begin() + row_offsets_[s1 + 1];
+    const auto it = std::lower_bound(begin, end, static_cast<uint32_t>(s2));
+    return (it != end && *it == s2) ? it - shell2_.begin() : npos;
+  }
+
+  /// @param sp shell-pair index
+  /// @return the ShellPair data of shell pair @c sp ; this object is a view of the data held by this
+  ///         database, hence it is only valid while this database exists
+  ShellPair operator[](std::size_t sp) const {
+    assert(sp < size());
+    const auto& sh1 = (*bs1_)[shell1(sp)];
+    const auto& sh2 = (*bs2_)[shell2(sp)];
+    real_t AB[3];
+    for (int xyz = 0; xyz != 3; ++xyz) AB[xyz] = sh1.O[xyz] - sh2.O[xyz];
+    const auto nprimpairs = nprimpairs_[sp];
+    const auto stride = ShellPair::padded_size(nprimpairs);
+    const auto offset = offsets_[sp];
+    return ShellPair(AB, nprimpairs, stride,
+                     rdata() + ShellPair::nrealfields * offset,
+                     idata_.data() + 2 * offset);
+  }
+
+  /// @return the number of bytes used by this object, not including the basis sets
+  std::size_t nbytes() const {
+    return row_offsets_.size() * sizeof(std::size_t) +
+           shell2_.size() * sizeof(uint32_t) +
+           offsets_.size() * sizeof(std::size_t) +
+           nprimpairs_.size() * sizeof(uint32_t) +
+           rarena_.size() * sizeof(real_t) + idata_.size() * sizeof(int);
+  }
+
+ private:
+  const std::vector<Shell>* bs1_ = nullptr;
+  const std::vector<Shell>* bs2_ = nullptr;
+  bool symmetric_ = false;
+
+  std::vector<std::size_t> row_offsets_;
+  std::vector<uint32_t> shell2_;
+  // primitive pair data of shell pair sp starts at element offsets_[sp]*ShellPair::nrealfields
+  // of the real arena and at element offsets_[sp]*2 of the integer arena
+  std::vector<std::size_t> offsets_;
+  std::vector<uint32_t> nprimpairs_;
+  std::vector<real_t> rarena_;  // includes padding for alignment
+  std::vector<int> idata_;
+
+  const real_t* rdata() const {
+    auto base = reinterpret_cast<std::uintptr_t>(rarena_.data());
+    base = (base + ShellPair::align_size - 1) & ~(ShellPair::align_size - 1);
+    return reinterpret_cast<const real_t*>(base);
+  }
+
+  void init(real_t threshold, real_t ln_prec) {
+    const auto& bs1 = *bs1_;
+    const auto& bs2 = *bs2_;
+    const auto nsh1 = bs1.size();
+    const auto nsh2 = bs2.size();
+    if (nsh1 == 0 || nsh2 == 0) {
+      row_offsets_.assign(nsh1 + 1, 0);
+      return;
+    }
+
+    // N.B. libint2::max_nprim() and libint2::max_l() are not declared yet if this is
+    // included via libint2/basis.h
+    std::size_t max_nprim = 0;
+    int max_l = 0;
+    for (const auto* bs : {&bs1, &bs2}) {
+      for (const auto& sh : *bs) {
+        max_nprim = std::max(max_nprim, sh.nprim());
+        for (const auto& c : sh.contr) max_l = std::max(max_l, c.l);
+      }
+    }
+    Engine engine(Operator::overlap, max_nprim, max_l, 0);
+    const auto& buf = engine.results();
+
+    ShellPair sp(max_nprim);
+    std::vector<real_t> rdata;
+    std::size_t offset = 0;
+
+    row_offsets_.reserve(nsh1 + 1);
+    row_offsets_.push_back(0);
+    for (auto s1 = 0ul; s1 != nsh1; ++s1) {
+      const auto s2_max = symmetric_ ? s1 : nsh2 - 1;
+      for (auto s2 = 0ul; s2 <= s2_max; ++s2) {
+        bool significant = (bs1[s1].O == bs2[s2].O);
+        if (!significant) {
+          engine.compute(bs1[s1], bs2[s2]);
+          if (buf[0] != nullptr) {
+            const auto n12 = bs1[s1].size() * bs2[s2].size();
+            real_t norm2 = 0;
+            for (auto i = 0ul; i != n12; ++i) norm2 += buf[0][i] * buf[0][i];
+            significant = (std::sqrt(norm2) >= threshold);
+          }
+        }
+        if (!significant) continue;
+
+        sp.init(bs1[s1], bs2[s2], ln_prec);
+        const auto nprimpairs = sp.nprimpairs();
+        const auto stride = ShellPair::padded_size(nprimpairs);
+        shell2_.push_back(s2);
+        offsets_.push_back(offset);
+        nprimpairs_.push_back(nprimpairs);
+        rdata.resize(ShellPair::nrealfields * (offset + stride));
+        idata_.resize(2 * (offset + stride));
+        for (int f = 0; f != ShellPair::nrealfields; ++f) {
+          std::copy(sp.field(f), sp.field(f) + nprimpairs,
+                    rdata.begin() + ShellPair::nrealfields * offset + f * stride);
+        }
+        std::copy(sp.p1(), sp.p1() + nprimpairs, idata_.begin() + 2 * offset);
+        std::copy(sp.p2(), sp.p2() + nprimpairs,
+                  idata_.begin() + 2 * offset + stride);
+        offset += stride;
+      }
+      row_offsets_.push_back(shell2_.size());
+    }
+
+    // copy the real data to the aligned arena
+    rarena_.resize(rdata.size() + ShellPair::align_nreal);
+    std::copy(rdata.begin(), rdata.end(), const_cast<real_t*>(this->rdata()));
+    shell2_.shrink_to_fit();
+    offsets_.shrink_to_fit();
+    nprimpairs_.shrink_to_fit();
+    idata_.shrink_to_fit();
+  }
+};
+
+/// computes shell set of integrals over the shell quartet formed by a pair of shell
+/// pairs from a ShellPairDatabase
+template <Operator op, BraKet bk, size_t deriv_order>
+__libint2_engine_inline const Engine::target_ptr_vec& Engine::compute2(
+    const ShellPairDatabase& spdb, std::size_t spbra, std::size_t spket) {
+  const auto& bs1 = spdb.basis1();
+  const auto& bs2 = spdb.basis2();
+  const auto spbra_data = spdb[spbra];
+  const auto spket_data = spdb[spket];
+  return compute2<op, bk, deriv_order>(
+      bs1[spdb.shell1(spbra)], bs2[spdb.shell2(spbra)], bs1[spdb.shell1(spket)],
+      bs2[spdb.shell2(spket)], &spbra_data, &spket_data);
+}
+
+}  // namespace libint2
+
+#endif /* _libint2_src_lib_libint_shellpairdatabase_h_ */
@@ -0,0 +1,265 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_shellpairtree_h_
+#define _libint2_src_lib_libint_shellpairtree_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/shellpair_tree.h requires C++11 support"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <libint2/shellpair_database.h>
+
+namespace libint2 {
+
+/// ShellPairTree estimates the magnitude of the 2-body Coulomb integrals of shell quartets
+/// with the distance-including QQR estimate, and organizes the shell pairs in a spatial tree so
+/// that all ket shell pairs of a bra shell pair with non-negligible integrals can be found
+/// without visiting the rest.
+
+/// Each shell pair \f$ ab \f$ is described by the Schwarz factor
+/// \f$ Q_{ab} = \sqrt{ || (ab|ab) ||_\infty } \f$ and by a sphere, centered at the
+/// center of its most significant primitive pair, outside of which its charge distribution is
+/// negligible; the radius of the sphere (the extent of the pair) is the largest extent
+/// \f$ \sqrt{2/\gamma} \, \mathrm{erfc}^{-1}(\epsilon) \f$ of its primitive pairs, plus their
+/// distances from the center. The QQR estimate (Maurer et al., J. Chem. Phys. 136, 144107 (2012)) is
+/// \f$ || (ab|cd) ||_\infty \approx Q_{ab} Q_{cd} / \max(1, R') \f$, with
+/// \f$ R' = R - r_{ab} - r_{cd} \f$ the distance between the spheres of the pairs. Unlike the Schwarz
+/// bound, \f$ Q_{ab} Q_{cd} \f$, the QQR estimate accounts for the \f$ 1/R \f$ decay of the integrals
+/// of distant charge distributions, but it is not a rigorous bound.
+///
+/// The tree is a bounding-sphere hierarchy: the shell pairs are split recursively, at the median along
+/// the longest dimension of the bounding box of their centers, and each node keeps a sphere that
+/// encloses the spheres of its pairs and the largest Schwarz factor of its pairs. Hence
+/// a node whose sphere is far enough from a bra shell pair can be rejected as a whole.
+class ShellPairTree {
+ public:
+  ShellPairTree() = default;
+
+  /// @param spdb the shell pairs
+  /// @param Schwarz the shell-pair Schwarz factors, \f$ Q_{ij} = \sqrt{ || (ij|ij) ||_\infty } \f$ , as a
+  ///        matrix indexed by shells, i.e. @c Schwarz(s1,s2) is the factor of shell pair \c {s1,s2}
+  /// @param precision the precision used to determine the extents of the shell pairs
+  /// @param leaf_size the maximum number of shell pairs in a leaf of the tree
+  template <typename SchwarzMatrix>
+  ShellPairTree(const ShellPairDatabase& spdb, const SchwarzMatrix& Schwarz,
+                double precision, std::size_t leaf_size = 8) {
+    const auto npairs = spdb.size();
+    centers_.resize(3 * npairs);
+    extents_.resize(npairs);
+    Q_.resize(npairs);
+
+    const auto erfc_inv_prec = erfc_inverse(precision);
+    for (auto sp = 0ul; sp != npairs; ++sp) {
+      const auto s1 = spdb.shell1(sp);
+      const auto s2 = spdb.shell2(sp);
+      Q_[sp] = Schwarz(s1, s2);
+      const auto pair = spdb[sp];
+      double* C = &centers_[3 * sp];
+      if (pair.nprimpairs() == 0) {  // all primitive pairs are negligible
+        std::copy(spdb.basis1()[s1].O.begin(), spdb.basis1()[s1].O.end(), C);
+        extents_[sp] = 0.0;
+        continue;
+      }
+      // the primitive pairs are sorted by descending screening factor
+      for (int xyz = 0; xyz != 3; ++xyz) C[xyz] = pair.P(xyz)[0];
+      double extent = 0.0;
+      for (auto p = 0ul; p != pair.nprimpairs(); ++p) {
+        double PC2 = 0.0;
+        for (int xyz = 0; xyz != 3; ++xyz) {
+          const auto PC = pair.P(xyz)[p] - C[xyz];
+          PC2 += PC * PC;
+        }
+        extent = std::max(extent, std::sqrt(PC2) + std::sqrt(2 * pair.one_over_gamma()[p]) * erfc_inv_prec);
+      }
+      extents_[sp] = extent;
+    }
+
+    order_.resize(npairs);
+    std::iota(order_.begin(), order_.end(), 0ul);
+    if (npairs != 0) {
+      nodes_.reserve(2 * (npairs / std::max<std::size_t>(leaf_size, 1) + 1));
+      nodes_.push_back(Node());
+      build(0, 0, npairs, std::max<std::size_t>(leaf_size, 1));
+    }
+  }
+
+  /// @return the number of shell pairs
+  std::size_t size() const { return Q_.size(); }
+
+  /// @return the number of nodes of the tree
+  std::size_t nnodes() const { return nodes_.size(); }
+
+  /// @param sp shell-pair index
+  /// @return the center of the charge distribution of shell pair @c sp
+  const double* center(std::size_t sp) const { return &centers_[3 * sp]; }
+
+  /// @param sp shell-pair index
+  /// @return the extent of the charge distribution of shell pair @c sp
+  double extent(std::size_t sp) const { return extents_[sp]; }
+
+  /// @param sp shell-pair index
+  /// @return the Schwarz factor of shell pair @c sp
+  double schwarz(std::size_t sp) const { return Q_[sp]; }
+
+  /// @param sp12 bra shell-pair index
+  /// @param sp34 ket shell-pair index
+  /// @return the QQR estimate of \f$ || (12|34) ||_\infty \f$
+  double estimate(std::size_t sp12, std::size_t sp34) const {
+    const auto R = distance(center(sp12), center(sp34)) - extents_[sp12] -
+                   extents_[sp34];
+    return Q_[sp12] * Q_[sp34] / std::max(1.0, R);
+  }
+
+  /// calls @c f(sp34,estimate) for every ket shell pair @c sp34 whose QQR estimate
+  /// @c estimate(sp12,sp34) is greater than or equal to @c threshold , in no particular order
+  /// @param sp12 bra shell-pair index
+  /// @param threshold the threshold
+  /// @param f the function
+  template <typename F>
+  void visit(std::size_t sp12, double threshold, const F& f) const {
+    if (nodes_.empty()) return;
+    const auto* C12 = center(sp12);
+    const auto extent12 = extents_[sp12];
+    const auto Q12 = Q_[sp12];
+    if (Q12 * nodes_[0].Qmax < threshold) return;
+
+    std::vector<std::size_t> stack(1, 0);
+    while (!stack.empty()) {
+      const auto& node = nodes_[stack.back()];
+      stack.pop_back();
+      // the distance between the sphere of the bra pair and the sphere of any ket pair of the
+      // node is at least the distance between the sphere of the bra pair and that of the node
+      const auto R = distance(C12, node.center) - node.radius - extent12;
+      if (Q12 * node.Qmax / std::max(1.0, R) < threshold) continue;
+      if (node.child != 0) {
+        stack.push_back(node.child);
+        stack.push_back(node.child + 1);
+        continue;
+      }
+      for (auto i = node.first; i != node.last; ++i) {
+        const auto sp34 = order_[i];
+        const auto est = estimate(sp12, sp34);
+        if (est >= threshold) f(sp34, est);
+      }
+    }
+  }
+
+ private:
+  struct Node {
+    double center[3];
+    double radius;  // the spheres of all shell pairs of the node are within this sphere
+    double Qmax;    // the largest Schwarz factor of the shell pairs of the node
+    std::size_t first, last;  // the shell pairs of the node are order_[first,last)
+    std::size_t child;  // the index of the first of the 2 children, 0 if this is a leaf
+  };
+
+  std::vector<double> centers_;
+  std::vector<double> extents_;
+  std::vector<double> Q_;
+  std::vector<std::size_t> order_;  // the shell pairs, in the order of the leaves of the tree
+  std::vector<Node> nodes_;
+
+  static double distance(const double* A, const double* B) {
+    double AB2 = 0.0;
+    for (int xyz = 0; xyz != 3; ++xyz) AB2 += (A[xyz] - B[xyz]) * (A[xyz] - B[xyz]);
+    return std::sqrt(AB2);
+  }
+
+  /// @return \f$ x \f$ such that \f$ \mathrm{erfc}(x) = y \f$ , for \f$ 0 < y \leq 1 \f$
+  static double erfc_inverse(double y) {
+    if (y >= 1.0) return 0.0;
+    double lo = 0.0, hi = 30.0;  // erfc(30) underflows
+    for (int iter = 0; iter != 64; ++iter) {
+      const auto mid = 0.5 * (lo + hi);
+      if (std::erfc(mid) > y)
+        lo = mid;
+      else
+        hi = mid;
+    }
+    return hi;
+  }
+
+  /// initializes node @c n with shell pairs @c order_[first,last) and builds its subtree
+  void build(std::size_t n, std::size_t first, std::size_t last,
+             std::size_t leaf_size) {
+    // the bounding box of the centers
+    double lo[3], hi[3];
+    for (int xyz = 0; xyz != 3; ++xyz) {
+      lo[xyz] = std::numeric_limits<double>::max();
+      hi[xyz] = std::numeric_limits<double>::lowest();
+    }
+    for (auto i = first; i != last; ++i) {
+      const auto* C = center(order_[i]);
+      for (int xyz = 0; xyz != 3; ++xyz) {
+        lo[xyz] = std::min(lo[xyz], C[xyz]);
+        hi[xyz] = std::max(hi[xyz], C[xyz]);
+      }
+    }
+
+    {
+      auto& node = nodes_[n];
+      for (int xyz = 0; xyz != 3; ++xyz) node.center[xyz] = 0.5 * (lo[xyz] + hi[xyz]);
+      node.radius = 0.0;
+      node.Qmax = 0.0;
+      for (auto i = first; i != last; ++i) {
+        const auto sp = order_[i];
+        node.radius = std::max(node.radius, distance(node.center, center(sp)) + extents_[sp]);
+        node.Qmax = std::max(node.Qmax, Q_[sp]);
+      }
+      node.first = first;
+      node.last = last;
+      node.child = 0;
+    }
+    if (last - first <= leaf_size) return;
+
+    // split at the median along the longest dimension
+    int dim = 0;
+    for (int xyz = 1; xyz != 3; ++xyz)
+      if (hi[xyz] - lo[xyz] > hi[dim] - lo[dim]) dim = xyz;
+    const auto mid = first + (last - first) / 2;
+    const auto& centers = centers_;
+    std::nth_element(order_.begin() + first, order_.begin() + mid,
+                     order_.begin() + last,
+                     [&centers, dim](std::size_t a, std::size_t b) {
+                       return centers[3 * a + dim] < centers[3 * b + dim];
+                     });
+
+    // N.B. nodes_ may be reallocated by push_back, hence refer to node n by index
+    const auto child = nodes_.size();
+    nodes_[n].child = child;
+    nodes_.push_back(Node());
+    nodes_.push_back(Node());
+    build(child, first, mid, leaf_size);
+    build(child + 1, mid, last, leaf_size);
+  }
+};
+
+}  // namespace libint2
+
+#endif /* _libint2_src_lib_libint_shellpairtree_h_ */
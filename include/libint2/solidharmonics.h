@@ -410,6 +410,49 @@ namespace libint2 {
 
     }
 
+    /// transforms the last dimension of the 4-index tensor \c src from cartesian to solid harmonic Gaussians
+    /// (if \c pure is true, else copies it) and scatters the result to \c tgt with arbitrary strides;
+    /// with the strides of a permuted tensor this transforms and permutes in a single pass
+    /// @param n1 the size of the first dimension of \c src
+    /// @param n2 the size of the second dimension of \c src
+    /// @param n3 the size of the third dimension of \c src
+    /// @param l the angular momentum of the last dimension
+    /// @param pure if true, transform the last dimension to solid harmonics
+    /// @param tgt_strides the strides of \c tgt corresponding to the 4 dimensions of \c src
+    template <typename Real>
+    void transform_last_strided(size_t n1, size_t n2, size_t n3, size_t l, bool pure,
+                                const Real* src, Real* tgt,
+                                const std::array<size_t, 4>& tgt_strides)
+    {
+      const auto nc = (l+1)*(l+2)/2;
+      const auto n = pure ? 2*l+1 : nc;
+      const auto& coefs = SolidHarmonicsCoefficients<Real>::instance(pure ? l : 0);
+
+      auto src_row = src;
+      for(size_t i1=0; i1!=n1; ++i1) {
+        for(size_t i2=0; i2!=n2; ++i2) {
+          auto tgt_row = tgt + i1*tgt_strides[0] + i2*tgt_strides[1];
+          for(size_t i3=0; i3!=n3; ++i3, src_row+=nc, tgt_row+=tgt_strides[2]) {
+            if (pure) {
+              for(size_t s=0; s!=n; ++s) {
+                const auto nc_s = coefs.nnz(s);
+                const auto* c_idxs = coefs.row_idx(s);
+                const auto* c_vals = coefs.row_values(s);
+                Real value = 0;
+                for(size_t ic=0; ic!=nc_s; ++ic)
+                  value += c_vals[ic] * src_row[c_idxs[ic]];
+                tgt_row[s*tgt_strides[3]] = value;
+              }
+            }
+            else {
+              for(size_t c=0; c!=nc; ++c)
+                tgt_row[c*tgt_strides[3]] = src_row[c];
+            }
+          }
+        }
+      }
+    }
+
     /// transforms the last two dimensions of \c src from cartesian to solid harmonic Gaussians, stores result to \c tgt
     template <typename Real>
     void tform_last2(size_t n1, int l_row, int l_col, const Real* source_blk, Real* target_blk) {
@@ -0,0 +1,183 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_lib_libint_simdline_h_
+#define _libint2_src_lib_libint_simdline_h_
+
+#include <libint2/util/cxxstd.h>
+#if LIBINT2_CPLUSPLUS_STD < 2011
+# error "libint2/util/simd_line.h requires C++11 support"
+#endif
+
+#if defined(__SSE2__) || defined(__AVX__)
+#  include <x86intrin.h>
+#endif
+
+/**
+   Kernels used by the code generated with explicit SIMD instructions for line-vectorized builds
+   (see CompilationParameters::vector_isa() in the generator). Each kernel evaluates an arithmetic
+   operation for all elements of a vector line, i.e. N consecutive doubles. The arguments of
+   a kernel are either pointers to the first element of a line or scalars, which are broadcast to all elements.
+   Lines on the stack are aligned to the width of the registers if the library is built with the
+   corresponding alignment (see LIBINT2_ALIGN_SIZE); lines in the evaluator are loaded without assuming alignment.
+   If the compiler does not target the instruction set for which the code was generated,
+   the kernels fall back to plain loops.
+*/
+
+namespace libint2 { namespace simd_line {
+
+  /// scalar "instruction set", used when the requested instruction set is not available
+  struct Scalar {
+    typedef double reg;
+    static const int width = 1;
+    static reg load(const double* p) { return *p; }
+    static reg loadu(const double* p) { return *p; }
+    static reg set1(double a) { return a; }
+    static void store(double* p, reg a) { *p = a; }
+    static void storeu(double* p, reg a) { *p = a; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    /// @return a*b+c
+    static reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+    /// @return a*b-c
+    static reg fmsub(reg a, reg b, reg c) { return a * b - c; }
+  };
+
+#ifdef __SSE2__
+  /// SSE2 instructions, 2 doubles per register; SSE2 has no FMA instructions
+  struct SSE2 {
+    typedef __m128d reg;
+    static const int width = 2;
+    static reg load(const double* p) { return _mm_load_pd(p); }
+    static reg loadu(const double* p) { return _mm_loadu_pd(p); }
+    static reg set1(double a) { return _mm_set1_pd(a); }
+    static void store(double* p, reg a) { _mm_store_pd(p, a); }
+    static void storeu(double* p, reg a) { _mm_storeu_pd(p, a); }
+    static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static reg fmsub(reg a, reg b, reg c) { return _mm_sub_pd(_mm_mul_pd(a, b), c); }
+  };
+#else
+  struct SSE2 : public Scalar {};
+#endif
+
+#ifdef __AVX__
+  /// AVX2 instructions, 4 doubles per register; FMA instructions are used if available
+  struct AVX2 {
+    typedef __m256d reg;
+    static const int width = 4;
+    static reg load(const double* p) { return _mm256_load_pd(p); }
+    static reg loadu(const double* p) { return _mm256_loadu_pd(p); }
+    static reg set1(double a) { return _mm256_set1_pd(a); }
+    static void store(double* p, reg a) { _mm256_store_pd(p, a); }
+    static void storeu(double* p, reg a) { _mm256_storeu_pd(p, a); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+#if defined(__FMA__)
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+    static reg fmsub(reg a, reg b, reg c) { return _mm256_fmsub_pd(a, b, c); }
+#else
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_add_pd(_mm256_mul_pd(a, b), c); }
+    static reg fmsub(reg a, reg b, reg c) { return _mm256_sub_pd(_mm256_mul_pd(a, b), c); }
+#endif
+  };
+#else
+  struct AVX2 : public SSE2 {};
+#endif
+
+  /**
+     Kernels on lines of N doubles using instruction set ISA.
+     @tparam AlignedStack if true, lines on the stack (non-const pointers) are aligned to the register width
+  */
+  template <typename ISA, int N, bool AlignedStack>
+  struct Kernels {
+    typedef typename ISA::reg reg;
+    static const int width = ISA::width;
+    static_assert(N % ISA::width == 0, "simd_line::Kernels: line length must be a multiple of the register width");
+
+    /// X = A
+    template <typename A> static void copy(double* x, A a) {
+      for(int v=0; v<N; v+=width) st(x, v, ld(a, v));
+    }
+    /// X += A
+    template <typename A> static void acc_copy(double* x, A a) {
+      for(int v=0; v<N; v+=width) st(x, v, ISA::add(ld(x, v), ld(a, v)));
+    }
+
+#define LIBINT2_SIMD_LINE_BINARY(name)                                            \
+    template <typename A, typename B> static void name(double* x, A a, B b) {     \
+      for(int v=0; v<N; v+=width) st(x, v, ISA::name(ld(a, v), ld(b, v)));       \
+    }                                                                             \
+    template <typename A, typename B> static void acc_##name(double* x, A a, B b) { \
+      for(int v=0; v<N; v+=width)                                                 \
+        st(x, v, ISA::add(ld(x, v), ISA::name(ld(a, v), ld(b, v))));              \
+    }
+
+    /// X = A + B and X += A + B
+    LIBINT2_SIMD_LINE_BINARY(add)
+    /// X = A - B and X += A - B
+    LIBINT2_SIMD_LINE_BINARY(sub)
+    /// X = A * B and X += A * B
+    LIBINT2_SIMD_LINE_BINARY(mul)
+    /// X = A / B and X += A / B
+    LIBINT2_SIMD_LINE_BINARY(div)
+
+#undef LIBINT2_SIMD_LINE_BINARY
+
+    /// X = A * B + C
+    template <typename A, typename B, typename C> static void fma_plus(double* x, A a, B b, C c) {
+      for(int v=0; v<N; v+=width) st(x, v, ISA::fmadd(ld(a, v), ld(b, v), ld(c, v)));
+    }
+    /// X = A * B - C
+    template <typename A, typename B, typename C> static void fma_minus(double* x, A a, B b, C c) {
+      for(int v=0; v<N; v+=width) st(x, v, ISA::fmsub(ld(a, v), ld(b, v), ld(c, v)));
+    }
+    /// X += A * B + C
+    template <typename A, typename B, typename C> static void acc_fma_plus(double* x, A a, B b, C c) {
+      for(int v=0; v<N; v+=width) st(x, v, ISA::add(ld(x, v), ISA::fmadd(ld(a, v), ld(b, v), ld(c, v))));
+    }
+    /// X += A * B - C
+    template <typename A, typename B, typename C> static void acc_fma_minus(double* x, A a, B b, C c) {
+      for(int v=0; v<N; v+=width) st(x, v, ISA::add(ld(x, v), ISA::fmsub(ld(a, v), ld(b, v), ld(c, v))));
+    }
+
+  private:
+    /// loads a register from a line on the stack
+    static reg ld(double* p, int v) { return AlignedStack ? ISA::load(p + v) : ISA::loadu(p + v); }
+    /// loads a register from a line in the evaluator
+    static reg ld(const double* p, int v) { return ISA::loadu(p + v); }
+    /// broadcasts a scalar
+    static reg ld(double a, int) { return ISA::set1(a); }
+    /// stores a register to a line on the stack
+    static void st(double* p, int v, reg a) {
+      if (AlignedStack) ISA::store(p + v, a); else ISA::storeu(p + v, a);
+    }
+  };
+
+}} // namespace libint2::simd_line
+
+#endif // header guard
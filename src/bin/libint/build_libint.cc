@@ -31,8 +31,19 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <limits>
+#include <map>
 #include <vector>
+#include <set>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <algorithm>
+#include <ctime>
 #include <boost/preprocessor.hpp>
 #if not BOOST_PP_VARIADICS  // no variadic macros? your compiler is out of date! (should not be possible since variadic macros are part of C++11)
 #  error "your compiler does not provide variadic macros (but does support C++11), something is seriously broken, please create an issue at https://github.com/evaleev/libint/issues"
@@ -55,6 +66,9 @@
 #include <graph_registry.h>
 #include <task.h>
 #include <extract.h>
+#include <cost.h>
+#include <cache.h>
+#include <comp_deriv_gauss.h>
 #include <dims.h>
 #include <purgeable.h>
 #include <buildtest.h>
@@ -229,6 +243,507 @@ static void build_G12DKH_2b_2k(std::ostream& os, const SafePtr<CompilationParame
                                 SafePtr<Libint2Iface>& iface);
 #endif
 
+namespace {
+
+  /// the number of processes used to generate the integral classes, set by the -j command-line option
+  unsigned int nbuild_processes = 1;
+  /// the algorithm that schedules the computation, set by the --schedule command-line option
+  GraphRegistry::Schedule schedule = GraphRegistry::Schedule::DepthFirst;
+  /// the cache size for GraphRegistry::Schedule::MinWorkingSet, set by the --schedule-cache-size command-line option
+  unsigned int schedule_cache_size = GraphRegistry().schedule_cache_size();
+
+  /// configures the scheduling of computation on graph dg
+  void configure_schedule(const SafePtr<DirectedGraph>& dg) {
+    dg->registry()->schedule(schedule);
+    dg->registry()->schedule_cache_size(schedule_cache_size);
+  }
+
+  /// the variants of the code that can be generated for a class of two-body integrals:
+  /// Default uses the Obara-Saika tactic and the default CSE and unrolling policies,
+  /// FirstChoice applies the first RR proposed by the strategy (thus changes the mix of HRR and VRR),
+  /// NoCSE skips common subexpression elimination, and NoUnroll does not unroll the class.
+  /// Which variant is fastest depends on the class and on the machine, see tests/eri/tune.pl
+  enum class Variant {Default, FirstChoice, NoCSE, NoUnroll};
+  const char* variant_labels[] = {"default", "first-choice", "no-cse", "no-unroll"};
+
+  Variant variant_from_label(const std::string& label) {
+    for(unsigned int v=0; v!=sizeof(variant_labels)/sizeof(const char*); ++v)
+      if (label == variant_labels[v])
+        return static_cast<Variant>(v);
+    throw std::invalid_argument("build_libint: unknown variant " + label);
+  }
+
+  /// the variant of the classes not listed in the tuning manifest, set by the --variant command-line option
+  Variant default_variant = Variant::Default;
+  /// maps the key of a class (the task label followed by the angular momenta that index
+  /// the class in libint2_build_<task>) to its variant, read from the tuning manifest
+  std::map<std::string, Variant> tuned_variants;
+
+  std::string class_key(const std::string& task, std::initializer_list<unsigned int> am) {
+    std::ostringstream oss;
+    oss << task;
+    for(auto l: am)
+      oss << " " << l;
+    return oss.str();
+  }
+
+  /// reads the tuning manifest produced by tests/eri/tune.pl; each line (other than the comment lines
+  /// that start with #) is a class key followed by the label of the variant to be used for the class
+  void read_tune_manifest(const std::string& filename) {
+    std::ifstream is(filename);
+    if (!is)
+      throw std::invalid_argument("build_libint: could not open tuning manifest " + filename);
+    std::string line;
+    while (std::getline(is, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+      const auto pos = line.find_last_of(' ');
+      if (pos == std::string::npos)
+        throw std::invalid_argument("build_libint: invalid line in tuning manifest: " + line);
+      tuned_variants[line.substr(0, pos)] = variant_from_label(line.substr(pos+1));
+    }
+  }
+
+  Variant class_variant(const std::string& key) {
+    const auto v = tuned_variants.find(key);
+    return v != tuned_variants.end() ? v->second : default_variant;
+  }
+
+  /// @return the class key followed by the label of the variant of the class
+  std::string variant_class_key(const std::string& key) {
+    return key + " " + variant_labels[static_cast<int>(class_variant(key))];
+  }
+
+  /// applies variant to the registry of dg
+  /// @return the tactic to be used for the class, tactic unless variant changes it
+  SafePtr<Tactic> apply_variant(Variant variant, const SafePtr<DirectedGraph>& dg, const SafePtr<Tactic>& tactic) {
+    switch (variant) {
+      case Variant::FirstChoice:
+        return SafePtr<Tactic>(new FirstChoiceTactic<DummyRandomizePolicy>);
+      case Variant::NoCSE:
+        dg->registry()->do_cse(false);
+        break;
+      case Variant::NoUnroll:
+        dg->registry()->unroll_threshold(0);
+        break;
+      default:
+        break;
+    }
+    return tactic;
+  }
+
+  std::string variant_report(Variant variant) {
+    return variant == Variant::Default ? std::string() : std::string(" (") + variant_labels[static_cast<int>(variant)] + ")";
+  }
+
+  /// reports the peak stack size of the classes generated since the last call, for memman and for the other MemoryManagers
+  std::string stack_report(const SafePtr<LivenessMemoryManager>& memman) {
+    const LivenessMemoryManager::Report report = memman->take_report();
+    MemoryManagerFactory factory;
+    std::ostringstream oss;
+    oss << "stack size = " << report.peak << " (";
+    for(unsigned int t=0; t!=report.online_peaks.size(); ++t)
+      oss << (t ? ", " : "") << factory.label(t) << ": " << report.online_peaks[t];
+    oss << ")";
+    return oss.str();
+  }
+
+  /// ClassIface describes how the code generated for one class of integrals is hooked up
+  /// to the library interface
+  struct ClassIface {
+    std::string task;
+    unsigned int max_am = 0;
+    unsigned int max_stack_size = 0;
+    unsigned int ntarget = 0;
+    std::string indices;  // indices of the class in libint2_build_<task>, e.g. "[2][1]"
+    std::string static_init;  // sets the pointer to the top-level evaluator function
+    std::deque<std::string> decl_filenames;  // declarations of the generated functions
+    ClassCost cost;  // flops of the set-level RRs are resolved by costs_to_api()
+
+    /// updates the parameters of the task and the library interface
+    void apply(SafePtr<Libint2Iface>& iface) const {
+      LibraryTaskManager& taskmgr = LibraryTaskManager::Instance();
+      const SafePtr<TaskParameters>& tparams = taskmgr.find(task)->params();
+      tparams->max_stack_size(max_am, max_stack_size);
+      tparams->max_ntarget(ntarget);
+      iface->to_static_init(static_init);
+      for(const auto& decl_filename: decl_filenames)
+        iface->to_int_iface(std::string("#include <") + decl_filename + ">\n");
+      generated_classes.push_back(*this);
+    }
+
+    void write(std::ostream& os) const {
+      os << task << "\n" << indices << "\n" << max_am << " " << max_stack_size << " " << ntarget << "\n"
+         << static_init.size() << "\n" << static_init << decl_filenames.size() << "\n";
+      for(const auto& decl_filename: decl_filenames)
+        os << decl_filename << "\n";
+      cost.write(os);
+    }
+    void read(std::istream& is) {
+      size_t n;
+      std::getline(is, task);
+      std::getline(is, indices);
+      is >> max_am >> max_stack_size >> ntarget >> n;
+      is.ignore();
+      static_init.resize(n);
+      is.read(&static_init[0], n);
+      is >> n;
+      is.ignore();
+      decl_filenames.resize(n);
+      for(auto& decl_filename: decl_filenames)
+        std::getline(is, decl_filename);
+      cost.read(is);
+      if (!is)
+        throw std::runtime_error("ClassIface::read() -- corrupt job output");
+    }
+
+    /// the classes applied so far, in the order of application
+    static std::vector<ClassIface> generated_classes;
+  };
+  std::vector<ClassIface> ClassIface::generated_classes;
+
+  /**
+   * Emits the cost of each generated class, libint2_cost_<task>, to the library interface.
+   * The flops of the set-level RRs are known only once their code has been generated,
+   * hence this must be called after generate_rr_code().
+   */
+  void costs_to_api(const SafePtr<CompilationParameters>& cparams, SafePtr<Libint2Iface>& iface) {
+    SafePtr<CodeContext> context(new CppCodeContext(cparams));
+    const FunctionCosts& fcosts = FunctionCosts::Instance();
+    for(const auto& c: ClassIface::generated_classes) {
+      ostringstream oss;
+      oss << context->label_to_name(cparams->api_prefix()) << "libint2_cost_" << c.task << c.indices << " = {"
+          << fcosts.nflops(c.cost.shellset) << "ul, " << fcosts.nflops(c.cost.primitive) << "ul, "
+          << c.cost.stack_size << "u, " << c.cost.target_size << "u}"
+          << context->end_of_stat() << endl;
+      iface->to_static_init(oss.str());
+    }
+  }
+
+  /// the cache of the code generated for the classes, set by the --cache-dir command-line option
+  SafePtr<ClassCache> class_cache;
+  /// describes the generator and the parameters of the generated code that do not depend on the task,
+  /// this is the common part of the cache keys of all classes
+  std::string generator_key;
+  /// the files installed by ClassGenerator for each class, in the order of installation
+  std::vector<std::pair<std::string, std::vector<std::string>>> class_files;
+  /// the name of the manifest of the files installed by ClassGenerator, see write_class_manifest()
+  const char class_manifest_name[] = "libint2_classes.mk";
+
+  /**
+   * ClassGenerator runs the jobs that generate code for the classes of integrals of one task.
+   *
+   * If nbuild_processes is 1 and class_cache is not set, each job is run as soon as it is added. Otherwise
+   * the jobs are run by run(), each in a process forked from the generator, with up to nbuild_processes
+   * jobs running at a time; processes, rather than threads, are used because the generator keeps
+   * much of its state (class instances, RRs, tasks) in singletons. Since the generated code depends on
+   * this state, forking every job from the same state makes the generated library independent
+   * of the number of processes and of the scheduling of the jobs.
+   * Each job writes the code of its class, and the code for the set-level RRs that it uses, to a private directory,
+   * along with its ClassIface and the other data that the generator needs to merge the job.
+   * Such directory depends only on the class and on generator_key, hence it is stored in class_cache,
+   * if set, and the jobs that are found in the cache are not run at all.
+   * Once all jobs are done the results are merged in the order in which the jobs were added; the code for an RR
+   * generated by several jobs is taken from the first of them. The files that did not change since
+   * the previous run of the generator are not rewritten, hence the library build only needs to recompile
+   * the code that did change.
+   */
+  class ClassGenerator {
+    public:
+      typedef std::function<ClassIface()> Job;
+
+      ClassGenerator(std::ostream& os, const SafePtr<CompilationParameters>& cparams,
+                     SafePtr<Libint2Iface>& iface) : os_(os), cparams_(cparams), iface_(iface),
+                     srcdir_(cparams->source_directory()) {}
+
+      /// adds job that generates the code for a class of integrals of task; key identifies the class,
+      /// e.g. by its class key and the variant of its code (see variant_class_key())
+      void add(const std::string& task, const std::string& key, const Job& job) {
+        if (nbuild_processes == 1 && !class_cache)
+          job().apply(iface_);
+        else
+          jobs_.push_back(JobSpec{task, key, job});
+      }
+
+      void run() {
+        if (jobs_.empty())
+          return;
+        std::cout.flush();
+
+        const std::string workdir = srcdir_ + ".build_libint." + std::to_string(getpid()) + "/";
+        if (mkdir(workdir.c_str(), 0755) != 0)
+          throw std::runtime_error("ClassGenerator::run() -- could not create directory " + workdir);
+
+        // the directory of the cache entry of each job, empty if the job must be run
+        std::vector<std::string> cached(jobs_.size());
+        if (class_cache)
+          for(size_t j=0; j!=jobs_.size(); ++j)
+            cached[j] = class_cache->find(cache_key(jobs_[j]));
+
+        unsigned int nrunning = 0;
+        bool success = true;
+        auto wait_for_job = [&nrunning,&success]() {
+          int status;
+          if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            success = false;
+          --nrunning;
+        };
+        for(size_t j=0; j!=jobs_.size() && success; ++j) {
+          if (!cached[j].empty())
+            continue;
+          if (nrunning == nbuild_processes)
+            wait_for_job();
+          const pid_t pid = fork();
+          if (pid < 0)
+            throw std::runtime_error("ClassGenerator::run() -- fork failed");
+          if (pid == 0) {
+            int status = 0;
+            try {
+              work(j, job_directory(workdir, j));
+            }
+            catch(std::exception& e) {
+              std::cout << "  Caught an exception in job " << j << ": " << e.what() << std::endl;
+              status = 1;
+            }
+            std::cout.flush();
+            // skip the cleanup of the generator's state, e.g. do not write the library interface
+            _exit(status);
+          }
+          ++nrunning;
+        }
+        while (nrunning != 0)
+          wait_for_job();
+        if (!success)
+          throw std::runtime_error("ClassGenerator::run() -- a job failed, its output is in " + workdir);
+
+        // merge the results in the job order
+        LibraryTaskManager& taskmgr = LibraryTaskManager::Instance();
+        std::set<std::string> installed_files;
+        for(size_t j=0; j!=jobs_.size(); ++j) {
+          const bool hit = !cached[j].empty();
+          const std::string jobdir = hit ? cached[j] : job_directory(workdir, j);
+          if (hit)
+            std::cout << "working on " << jobs_[j].key << " ... cached" << std::endl;
+
+          std::vector<std::string> files;
+          {
+            std::ifstream is(jobdir + "files");
+            std::string filename;
+            while (std::getline(is, filename))
+              files.push_back(filename);
+          }
+          if (!hit && class_cache) {
+            std::vector<std::string> entry_files(files);
+            entry_files.push_back("output");
+            entry_files.push_back("files");
+            class_cache->store(cache_key(jobs_[j]), jobdir, entry_files);
+          }
+
+          {
+            std::ifstream is(jobdir + "output");
+            ClassIface class_iface;
+            class_iface.read(is);
+            for(auto& decl_filename: class_iface.decl_filenames)
+              decl_filename = srcdir_ + decl_filename;
+            class_iface.apply(iface_);
+            FunctionCosts::Instance().read(is);
+            CR_DerivGauss_GenericInstantiator::instance().read(is);
+
+            size_t nsymbols;
+            is >> nsymbols;
+            is.ignore();
+            TaskExternSymbols::SymbolList symbols(nsymbols);
+            for(auto& symbol: symbols)
+              std::getline(is, symbol);
+            if (!is)
+              throw std::runtime_error("ClassGenerator::run() -- corrupt output of job " + std::to_string(j));
+            taskmgr.current().symbols()->add(symbols);
+          }
+
+          std::vector<std::string> class_installed_files;
+          for(const auto& filename: files) {
+            if (installed_files.insert(filename).second) {
+              install_file(jobdir + filename, srcdir_ + filename, !hit);
+              class_installed_files.push_back(filename);
+            }
+            else if (!hit)
+              std::remove((jobdir + filename).c_str());
+          }
+          class_files.push_back(std::make_pair(jobs_[j].key, class_installed_files));
+
+          if (!hit) {
+            std::remove((jobdir + "output").c_str());
+            std::remove((jobdir + "files").c_str());
+            rmdir(jobdir.c_str());
+          }
+        }
+        rmdir(workdir.c_str());
+        jobs_.clear();
+      }
+
+    private:
+      std::ostream& os_;
+      SafePtr<CompilationParameters> cparams_;
+      SafePtr<Libint2Iface>& iface_;
+      std::string srcdir_;  // the source directory of the generated library
+      struct JobSpec {
+        std::string task;
+        std::string key;
+        Job job;
+      };
+      std::vector<JobSpec> jobs_;
+
+      static std::string job_directory(const std::string& workdir, size_t j) {
+        return workdir + "job." + std::to_string(j) + "/";
+      }
+
+      /// @return the key of the cache entry for job, i.e. the description of everything its output depends on
+      std::string cache_key(const JobSpec& job) const {
+        std::ostringstream oss;
+        oss << generator_key
+            << "TASK " << job.task << "\n"
+            << "OPT_AM " << cparams_->max_am_opt(job.task) << "\n"
+            << "CLASS " << job.key << "\n";
+        return oss.str();
+      }
+
+      // executed by the process that runs job j, writes the output of the job to jobdir
+      void work(size_t j, const std::string& jobdir) {
+        if (mkdir(jobdir.c_str(), 0755) != 0)
+          throw std::runtime_error("ClassGenerator::work() -- could not create directory " + jobdir);
+        // the code of the class and of the set-level RRs is generated in jobdir
+        cparams_->source_directory(jobdir);
+        // only report the costs of the RRs generated by this job
+        FunctionCosts::Instance().clear();
+        ClassIface class_iface = jobs_[j].job();
+        std::deque<std::string> decl_filenames, def_filenames;
+        generate_rr_code(os_, cparams_, decl_filenames, def_filenames);
+
+        // the generated files are referred to by their names relative to the source directory
+        for(auto& decl_filename: class_iface.decl_filenames) {
+          if (decl_filename.compare(0, jobdir.size(), jobdir) != 0)
+            throw std::runtime_error("ClassGenerator::work() -- " + decl_filename + " is not in " + jobdir);
+          decl_filename = decl_filename.substr(jobdir.size());
+        }
+        std::vector<std::string> files;
+        {
+          DIR* dir = opendir(jobdir.c_str());
+          if (dir == nullptr)
+            throw std::runtime_error("ClassGenerator::work() -- could not read directory " + jobdir);
+          while (const struct dirent* entry = readdir(dir)) {
+            const std::string filename(entry->d_name);
+            if (filename != "." && filename != "..")
+              files.push_back(filename);
+          }
+          closedir(dir);
+        }
+        std::sort(files.begin(), files.end());
+        std::ofstream fs(jobdir + "files");
+        for(const auto& filename: files)
+          fs << filename << "\n";
+        if (!fs)
+          throw std::runtime_error("ClassGenerator::work() -- could not write the list of files of job " + std::to_string(j));
+
+        // report the ClassIface, the cost of the RRs, the instances of generic code, and the external symbols of the task
+        // (including those of the RRs)
+        std::ofstream of(jobdir + "output");
+        class_iface.write(of);
+        FunctionCosts::Instance().write(of);
+        CR_DerivGauss_GenericInstantiator::instance().write(of);
+        const auto& symbols = LibraryTaskManager::Instance().current().symbols()->symbols();
+        of << symbols.size() << "\n";
+        for(const auto& symbol: symbols)
+          of << symbol << "\n";
+        if (!of)
+          throw std::runtime_error("ClassGenerator::work() -- could not write the output of job " + std::to_string(j));
+      }
+  };
+
+  /**
+   * Writes the manifest of the files installed by ClassGenerator, class_manifest_name, to the source directory.
+   * The files listed in the manifest written by the previous run, and not installed by this run, are removed,
+   * unless they have been written during this run (e.g. the code of an RR that is now generated outside of ClassGenerator).
+   * The manifest is included by the makefile of the library; it makes the objects compiled from the listed
+   * files depend on the evaluator type, which is the only generated header whose changes affect
+   * the code generated for a class, if the code itself did not change.
+   * @param start the time when this run of the generator started
+   */
+  void write_class_manifest(const SafePtr<CompilationParameters>& cparams, std::time_t start) {
+    const std::string srcdir = cparams->source_directory();
+    const std::string manifest = srcdir + class_manifest_name;
+
+    std::set<std::string> files;
+    for(const auto& c: class_files)
+      files.insert(c.second.begin(), c.second.end());
+
+    // remove stale files
+    {
+      const std::string prefix("LIBINT2_CLASS_FILES +=");
+      std::ifstream is(manifest);
+      std::string line;
+      while (std::getline(is, line)) {
+        if (line.compare(0, prefix.size(), prefix) != 0)
+          continue;
+        std::istringstream iss(line.substr(prefix.size()));
+        std::string filename;
+        while (iss >> filename) {
+          struct stat s;
+          if (files.find(filename) == files.end() &&
+              stat((srcdir + filename).c_str(), &s) == 0 && s.st_mtime < start)
+            std::remove((srcdir + filename).c_str());
+        }
+      }
+    }
+
+    GeneratedFile os(manifest);
+    os << "# generated by build_libint -- the files generated for each class of integrals" << endl
+       << "LIBINT2_CLASS_FILES =" << endl;
+    std::set<std::string> listed;
+    for(const auto& c: class_files) {
+      os << "# " << c.first << endl << "LIBINT2_CLASS_FILES +=";
+      for(const auto& filename: c.second)
+        if (listed.insert(filename).second)
+          os << " " << filename;
+      os << endl;
+    }
+    os << endl
+       << "# the code of the classes depends on the layout of the evaluator type" << endl
+       << "$(patsubst %.cc,%.$(OBJSUF),$(filter %.cc,$(LIBINT2_CLASS_FILES))): libint2_types.h" << endl;
+  }
+
+  /**
+   * @return the common part of the cache keys of all classes: the hash of the generator executable,
+   * the scheduling options, and the parameters of the generated code that do not depend on the task
+   */
+  std::string make_generator_key(const char* argv0, const SafePtr<CompilationParameters>& cparams) {
+    std::string executable;
+    try {
+      executable = read_file("/proc/self/exe");
+    }
+    catch(std::runtime_error&) {
+      executable = read_file(argv0);
+    }
+    std::ostringstream oss;
+    oss << "GENERATOR " << hash_string(executable) << "\n"
+        << "SCHEDULE " << static_cast<int>(schedule) << " " << schedule_cache_size << "\n"
+        << "MAX_VECTOR_LENGTH " << cparams->max_vector_length() << "\n"
+        << "VECTORIZE_BY_LINE " << cparams->vectorize_by_line() << "\n"
+        << "ALIGN_SIZE " << cparams->align_size() << "\n"
+        << "VECTOR_ISA " << cparams->vector_isa() << "\n"
+        << "UNROLL_THRESH " << cparams->unroll_threshold() << "\n"
+        << "API_PREFIX " << cparams->api_prefix() << "\n"
+        << "SINGLE_EVALTYPE " << cparams->single_evaltype() << "\n"
+        << "USE_C_LINKING " << cparams->use_C_linking() << "\n"
+        << "COUNT_FLOPS " << cparams->count_flops() << "\n"
+        << "PROFILE " << cparams->profile() << "\n"
+        << "ACCUMULATE_TARGETS " << cparams->accumulate_targets() << "\n"
+        << "REALTYPE " << cparams->realtype() << "\n"
+        << "CONTRACTED_TARGETS " << cparams->contracted_targets() << "\n";
+    return oss.str();
+  }
+
+}
+
 #ifdef INCLUDE_ONEBODY
 
 #  if  LIBINT_SUPPORT_ONEBODYINTS == 0
@@ -311,9 +826,11 @@ build_onebody_1b_1k(std::ostream& os, std::string label, const SafePtr<Compilati
   //    explicit source code
   //
   SafePtr<DirectedGraph> dg(new DirectedGraph);
+  configure_schedule(dg);
   SafePtr<Strategy> strat(new Strategy());
   SafePtr<CodeContext> context(new CppCodeContext(cparams));
-  SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
+  SafePtr<LivenessMemoryManager> memman(new LivenessMemoryManager());
+  ClassGenerator generator(os, cparams, iface);
 
   for(unsigned int la=0; la<=lmax; la++) {
     for(unsigned int lb=0; lb<=lmax; lb++) {
@@ -325,6 +842,7 @@ build_onebody_1b_1k(std::ostream& os, std::string label, const SafePtr<Compilati
              )
             continue;
 
+          generator.add(task, class_key(task, {la, lb}), [=, &os]() -> ClassIface {
           SafePtr<Tactic> tactic(new TwoCenter_OS_Tactic(la,lb));
 
           // this will hold all target shell sets
@@ -416,7 +934,7 @@ build_onebody_1b_1k(std::ostream& os, std::string label, const SafePtr<Compilati
 
           dg->registry()->unroll_threshold(unroll_threshold);
           dg->registry()->do_cse(need_to_optimize);
-          dg->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1));
+          dg->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
           // Need to accumulate integrals?
           dg->registry()->accumulate_targets(cparams->accumulate_targets());
 
@@ -445,32 +963,36 @@ build_onebody_1b_1k(std::ostream& os, std::string label, const SafePtr<Compilati
           std::deque<std::string> decl_filenames;
           std::deque<std::string> def_filenames;
 
+          ClassIface class_iface;
+
           // this will generate code for this targets, and potentially generate code for its prerequisites
           GenerateCode(dg, context, cparams, strat, tactic, memman,
                        decl_filenames, def_filenames,
-                       prefix, eval_label, false);
+                       prefix, eval_label, false, &class_iface.cost);
 
-          // update max stack size and # of targets
-          const SafePtr<TaskParameters>& tparams = taskmgr.current().params();
-          tparams->max_stack_size(max_am, memman->max_memory_used());
-          tparams->max_ntarget(targets.size());
-          //os << " Max memory used = " << memman->max_memory_used() << std::endl;
+          class_iface.task = task;
+          class_iface.max_am = max_am;
+          class_iface.max_stack_size = memman->max_memory_used();
+          class_iface.ntarget = targets.size();
+
+          class_iface.cost.stack_size = memman->report().peak;
+          for(const auto& target: targets)
+            class_iface.cost.target_size += target->size();
+          {
+            ostringstream oss;
+            oss << "[" << la << "][" << lb << "]";
+            class_iface.indices = oss.str();
+          }
 
           // set pointer to the top-level evaluator function
           ostringstream oss;
-          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << "[" << la << "][" << lb << "] = "
+          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << class_iface.indices << " = "
               << context->label_to_name(label_to_funcname(eval_label))
               << context->end_of_stat() << endl;
-          iface->to_static_init(oss.str());
+          class_iface.static_init = oss.str();
 
           // need to declare this function internally
-          for(std::deque<std::string>::const_iterator i=decl_filenames.begin();
-              i != decl_filenames.end();
-              ++i) {
-            oss.str("");
-            oss << "#include <" << *i << ">" << endl;
-            iface->to_int_iface(oss.str());
-          }
+          class_iface.decl_filenames = decl_filenames;
 
 #if DEBUG
           os << "Max memory used = " << memman->max_memory_used() << endl;
@@ -478,10 +1000,14 @@ build_onebody_1b_1k(std::ostream& os, std::string label, const SafePtr<Compilati
           dg->reset();
           memman->reset();
 
-          std::cout << "done" << std::endl;
+          std::cout << "done, " << stack_report(memman) << std::endl;
+
+          return class_iface;
+          });
 
     } // end of b loop
   } // end of a loop
+  generator.run();
 }
 #endif
 
@@ -489,6 +1015,36 @@ void try_main (int argc, char* argv[])
 {
   std::ostream& os = cout;
 
+  // "-j N" generates the integral classes in N processes
+  // "--schedule=depth-first|min-working-set" selects the scheduling algorithm
+  // "--schedule-cache-size=N" sets the working set size targeted by the min-working-set schedule
+  // "--variant=NAME" generates the two-body classes with the given variant (see Variant)
+  // "--tune-manifest=FILE" generates each two-body class listed in FILE with the variant given for it
+  // "--cache-dir=DIR" reuses the code generated for the classes by previous runs, kept in DIR (see ClassGenerator)
+  const std::time_t start = std::time(nullptr);
+  std::string cache_dir;
+  for(int a=1; a<argc; ++a) {
+    const std::string arg(argv[a]);
+    if (arg.compare(0, 2, "-j") == 0) {
+      const std::string njobs = arg.size() > 2 ? arg.substr(2) : (a+1 < argc ? argv[++a] : "");
+      nbuild_processes = std::max(1, std::atoi(njobs.c_str()));
+    }
+    else if (arg == "--schedule=depth-first")
+      schedule = GraphRegistry::Schedule::DepthFirst;
+    else if (arg == "--schedule=min-working-set")
+      schedule = GraphRegistry::Schedule::MinWorkingSet;
+    else if (arg.compare(0, 22, "--schedule-cache-size=") == 0)
+      schedule_cache_size = std::atoi(arg.c_str() + 22);
+    else if (arg.compare(0, 10, "--variant=") == 0)
+      default_variant = variant_from_label(arg.substr(10));
+    else if (arg.compare(0, 16, "--tune-manifest=") == 0)
+      read_tune_manifest(arg.substr(16));
+    else if (arg.compare(0, 12, "--cache-dir=") == 0)
+      cache_dir = arg.substr(12);
+    else
+      throw std::invalid_argument("build_libint: unknown argument " + arg);
+  }
+
   // First must declare the tasks
   LibraryTaskManager& taskmgr = LibraryTaskManager::Instance();
   taskmgr.add("default");
@@ -711,6 +1267,16 @@ BOOST_PP_LIST_FOR_EACH ( BOOST_PP_ONEBODY_MCR1, _, BOOST_PP_ONEBODY_TASK_LIST)
 #ifdef LIBINT_ALIGN_SIZE
   cparams->align_size(LIBINT_ALIGN_SIZE);
 #endif
+#ifdef LIBINT_VECTOR_ISA
+  cparams->vector_isa(LIBINT_VECTOR_ISA);
+  {
+    // explicit SIMD code is written only for lines that fill a whole number of registers
+    const unsigned int width = simd_width(cparams->vector_isa());
+    if (!cparams->vectorize_by_line() || width == 0 || cparams->max_vector_length() % width != 0)
+      throw std::invalid_argument("build_libint: vector ISA " + cparams->vector_isa() +
+                                  " requires line vectorization with vector length divisible by the register width");
+  }
+#endif
 #if LIBINT_FLOP_COUNT
   cparams->count_flops(true);
 #endif
@@ -789,6 +1355,11 @@ BOOST_PP_LIST_FOR_EACH ( BOOST_PP_ONEBODY_MCR1, _, BOOST_PP_ONEBODY_TASK_LIST)
 #endif
   cparams->print(os);
 
+  if (!cache_dir.empty()) {
+    class_cache = SafePtr<ClassCache>(new ClassCache(cache_dir));
+    generator_key = make_generator_key(argv[0], cparams);
+  }
+
 #ifdef INCLUDE_ONEBODY
   for(unsigned int d=0; d<=INCLUDE_ONEBODY; ++d) {
 #   define BOOST_PP_ONEBODY_MCR7(r,data,i,elem)          \
@@ -837,6 +1408,15 @@ BOOST_PP_LIST_FOR_EACH ( BOOST_PP_ONEBODY_MCR1, _, BOOST_PP_ONEBODY_TASK_LIST)
   std::deque<std::string> decl_filenames, def_filenames;
   generate_rr_code(os,cparams, decl_filenames, def_filenames);
 
+  // now that the flops of the RRs are known, emit the cost of each class
+  costs_to_api(cparams,iface);
+
+  // the manifest describes the files installed by ClassGenerator, which generates the classes directly otherwise
+  if (nbuild_processes > 1 || class_cache)
+    write_class_manifest(cparams, start);
+  else
+    std::remove((cparams->source_directory() + class_manifest_name).c_str());
+
 #if DEBUG
   // print out the external symbols found for each task
   typedef LibraryTaskManager::TasksCIter tciter;
@@ -941,9 +1521,11 @@ build_TwoPRep_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
   //    explicit source code
   //
   SafePtr<DirectedGraph> dg_xxxx(new DirectedGraph);
+  configure_schedule(dg_xxxx);
   SafePtr<Strategy> strat(new Strategy());
   SafePtr<CodeContext> context(new CppCodeContext(cparams));
-  SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
+  SafePtr<LivenessMemoryManager> memman(new LivenessMemoryManager());
+  ClassGenerator generator(os, cparams, iface);
 
   for(unsigned int la=0; la<=lmax; la++) {
     for(unsigned int lb=0; lb<=lmax; lb++) {
@@ -962,6 +1544,7 @@ build_TwoPRep_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
             continue;
 #endif
 
+          generator.add(task, variant_class_key(class_key(task, {la, lb, lc, ld})), [=, &os]() -> ClassIface {
           // unroll only if max_am <= cparams->max_am_opt(task)
           using std::max;
           const unsigned int max_am = max(max(la,lb),max(lc,ld));
@@ -971,7 +1554,7 @@ build_TwoPRep_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
           const unsigned int unroll_threshold = need_to_optimize && need_to_unroll ? std::numeric_limits<unsigned int>::max() : 0;
           dg_xxxx->registry()->unroll_threshold(unroll_threshold);
           dg_xxxx->registry()->do_cse(need_to_optimize);
-          dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1));
+          dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
           //dg_xxxx->registry()->condense_expr(true);
           // Need to accumulate integrals?
           dg_xxxx->registry()->accumulate_targets(cparams->accumulate_targets());
@@ -1038,38 +1621,45 @@ build_TwoPRep_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
             label += abcd_label;
           }
 
-          std::cout << "working on " << label << " ... "; std::cout.flush();
+          const Variant variant = class_variant(class_key(task, {la, lb, lc, ld}));
+          const SafePtr<Tactic> class_tactic = apply_variant(variant, dg_xxxx, tactic);
+
+          std::cout << "working on " << label << variant_report(variant) << " ... "; std::cout.flush();
 
           std::string prefix(cparams->source_directory());
           std::deque<std::string> decl_filenames;
           std::deque<std::string> def_filenames;
 
+          ClassIface class_iface;
+
           // this will generate code for these targets, and potentially generate code for its prerequisites
-          GenerateCode(dg_xxxx, context, cparams, strat, tactic, memman,
+          GenerateCode(dg_xxxx, context, cparams, strat, class_tactic, memman,
                        decl_filenames, def_filenames,
-                       prefix, label, false);
+                       prefix, label, false, &class_iface.cost);
 
-          // update max stack size and # of targets
-          const SafePtr<TaskParameters>& tparams = taskmgr.current().params();
-          tparams->max_stack_size(max_am, memman->max_memory_used());
-          tparams->max_ntarget(targets.size());
-          //os << " Max memory used = " << memman->max_memory_used() << std::endl;
+          class_iface.task = task;
+          class_iface.max_am = max_am;
+          class_iface.max_stack_size = memman->max_memory_used();
+          class_iface.ntarget = targets.size();
+
+          class_iface.cost.stack_size = memman->report().peak;
+          for(const auto& target: targets)
+            class_iface.cost.target_size += target->size();
+          {
+            ostringstream oss;
+            oss << "[" << la << "][" << lb << "][" << lc << "][" << ld << "]";
+            class_iface.indices = oss.str();
+          }
 
           // set pointer to the top-level evaluator function
           ostringstream oss;
-          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << "[" << la << "][" << lb << "][" << lc << "]["
-              << ld <<"] = " << context->label_to_name(label_to_funcname(label))
+          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << class_iface.indices << " = "
+              << context->label_to_name(label_to_funcname(label))
               << context->end_of_stat() << endl;
-          iface->to_static_init(oss.str());
+          class_iface.static_init = oss.str();
 
           // need to declare this function internally
-          for(std::deque<std::string>::const_iterator i=decl_filenames.begin();
-              i != decl_filenames.end();
-              ++i) {
-            oss.str("");
-            oss << "#include <" << *i << ">" << endl;
-            iface->to_int_iface(oss.str());
-          }
+          class_iface.decl_filenames = decl_filenames;
 
 #if DEBUG
           os << "Max memory used = " << memman->max_memory_used() << endl;
@@ -1077,12 +1667,16 @@ build_TwoPRep_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
           dg_xxxx->reset();
           memman->reset();
 
-          std::cout << "done" << std::endl;
+          std::cout << "done, " << stack_report(memman) << std::endl;
+
+          return class_iface;
+          });
 
         } // end of d loop
       } // end of c loop
     } // end of b loop
   } // end of a loop
+  generator.run();
 }
 
 #endif // INCLUDE_ERI
@@ -1120,9 +1714,11 @@ build_TwoPRep_1b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
   //    explicit source code
   //
   SafePtr<DirectedGraph> dg_xxx(new DirectedGraph);
+  configure_schedule(dg_xxx);
   SafePtr<Strategy> strat(new Strategy());
   SafePtr<CodeContext> context(new CppCodeContext(cparams));
-  SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
+  SafePtr<LivenessMemoryManager> memman(new LivenessMemoryManager());
+  ClassGenerator generator(os, cparams, iface);
 
   for(unsigned int lbra=0; lbra<=lmax; lbra++) {
     for(unsigned int lc=0; lc<=lmax_default; lc++) {
@@ -1146,6 +1742,7 @@ build_TwoPRep_1b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
             continue;
 #endif
 
+          generator.add(task, variant_class_key(class_key(task, {lbra, lc, ld})), [=, &os]() -> ClassIface {
           // unroll only if max_am <= cparams->max_am_opt(task)
           using std::max;
           const unsigned int max_am = max(max(lc,ld),lbra);
@@ -1156,7 +1753,7 @@ build_TwoPRep_1b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
           const unsigned int unroll_threshold = need_to_optimize && need_to_unroll ? std::numeric_limits<unsigned int>::max() : 0;
           dg_xxx->registry()->unroll_threshold(unroll_threshold);
           dg_xxx->registry()->do_cse(need_to_optimize);
-          dg_xxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1));
+          dg_xxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
           //dg_xxx->registry()->condense_expr(true);
           // Need to accumulate integrals?
           dg_xxx->registry()->accumulate_targets(cparams->accumulate_targets());
@@ -1233,38 +1830,45 @@ build_TwoPRep_1b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
             label += abcd_label;
           }
 
-          std::cout << "working on " << label << " ... "; std::cout.flush();
+          const Variant variant = class_variant(class_key(task, {lbra, lc, ld}));
+          const SafePtr<Tactic> class_tactic = apply_variant(variant, dg_xxx, tactic);
+
+          std::cout << "working on " << label << variant_report(variant) << " ... "; std::cout.flush();
 
           std::string prefix(cparams->source_directory());
           std::deque<std::string> decl_filenames;
           std::deque<std::string> def_filenames;
 
+          ClassIface class_iface;
+
           // this will generate code for this targets, and potentially generate code for its prerequisites
-          GenerateCode(dg_xxx, context, cparams, strat, tactic, memman,
+          GenerateCode(dg_xxx, context, cparams, strat, class_tactic, memman,
                        decl_filenames, def_filenames,
-                       prefix, label, false);
+                       prefix, label, false, &class_iface.cost);
 
-          // update max stack size and # of targets
-          const SafePtr<TaskParameters>& tparams = taskmgr.current().params();
-          tparams->max_stack_size(max_am, memman->max_memory_used());
-          tparams->max_ntarget(targets.size());
-          //os << " Max memory used = " << memman->max_memory_used() << std::endl;
+          class_iface.task = task;
+          class_iface.max_am = max_am;
+          class_iface.max_stack_size = memman->max_memory_used();
+          class_iface.ntarget = targets.size();
+
+          class_iface.cost.stack_size = memman->report().peak;
+          for(const auto& target: targets)
+            class_iface.cost.target_size += target->size();
+          {
+            ostringstream oss;
+            oss << "[" << lbra << "][" << lc << "][" << ld << "]";
+            class_iface.indices = oss.str();
+          }
 
           // set pointer to the top-level evaluator function
           ostringstream oss;
-          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << "[" << lbra << "][" << lc << "][" << ld << "] = "
+          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << class_iface.indices << " = "
               << context->label_to_name(label_to_funcname(label))
               << context->end_of_stat() << endl;
-          iface->to_static_init(oss.str());
+          class_iface.static_init = oss.str();
 
           // need to declare this function internally
-          for(std::deque<std::string>::const_iterator i=decl_filenames.begin();
-              i != decl_filenames.end();
-              ++i) {
-            oss.str("");
-            oss << "#include <" << *i << ">" << endl;
-            iface->to_int_iface(oss.str());
-          }
+          class_iface.decl_filenames = decl_filenames;
 
 #if DEBUG
           os << "Max memory used = " << memman->max_memory_used() << endl;
@@ -1272,9 +1876,15 @@ build_TwoPRep_1b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
           dg_xxx->reset();
           memman->reset();
 
+          std::cout << "done, " << stack_report(memman) << std::endl;
+
+          return class_iface;
+          });
+
       } // end of d loop
     } // end of c loop
   } // end of bra loop
+  generator.run();
 }
 #endif // INCLUDE_ERI3
 
@@ -1307,9 +1917,11 @@ build_TwoPRep_1b_1k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
   //    explicit source code
   //
   SafePtr<DirectedGraph> dg_xxx(new DirectedGraph);
+  configure_schedule(dg_xxx);
   SafePtr<Strategy> strat(new Strategy());
   SafePtr<CodeContext> context(new CppCodeContext(cparams));
-  SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
+  SafePtr<LivenessMemoryManager> memman(new LivenessMemoryManager());
+  ClassGenerator generator(os, cparams, iface);
 
   for(unsigned int lbra=0; lbra<=lmax; lbra++) {
     for(unsigned int lket=0; lket<=lmax; lket++) {
@@ -1331,6 +1943,7 @@ build_TwoPRep_1b_1k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
             continue;
 #endif
 
+          generator.add(task, variant_class_key(class_key(task, {lbra, lket})), [=, &os]() -> ClassIface {
           // unroll only if max_am <= cparams->max_am_opt(task)
           using std::max;
           const unsigned int max_am = max(lbra,lket);
@@ -1340,7 +1953,7 @@ build_TwoPRep_1b_1k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
           const unsigned int unroll_threshold = need_to_optimize && need_to_unroll ? std::numeric_limits<unsigned int>::max() : 0;
           dg_xxx->registry()->unroll_threshold(unroll_threshold);
           dg_xxx->registry()->do_cse(need_to_optimize);
-          dg_xxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1));
+          dg_xxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
           // Need to accumulate integrals?
           dg_xxx->registry()->accumulate_targets(cparams->accumulate_targets());
 
@@ -1420,38 +2033,45 @@ build_TwoPRep_1b_1k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
             label += abcd_label;
           }
 
-          std::cout << "working on " << label << " ... "; std::cout.flush();
+          const Variant variant = class_variant(class_key(task, {lbra, lket}));
+          const SafePtr<Tactic> class_tactic = apply_variant(variant, dg_xxx, tactic);
+
+          std::cout << "working on " << label << variant_report(variant) << " ... "; std::cout.flush();
 
           std::string prefix(cparams->source_directory());
           std::deque<std::string> decl_filenames;
           std::deque<std::string> def_filenames;
 
+          ClassIface class_iface;
+
           // this will generate code for this targets, and potentially generate code for its prerequisites
-          GenerateCode(dg_xxx, context, cparams, strat, tactic, memman,
+          GenerateCode(dg_xxx, context, cparams, strat, class_tactic, memman,
                        decl_filenames, def_filenames,
-                       prefix, label, false);
+                       prefix, label, false, &class_iface.cost);
 
-          // update max stack size and # of targets
-          const SafePtr<TaskParameters>& tparams = taskmgr.current().params();
-          tparams->max_stack_size(max_am, memman->max_memory_used());
-          tparams->max_ntarget(targets.size());
-          //os << " Max memory used = " << memman->max_memory_used() << std::endl;
+          class_iface.task = task;
+          class_iface.max_am = max_am;
+          class_iface.max_stack_size = memman->max_memory_used();
+          class_iface.ntarget = targets.size();
+
+          class_iface.cost.stack_size = memman->report().peak;
+          for(const auto& target: targets)
+            class_iface.cost.target_size += target->size();
+          {
+            ostringstream oss;
+            oss << "[" << lbra << "][" << lket << "]";
+            class_iface.indices = oss.str();
+          }
 
           // set pointer to the top-level evaluator function
           ostringstream oss;
-          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << "[" << lbra << "][" << lket << "] = "
+          oss << context->label_to_name(cparams->api_prefix()) << "libint2_build_" << task << class_iface.indices << " = "
               << context->label_to_name(label_to_funcname(label))
               << context->end_of_stat() << endl;
-          iface->to_static_init(oss.str());
+          class_iface.static_init = oss.str();
 
           // need to declare this function internally
-          for(std::deque<std::string>::const_iterator i=decl_filenames.begin();
-              i != decl_filenames.end();
-              ++i) {
-            oss.str("");
-            oss << "#include <" << *i << ">" << endl;
-            iface->to_int_iface(oss.str());
-          }
+          class_iface.decl_filenames = decl_filenames;
 
 #if DEBUG
           os << "Max memory used = " << memman->max_memory_used() << endl;
@@ -1459,9 +2079,15 @@ build_TwoPRep_1b_1k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
           dg_xxx->reset();
           memman->reset();
 
+          std::cout << "done, " << stack_report(memman) << std::endl;
+
+          return class_iface;
+          });
+
     } // end of ket loop
   } // end of bra loop
 
+  generator.run();
 }
 #endif // INCLUDE_ERI2
 
@@ -1497,12 +2123,13 @@ build_R12kG12_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
   //    explicit source code
   //
   SafePtr<DirectedGraph> dg_xxxx(new DirectedGraph);
+  configure_schedule(dg_xxxx);
   SafePtr<Strategy> strat(new Strategy);
   SafePtr<Tactic> tactic(new FirstChoiceTactic<DummyRandomizePolicy>);
   //SafePtr<Tactic> tactic(new RandomChoiceTactic());
   //SafePtr<Tactic> tactic(new FewestNewVerticesTactic(dg_xxxx));
   SafePtr<CodeContext> context(new CppCodeContext(cparams));
-  SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
+  SafePtr<LivenessMemoryManager> memman(new LivenessMemoryManager());
 
   for(unsigned int la=0; la<=lmax; la++) {
     for(unsigned int lb=0; lb<=lmax; lb++) {
@@ -1525,7 +2152,7 @@ build_R12kG12_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpar
           const unsigned int unroll_threshold = need_to_optimize ? cparams->unroll_threshold() : 0;
           dg_xxxx->registry()->unroll_threshold(unroll_threshold);
           dg_xxxx->registry()->do_cse(need_to_optimize);
-          dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1));
+          dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
           // Need to accumulate integrals?
           dg_xxxx->registry()->accumulate_targets(cparams->accumulate_targets());
 
@@ -1690,10 +2317,11 @@ build_R12kG12_2b_2k_separate(std::ostream& os, const SafePtr<CompilationParamete
     iface->to_params(iface->macro_define("SUPPORT_T1G12",0));
 
     SafePtr<DirectedGraph> dg_xxxx(new DirectedGraph);
+    configure_schedule(dg_xxxx);
     SafePtr<Strategy> strat(new Strategy);
     SafePtr<Tactic> tactic(new FirstChoiceTactic<DummyRandomizePolicy>);
     SafePtr<CodeContext> context(new CppCodeContext(cparams));
-    SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
+    SafePtr<LivenessMemoryManager> memman(new LivenessMemoryManager());
 
     for(unsigned int la=0; la<=lmax; la++) {
       for(unsigned int lb=0; lb<=lmax; lb++) {
@@ -1712,7 +2340,7 @@ build_R12kG12_2b_2k_separate(std::ostream& os, const SafePtr<CompilationParamete
             const unsigned int unroll_threshold = need_to_optimize ? cparams->unroll_threshold() : 0;
             dg_xxxx->registry()->unroll_threshold(unroll_threshold);
             dg_xxxx->registry()->do_cse(need_to_optimize);
-            dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1));
+            dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
             // Need to accumulate integrals?
             dg_xxxx->registry()->accumulate_targets(cparams->accumulate_targets());
 
@@ -1821,6 +2449,7 @@ build_G12DKH_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpara
   //    explicit source code
   //
   SafePtr<DirectedGraph> dg_xxxx(new DirectedGraph);
+  configure_schedule(dg_xxxx);
   SafePtr<Strategy> strat(new Strategy);
   SafePtr<Tactic> tactic(new FirstChoiceTactic<DummyRandomizePolicy>);
   for(int la=0; la<=lmax; la++) {
@@ -1847,7 +2476,7 @@ build_G12DKH_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpara
           const unsigned int unroll_threshold = need_to_optimize ? cparams->unroll_threshold() : 0;
           dg_xxxx->registry()->unroll_threshold(unroll_threshold);
           dg_xxxx->registry()->do_cse(need_to_optimize);
-          dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1));
+          dg_xxxx->registry()->condense_expr(condense_expr(cparams->unroll_threshold(),cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
           // Need to accumulate integrals?
           dg_xxxx->registry()->accumulate_targets(cparams->accumulate_targets());
 
@@ -1903,7 +2532,7 @@ build_G12DKH_2b_2k(std::ostream& os, const SafePtr<CompilationParameters>& cpara
           }
 
           SafePtr<CodeContext> context(new CppCodeContext(cparams));
-          SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
+          SafePtr<LivenessMemoryManager> memman(new LivenessMemoryManager());
           dg_xxxx->apply(strat,tactic);
           dg_xxxx->optimize_rr_out(context);
           dg_xxxx->traverse();
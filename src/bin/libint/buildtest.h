@@ -41,7 +41,8 @@ namespace libint2 {
                         std::deque<std::string>& decl_filenames,
                         std::deque<std::string>& def_filenames);
 
-  /// defined below generates code for dg; dg and memman are reset at the end
+  /// defined below generates code for dg; dg and memman are reset at the end.
+  /// If cost is given, the cost of the generated code is added to it
   void
     GenerateCode(const SafePtr<DirectedGraph>& dg,
                  const SafePtr<CodeContext>& context,
@@ -53,7 +54,8 @@ namespace libint2 {
                  std::deque<std::string>& def_filenames,
                  const std::string& prefix,
                  const std::string& label,
-                 bool have_parent);
+                 bool have_parent,
+                 ClassCost* cost = 0);
 
   /// Command-line parser for the standard build tester -- N is the number of centers, i.e. 4 for 4-center ERI
   template <unsigned int N>
@@ -153,7 +155,7 @@ namespace libint2 {
 
       // configure the graph
       dg_xxxx->registry()->do_cse(need_to_optimize);
-      dg_xxxx->registry()->condense_expr(condense_expr(size_to_unroll,cparams->max_vector_length()>1));
+      dg_xxxx->registry()->condense_expr(condense_expr(size_to_unroll,cparams->max_vector_length()>1 && cparams->vector_isa().empty()));
       // Need to accumulate integrals?
       dg_xxxx->registry()->accumulate_targets(cparams->accumulate_targets());
       dg_xxxx->registry()->unroll_threshold(size_to_unroll);
@@ -225,7 +227,8 @@ namespace libint2 {
                std::deque<std::string>& def_filenames,
                const std::string& prefix,
                const std::string& label,
-               bool have_parent) {
+               bool have_parent,
+               ClassCost* cost) {
 
     dg->apply(strat,tactic);
 #if PRINT_DAG_GRAPHVIZ
@@ -270,6 +273,10 @@ namespace libint2 {
     declfile.close();
     deffile.close();
 
+    // the code of a graph with a parent computes the prerequisites of the parent for one primitive combination
+    if (cost)
+      (have_parent ? cost->primitive : cost->shellset) += dg->cost();
+
     // extract all external symbols
     extract_symbols(dg);
 
@@ -315,7 +322,7 @@ namespace libint2 {
       const std::string label_prereq = label + "_prereq";
       GenerateCode(dg_prereq, context, cparams, strat, tactic, memman,
                    decl_filenames, def_filenames,
-                   prefix, label_prereq, true);
+                   prefix, label_prereq, true, cost);
 
     }
     dg->reset();
@@ -343,6 +350,10 @@ namespace libint2 {
     cparams->vectorize_by_line(vec_by_line);
 #if LIBINT_ALIGN_SIZE
     cparams->align_size(LIBINT_ALIGN_SIZE);
+#endif
+#ifdef LIBINT_VECTOR_ISA
+    if (vec_by_line && simd_width(LIBINT_VECTOR_ISA) != 0 && veclen % simd_width(LIBINT_VECTOR_ISA) == 0)
+      cparams->vector_isa(LIBINT_VECTOR_ISA);
 #endif
     cparams->count_flops(true);
 #if LIBINT_ACCUM_INTS
@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cache.h>
+
+using namespace libint2;
+
+namespace {
+  bool file_exists(const std::string& filename) {
+    struct stat s;
+    return stat(filename.c_str(), &s) == 0;
+  }
+  void write_file(const std::string& filename, const std::string& contents) {
+    std::ofstream os(filename.c_str(), std::ios::binary);
+    os << contents;
+    os.close();
+    if (!os)
+      throw std::runtime_error("write_file() -- could not write " + filename);
+  }
+};
+
+std::string
+libint2::hash_string(const std::string& str)
+{
+  unsigned long long h = 14695981039346656037ull;
+  for(const auto c: str) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 1099511628211ull;
+  }
+  std::ostringstream oss;
+  oss << std::hex << std::setw(16) << std::setfill('0') << h;
+  return oss.str();
+}
+
+std::string
+libint2::read_file(const std::string& filename)
+{
+  std::ifstream is(filename.c_str(), std::ios::binary);
+  if (!is)
+    throw std::runtime_error("read_file() -- could not open " + filename);
+  std::ostringstream oss;
+  oss << is.rdbuf();
+  return oss.str();
+}
+
+bool
+libint2::install_file(const std::string& source, const std::string& target, bool move)
+{
+  const std::string contents = read_file(source);
+  const bool changed = !file_exists(target) || read_file(target) != contents;
+  if (changed) {
+    if (!move || std::rename(source.c_str(), target.c_str()) != 0)
+      write_file(target, contents);
+  }
+  if (move)
+    std::remove(source.c_str());
+  return changed;
+}
+
+void
+GeneratedFile::close()
+{
+  if (closed_)
+    return;
+  closed_ = true;
+  const std::string contents = str();
+  if (!file_exists(filename_) || read_file(filename_) != contents)
+    write_file(filename_, contents);
+}
+
+ClassCache::ClassCache(const std::string& directory) :
+  directory_(directory.empty() || directory.back() == '/' ? directory : directory + "/")
+{
+  if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST)
+    throw std::runtime_error("ClassCache::ClassCache() -- could not create directory " + directory_);
+}
+
+std::string
+ClassCache::find(const std::string& key) const
+{
+  const std::string dir = entry(key);
+  if (file_exists(dir + "key") && read_file(dir + "key") == key)
+    return dir;
+  return std::string();
+}
+
+void
+ClassCache::store(const std::string& key, const std::string& dir, const std::vector<std::string>& files) const
+{
+  const std::string target = entry(key);
+  if (file_exists(target))
+    return;
+
+  // populate a private directory, then rename it, so that concurrent generators never see a partial entry
+  const std::string tmp = target.substr(0, target.size() - 1) + ".tmp." + std::to_string(getpid()) + "/";
+  if (mkdir(tmp.c_str(), 0755) != 0)
+    throw std::runtime_error("ClassCache::store() -- could not create directory " + tmp);
+  for(const auto& file: files)
+    install_file(dir + file, tmp + file, false);
+  write_file(tmp + "key", key);
+  if (std::rename(tmp.substr(0, tmp.size() - 1).c_str(), target.substr(0, target.size() - 1).c_str()) != 0) {
+    // another generator stored this entry first
+    for(const auto& file: files)
+      std::remove((tmp + file).c_str());
+    std::remove((tmp + "key").c_str());
+    rmdir(tmp.c_str());
+  }
+}
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_bin_libint_cache_h_
+#define _libint2_src_bin_libint_cache_h_
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace libint2 {
+
+  /// @return the 64-bit FNV-1a hash of str, as 16 hexadecimal digits
+  std::string hash_string(const std::string& str);
+  /// @return the contents of file filename; throws if the file cannot be read
+  std::string read_file(const std::string& filename);
+
+  /**
+     Installs file source as file target. If target already has the same contents it is left untouched,
+     so that its modification time, and hence the object file compiled from it, stays up to date.
+     @param move if true, source is moved (or removed, if target is left untouched), else it is copied
+     @return true if target was written
+  */
+  bool install_file(const std::string& source, const std::string& target, bool move);
+
+  /**
+     GeneratedFile is an output stream whose contents are written to the file by close()
+     (or by the destructor) only if they differ from the current contents of the file; see install_file().
+  */
+  class GeneratedFile : public std::ostringstream {
+    public:
+      GeneratedFile(const std::string& filename) : filename_(filename), closed_(false) {}
+      ~GeneratedFile() { close(); }
+
+      void close();
+
+    private:
+      std::string filename_;
+      bool closed_;
+  };
+
+  /**
+     ClassCache is a directory that keeps the code generated for classes of integrals, to be reused
+     by subsequent runs of the generator. Each entry is a copy of the output directory
+     of the job that generated the code of one class (see ClassGenerator in build_libint.cc),
+     i.e. the generated files and the files that describe them. The entry is addressed by the hash of its key,
+     a description of everything the generated code depends on; the key is stored along with the entry
+     and compared on lookup, hence hash collisions cannot produce a wrong hit.
+  */
+  class ClassCache {
+    public:
+      /// creates the directory if it does not exist
+      ClassCache(const std::string& directory);
+
+      /// @return the directory of the entry for key, or an empty string if there is no such entry
+      std::string find(const std::string& key) const;
+      /// stores files (names relative to dir) of directory dir as the entry for key; an existing entry is kept
+      void store(const std::string& key, const std::string& dir, const std::vector<std::string>& files) const;
+
+    private:
+      std::string directory_;
+
+      std::string entry(const std::string& key) const { return directory_ + hash_string(key) + "/"; }
+  };
+
+};
+
+#endif // header guard
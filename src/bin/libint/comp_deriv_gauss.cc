@@ -52,3 +52,23 @@ CR_DerivGauss_GenericInstantiator::add(unsigned int L, bool vectorize) {
   template_instances_.insert(std::make_pair(L, vectorize));
 }
 
+void
+CR_DerivGauss_GenericInstantiator::write(std::ostream& os) const {
+  os << template_instances_.size() << "\n";
+  for(const auto& v: template_instances_)
+    os << v.first << " " << v.second << "\n";
+}
+
+void
+CR_DerivGauss_GenericInstantiator::read(std::istream& is) {
+  size_t n;
+  is >> n;
+  for(size_t i=0; i!=n; ++i) {
+    unsigned int L;
+    bool vectorize;
+    is >> L >> vectorize;
+    add(L, vectorize);
+  }
+  is.ignore();
+}
+
@@ -23,6 +23,7 @@
 
 #include <generic_rr.h>
 #include <set>
+#include <iostream>
 
 using namespace std;
 
@@ -40,6 +41,11 @@ namespace libint2 {
     public:
       static CR_DerivGauss_GenericInstantiator& instance();
       void add(unsigned int L, bool vectorize);
+
+      /// writes the instances registered so far
+      void write(std::ostream& os) const;
+      /// reads the instances written by write() and registers them
+      void read(std::istream& is);
   };
 
   /** Compute relation for (geometric) derivative Gaussian ints of generic type \c IntType . It either
@@ -19,7 +19,9 @@
  */
 
 #include <cassert>
+#include <cctype>
 #include <cstdio>
+#include <stdexcept>
 #include <context.h>
 #include <codeblock.h>
 #include <default_params.h>
@@ -242,6 +244,8 @@ std::string
 CppCodeContext::std_header() const
 {
   std::string result("#include <libint2.h>\n");
+  if (explicit_simd())
+    result += "#include <libint2/util/simd_line.h>\n";
   return result;
 }
 
@@ -252,9 +256,27 @@ CppCodeContext::std_function_header() const
   if(vectorize_) {
     oss << "const int veclen = inteval->veclen;\n";
   }
+  if (explicit_simd()) {
+    // lines on the stack start at multiples of veclen, hence are aligned to the register width if the stack is
+    const std::string& isa = cparams()->vector_isa();
+    const unsigned int width = simd_width(isa);
+    const bool aligned_stack = cparams()->align_size() != 0 && cparams()->align_size() % width == 0;
+    std::string isa_name(isa);
+    for(std::string::iterator c=isa_name.begin(); c!=isa_name.end(); ++c)
+      *c = toupper(*c);
+    oss << "typedef libint2::simd_line::Kernels<libint2::simd_line::" << isa_name << ","
+        << cparams()->max_vector_length() << "," << (aligned_stack ? "true" : "false")
+        << "> libint2_simd_line" << end_of_stat() << endl;
+  }
   return oss.str();
 }
 
+bool
+CppCodeContext::explicit_simd() const
+{
+  return cparams()->vectorize_by_line() && !cparams()->vector_isa().empty();
+}
+
 std::string
 CppCodeContext::label_to_name(const std::string& label) const
 {
@@ -526,6 +548,40 @@ CppCodeContext::accumulate_ternary_expr(const std::string& name,
   return assign_ternary_expr_(name, arg1, oper1, arg2, oper2, arg3, true);
 }
 
+std::string
+CppCodeContext::simd_line_expr(const std::string& name,
+                               const std::vector<std::string>& args,
+                               const std::string& oper1,
+                               const std::string& oper2,
+                               bool accum)
+{
+  std::string kernel;
+  if (oper1.empty())
+    kernel = "copy";
+  else if (oper2.empty()) {
+    if (oper1 == "+") kernel = "add";
+    else if (oper1 == "-") kernel = "sub";
+    else if (oper1 == "*") kernel = "mul";
+    else if (oper1 == "/") kernel = "div";
+  }
+  else if (oper1 == "*")
+    kernel = (oper2 == "+") ? "fma_plus" : "fma_minus";
+  if (kernel.empty())
+    throw std::logic_error("CppCodeContext::simd_line_expr() -- unknown operator " + oper1 + oper2);
+
+  ostringstream oss;
+  oss << "libint2_simd_line::" << (accum ? "acc_" : "") << kernel << "(&(" << name << ")";
+  for(std::vector<std::string>::const_iterator a=args.begin(); a!=args.end(); ++a) {
+    // lines are passed by pointer, scalars by value
+    if (a->find('[') != std::string::npos)
+      oss << ", &(" << *a << ")";
+    else
+      oss << ", LIBINT2_REALTYPE(" << *a << ")";
+  }
+  oss << ")" << end_of_stat() << endl;
+  return oss.str();
+}
+
 std::string
 CppCodeContext::symbol_to_pointer(const std::string& symbol)
 {
@@ -117,6 +117,17 @@ namespace libint2 {
                                                 const std::string& arg2,
                                                 const std::string& oper2,
                                                 const std::string& arg3) =0;
+    /** simd_line_expr returns a statement which evaluates expression 'args[0] oper1 args[1] oper2 args[2]'
+        for every element of vector line 'name' using explicit SIMD instructions (see CompilationParameters::vector_isa()).
+        The expression is a copy if oper1 is empty, a binary expression if oper2 is empty, and an FMA
+        (oper1 = "*", oper2 = "+" or "-") otherwise. 'name' and 'args' are the symbols of the first elements
+        of the lines; symbols without subscripts are scalars. If accum is true the expression is accumulated to 'name'.
+    */
+    virtual std::string simd_line_expr(const std::string& name,
+                                       const std::vector<std::string>& args,
+                                       const std::string& oper1,
+                                       const std::string& oper2,
+                                       bool accum) =0;
     /// converts an address on the stack to its string representation
     virtual std::string stack_address(const DGVertex::Address& a) const =0;
 
@@ -262,6 +273,12 @@ namespace libint2 {
                                         const std::string& arg2,
                                         const std::string& oper2,
                                         const std::string& arg3);
+    /// Implementation of CodeContext::simd_line_expr()
+    std::string simd_line_expr(const std::string& name,
+                               const std::vector<std::string>& args,
+                               const std::string& oper1,
+                               const std::string& oper2,
+                               bool accum);
     /// Implementation of CodeContext::stack_address()
     std::string stack_address(const DGVertex::Address& a) const;
 
@@ -300,6 +317,9 @@ namespace libint2 {
   private:
     bool vectorize_;
 
+    /// whether lines are evaluated with explicit SIMD instructions
+    bool explicit_simd() const;
+
     /// Implementation of CodeContext::unique_fp_name()
     std::string unique_fp_name() const;
     /// Implementation of CodeContext::unique_int_name()
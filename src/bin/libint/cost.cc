@@ -0,0 +1,132 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdexcept>
+#include <cost.h>
+
+using namespace libint2;
+
+CodeCost&
+CodeCost::operator+=(const CodeCost& other)
+{
+  nflops += other.nflops;
+  for(const auto& call: other.calls)
+    calls[call.first] += call.second;
+  return *this;
+}
+
+void
+CodeCost::write(std::ostream& os) const
+{
+  os << nflops << " " << calls.size() << "\n";
+  for(const auto& call: calls)
+    os << call.first << "\n" << call.second << "\n";
+}
+
+void
+CodeCost::read(std::istream& is)
+{
+  size_t ncalls;
+  is >> nflops >> ncalls;
+  is.ignore();
+  calls.clear();
+  for(size_t c=0; c!=ncalls; ++c) {
+    std::string label;
+    unsigned long n;
+    std::getline(is, label);
+    is >> n;
+    is.ignore();
+    calls[label] = n;
+  }
+  if (!is)
+    throw std::runtime_error("CodeCost::read() -- corrupt input");
+}
+
+void
+ClassCost::write(std::ostream& os) const
+{
+  shellset.write(os);
+  primitive.write(os);
+  os << stack_size << " " << target_size << "\n";
+}
+
+void
+ClassCost::read(std::istream& is)
+{
+  shellset.read(is);
+  primitive.read(is);
+  is >> stack_size >> target_size;
+  is.ignore();
+  if (!is)
+    throw std::runtime_error("ClassCost::read() -- corrupt input");
+}
+
+FunctionCosts FunctionCosts::FC_obj_;
+
+FunctionCosts&
+FunctionCosts::Instance()
+{
+  return FC_obj_;
+}
+
+void
+FunctionCosts::add(const std::string& rrlabel, const CodeCost& cost)
+{
+  costs_.insert(std::make_pair(rrlabel, cost));
+}
+
+unsigned long
+FunctionCosts::nflops(const CodeCost& cost) const
+{
+  unsigned long result = cost.nflops;
+  for(const auto& call: cost.calls) {
+    const auto c = costs_.find(call.first);
+    if (c != costs_.end())
+      result += call.second * nflops(c->second);
+  }
+  return result;
+}
+
+void
+FunctionCosts::write(std::ostream& os) const
+{
+  os << costs_.size() << "\n";
+  for(const auto& c: costs_) {
+    os << c.first << "\n";
+    c.second.write(os);
+  }
+}
+
+void
+FunctionCosts::read(std::istream& is)
+{
+  size_t n;
+  is >> n;
+  is.ignore();
+  for(size_t i=0; i!=n; ++i) {
+    std::string label;
+    std::getline(is, label);
+    CodeCost cost;
+    cost.read(is);
+    add(label, cost);
+  }
+  if (!is)
+    throw std::runtime_error("FunctionCosts::read() -- corrupt input");
+}
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_bin_libint_cost_h_
+#define _libint2_src_bin_libint_cost_h_
+
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace libint2 {
+
+  /**
+     CodeCost is the cost of the code generated by DirectedGraph::generate_code(): the number of flops
+     evaluated inline and the number of times each function that implements a set-level RR is evaluated.
+     Both are counted per iteration over the implicit dimensions of the code. The flops
+     of the called functions are known only once their code has been generated, see FunctionCosts.
+  */
+  struct CodeCost {
+    unsigned long nflops = 0;
+    /// maps the label of the RR (prefixed by the API prefix) to the number of evaluations of its function
+    std::map<std::string, unsigned long> calls;
+
+    CodeCost& operator+=(const CodeCost& other);
+
+    void write(std::ostream& os) const;
+    void read(std::istream& is);
+  };
+
+  /// ClassCost is the cost of the code generated for a class of integrals
+  struct ClassCost {
+    CodeCost shellset;   //< executed once per shell set (e.g. HRR and contraction of the targets)
+    CodeCost primitive;  //< executed once per primitive combination (e.g. VRR), see GenerateCode()
+    unsigned int stack_size = 0;   //< the peak size of the stack
+    unsigned int target_size = 0;  //< the number of integrals in the targets
+
+    void write(std::ostream& os) const;
+    void read(std::istream& is);
+  };
+
+  /// FunctionCosts keeps the cost of the functions generated for set-level RRs. This is a Singleton.
+  class FunctionCosts {
+    public:
+      static FunctionCosts& Instance();
+
+      /// registers the cost of the function generated for RR rrlabel; the first cost registered for rrlabel is kept
+      void add(const std::string& rrlabel, const CodeCost& cost);
+      /// @return the number of flops in cost, including those in the called functions; the calls of
+      /// the functions with no registered cost (e.g. RRs whose code is generated inline) are not counted
+      unsigned long nflops(const CodeCost& cost) const;
+
+      /// forgets all registered costs
+      void clear() { costs_.clear(); }
+      /// writes all registered costs
+      void write(std::ostream& os) const;
+      /// reads the costs written by write() and registers them
+      void read(std::istream& is);
+
+    private:
+      FunctionCosts() {}
+      std::map<std::string, CodeCost> costs_;
+
+      static FunctionCosts FC_obj_;
+  };
+
+};
+
+#endif // header guard
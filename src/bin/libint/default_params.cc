@@ -29,13 +29,14 @@ using namespace std;
 const std::string CompilationParameters::Defaults::source_directory("./");
 const std::string CompilationParameters::Defaults::api_prefix("");
 const std::string CompilationParameters::Defaults::realtype("double");
+const std::string CompilationParameters::Defaults::vector_isa("");
 const std::string CompilationParameters::Defaults::task_name("default");
 
 CompilationParameters::CompilationParameters() :
   default_task_name_(Defaults::task_name),
   max_vector_length_(Defaults::max_vector_length),
   vectorize_by_line_(Defaults::vectorize_by_line),
-  align_size_(Defaults::align_size), unroll_threshold_(Defaults::unroll_threshold),
+  align_size_(Defaults::align_size), vector_isa_(Defaults::vector_isa), unroll_threshold_(Defaults::unroll_threshold),
   source_directory_(Defaults::source_directory), api_prefix_(Defaults::api_prefix),
   single_evaltype_(Defaults::single_evaltype),
   use_C_linking_(Defaults::use_C_linking),
@@ -74,6 +75,8 @@ CompilationParameters::print(std::ostream& os) const
     os << "VECTORIZE_BY_LINE    = " << (vectorize_by_line() ? "true" : "false") << endl;
   if (align_size() > 0)
     os << "ALIGN_SIZE           = " << align_size() << endl;
+  if (!vector_isa().empty())
+    os << "VECTOR_ISA           = " << vector_isa() << endl;
   os << "UNROLL_THRESH        = " << unroll_threshold() << endl;
   os << "SOURCE_DIRECTORY     = " << source_directory() << endl;
   os << "API_PREFIX           = " << api_prefix() << endl;
@@ -231,3 +234,13 @@ libint2::condense_expr(unsigned int unroll_threshold, bool vectorize)
   bool condense_expr = unroll_threshold > 0 && vectorize;
   return condense_expr;
 }
+
+unsigned int
+libint2::simd_width(const std::string& isa)
+{
+  if (isa == "sse2")
+    return 2;
+  if (isa == "avx2")
+    return 4;
+  return 0;
+}
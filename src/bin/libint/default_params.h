@@ -58,6 +58,11 @@ namespace libint2 {
     bool vectorize_by_line() const {
       return vectorize_by_line_;
     }
+    /// returns the instruction set used to write line-vectorized code with explicit SIMD instructions
+    /// ("sse2" or "avx2"); if empty, the generated code relies on the compiler to vectorize the lines
+    const std::string& vector_isa() const {
+      return vector_isa_;
+    }
     /// returns unroll threshold
     unsigned int unroll_threshold() const {
       return unroll_threshold_;
@@ -125,6 +130,10 @@ namespace libint2 {
     void align_size(unsigned int a) {
       align_size_ = a;
     }
+    /// set the instruction set for explicit SIMD code
+    void vector_isa(const std::string& isa) {
+      vector_isa_ = isa;
+    }
     /// set unroll threshold
     void unroll_threshold(unsigned int a) {
       unroll_threshold_ = a;
@@ -187,6 +196,8 @@ namespace libint2 {
       static const bool vectorize_by_line = false;
       /// Use default alignment by default
       static const unsigned int align_size = 0;
+      /// Let the compiler vectorize lines by default
+      static const std::string vector_isa;
       /// Produce quartet-level code by default
       static const unsigned int unroll_threshold = 0;
       /// Where to put generated library source
@@ -236,6 +247,8 @@ namespace libint2 {
         UINT_MAX => standard compiler/library default for scalar code, veclen for vectorized code
       */
     unsigned int align_size_;
+    /// instruction set for explicit SIMD code
+    std::string vector_isa_;
     /// unroll threshold
     unsigned int unroll_threshold_;
     /// source directory
@@ -369,6 +382,9 @@ namespace libint2 {
   /// need to condense expressions? Makes sense if vectorizing the code or the compiler somehow prefers long expressions
   /// It does not make sense if there will be only set-level RR calls
   bool condense_expr(unsigned int unroll_threshold, bool vectorize);
+
+  /// returns the number of doubles in a register of instruction set isa (see CompilationParameters::vector_isa()), 0 if isa is not known
+  unsigned int simd_width(const std::string& isa);
 };
 
 #endif
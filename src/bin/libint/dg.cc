@@ -21,6 +21,8 @@
 #include <cstdio>
 #include <functional>
 #include <utility>
+#include <set>
+#include <algorithm>
 #include <fstream>
 #include <dg.h>
 #include <rr.h>
@@ -46,18 +48,48 @@ using namespace libint2;
 //// utils first
 
 namespace {
-  void push(DirectedGraph::VPtrAssociativeContainer& vertices, const DirectedGraph::ver_ptr& v) {
+  DirectedGraph::VPtrAssociativeContainer::iterator
+  push(DirectedGraph::VPtrAssociativeContainer& vertices, const DirectedGraph::ver_ptr& v) {
     DirectedGraph::key_type vkey = libint2::key(*v);
-    vertices.insert(std::make_pair(vkey,v));
+    return vertices.insert(std::make_pair(vkey,v));
   }
-  void push(DirectedGraph::VPtrSequenceContainer& vertices, const DirectedGraph::ver_ptr& v) {
-    vertices.push_back(v);
+  DirectedGraph::VPtrSequenceContainer::iterator
+  push(DirectedGraph::VPtrSequenceContainer& vertices, const DirectedGraph::ver_ptr& v) {
+    return vertices.insert(vertices.end(),v);
   }
+
+#if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
+  inline DirectedGraph::hash_type hash_combine(DirectedGraph::hash_type h, DirectedGraph::hash_type v) {
+    return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+  }
+
+  /// hashes the key of v; the key of an AlgebraicOperator does not depend on its operands, hence they are hashed also
+  DirectedGraph::hash_type vertex_hash(const DGVertex& v) {
+    typedef AlgebraicOperator<DGVertex> oper_type;
+    DirectedGraph::hash_type h = v.typeid_;
+    if (v.typeid_ == ClassInfo<oper_type>::Instance().id()) {
+      const oper_type& oper = static_cast<const oper_type&>(v);
+      h = hash_combine(h, oper.type());
+      h = hash_combine(h, vertex_hash(*oper.left()));
+      return hash_combine(h, vertex_hash(*oper.right()));
+    }
+    mpz_srcptr instid = v.instid_.get_mpz_t();
+    h = hash_combine(h, mpz_sgn(instid) + 1);
+    const size_t nlimbs = mpz_size(instid);
+    for(size_t l=0; l<nlimbs; ++l)
+      h = hash_combine(h, mpz_getlimbn(instid,l));
+    return h;
+  }
+#endif
 }
 
 
 DirectedGraph::DirectedGraph() :
-  stack_(), targets_(), target_accums_(), label_("graph"), func_names_(),
+  stack_(),
+#if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
+  vertex_table_(),
+#endif
+  targets_(), target_accums_(), label_("graph"), func_names_(),
   registry_(SafePtr<GraphRegistry>(new GraphRegistry)),
   iregistry_(SafePtr<InternalGraphRegistry>(new InternalGraphRegistry)),
   first_to_compute_()
@@ -130,7 +162,11 @@ DirectedGraph::add_new_vertex(const SafePtr<DGVertex>& vertex)
   vertex->set_graph_label(label);
   vertex->dg(this);
 
+#if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
+  vertex_table_.insert(std::make_pair(vertex_hash(*vertex),push(stack_,vertex)));
+#else
   push(stack_,vertex);
+#endif
 #if DEBUG
   cout << "add_new_vertex: added vertex " << vertex->description() << endl;
 #endif
@@ -146,23 +182,15 @@ DirectedGraph::vertex_is_on(const SafePtr<DGVertex>& vertex) const
 
   static SafePtr<DGVertex> null_ptr;
 #if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
-  typedef vertices::const_iterator citer;
-  typedef vertices::value_type value_type;
-  key_type vkey = key(*vertex);
-  // find the first elemnt with this key and iterate until vertex is found or key changes
-  citer vpos = stack_.find(vkey);
-  const citer end = stack_.end();
-  if (vpos != end) {
-    bool can_find = true;
-    while(can_find) {
-      if (can_find && (vpos->second)->equiv(vertex)) {
+  typedef VPtrHashTable::const_iterator citer;
+  const std::pair<citer,citer> range = vertex_table_.equal_range(vertex_hash(*vertex));
+  for(citer vpos=range.first; vpos!=range.second; ++vpos) {
+    const ver_ptr& vptr = vertex_ptr(*(vpos->second));
+    if (vptr->equiv(vertex)) {
 #if DEBUG
-	std::cout << "vertex_is_on: " << (vpos->second)->label() << std::endl;
+      std::cout << "vertex_is_on: " << (vptr)->label() << std::endl;
 #endif
-	return vpos->second;
-      }
-      ++vpos;
-      can_find = (vpos->first == vkey) && (vpos != end);
+      return vptr;
     }
   }
 #else
@@ -186,6 +214,14 @@ DirectedGraph::vertex_is_on(const SafePtr<DGVertex>& vertex) const
 }
 
 namespace {
+  struct __release_arcs {
+    __release_arcs(const DirectedGraph* dg) : dg_(dg) {}
+    void operator()(SafePtr<DGVertex>& v) {
+      if (v->dg() == dg_)
+        v->release_arcs(dg_);
+    }
+    const DirectedGraph* dg_;
+  };
   struct __reset_dgvertex {
     void operator()(SafePtr<DGVertex>& v) {
       v->reset();
@@ -218,6 +254,16 @@ DirectedGraph::del_vertex(vertices::iterator& v)
     std::cout << "del_vertex: trying to remove " << (vertex_ptr(*v))->label() << std::endl;
 #endif
     SafePtr<DGVertex> vptr = vertex_ptr(*v); // keep an instance of the pointer to avoid accidental automatic destruction of the DGVertex object
+#if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
+    typedef VPtrHashTable::iterator hiter;
+    const std::pair<hiter,hiter> range = vertex_table_.equal_range(vertex_hash(*vptr));
+    for(hiter vpos=range.first; vpos!=range.second; ++vpos) {
+      if (vpos->second == v) {
+        vertex_table_.erase(vpos);
+        break;
+      }
+    }
+#endif
     stack_.erase(v);
     rv(vptr);
 #if DEBUG
@@ -265,6 +311,11 @@ DirectedGraph::prepare_to_traverse()
 void
 DirectedGraph::traverse()
 {
+  if (registry()->schedule() == GraphRegistry::Schedule::MinWorkingSet) {
+    traverse_min_working_set();
+    return;
+  }
+
   // Initialization
   prepare_to_traverse();
 
@@ -342,6 +393,101 @@ DirectedGraph::traverse_from(const SafePtr<DGArc>& arc)
   }
 }
 
+/**
+ * List scheduling that minimizes the working set. The schedule is built backwards, from the targets, like
+ * in the depth-first traversal: a vertex is ready once all of its parents have been scheduled.
+ * Going backwards, a vertex is live between the scheduling of its first parent and its own scheduling, i.e.
+ * between its computation and its last use. The ready vertex that became ready last is scheduled next (this
+ * is equivalent to the depth-first traversal and keeps producers close to consumers), unless that makes the
+ * working set exceed GraphRegistry::schedule_cache_size(); then the ready vertex that increases
+ * the working set the least is scheduled.
+ */
+void
+DirectedGraph::traverse_min_working_set()
+{
+  prepare_to_traverse();
+
+  // vertices that are not computed are not part of the working set
+  auto computed = [](const SafePtr<DGVertex>& v) {
+    return !v->precomputed() && v->num_exit_arcs() != 0;
+  };
+  // vertices that are on a subtree, but are not its root, are computed with the root
+  auto on_subtree = [](const SafePtr<DGVertex>& v) {
+    SafePtr<DRTree> stree = v->subtree();
+    return stree && stree->root() != v;
+  };
+
+  std::set<const DGVertex*> live;
+  size live_size = 0;
+  std::vector< SafePtr<DGVertex> > ready;
+
+  // change of the working set size if v is scheduled next
+  auto delta = [&live](const SafePtr<DGVertex>& v) -> long {
+    long result = live.find(v.get()) != live.end() ? -static_cast<long>(v->size()) : 0;
+    std::vector<const DGVertex*> counted;
+    for(auto a=v->first_exit_arc(); a!=v->plast_exit_arc(); ++a) {
+      const SafePtr<DGVertex>& c = (*a)->dest();
+      if (!c->precomputed() && c->num_exit_arcs() != 0 && live.find(c.get()) == live.end() &&
+          std::find(counted.begin(), counted.end(), c.get()) == counted.end()) {
+        counted.push_back(c.get());
+        result += c->size();
+      }
+    }
+    return result;
+  };
+
+  // schedules v, its children become live, and those tagged by all parents become ready
+  std::function<void(const SafePtr<DGVertex>&)> process = [&](const SafePtr<DGVertex>& v) {
+    if (!on_subtree(v))
+      schedule_computation(v);
+    if (live.erase(v.get()))
+      live_size -= v->size();
+    // push the children in reverse order so that, as in the depth-first traversal, children with fewer parents are scheduled first
+    std::vector<DGVertex::ArcSetType::value_type> sorted_children = sort_children_by_nparents(v->first_exit_arc(),
+                                                                                              v->plast_exit_arc());
+    for(auto a=sorted_children.rbegin(); a!=sorted_children.rend(); ++a) {
+      const SafePtr<DGVertex> c = (*a)->dest();
+      if (!computed(c))
+        continue;
+      if (live.insert(c.get()).second)
+        live_size += c->size();
+      if (c->tag() == c->num_entry_arcs()) {
+        if (on_subtree(c))
+          process(c);
+        else
+          ready.push_back(c);
+      }
+    }
+  };
+
+  // start at the targets which don't have parents
+  for(auto v=stack_.rbegin(); v!=stack_.rend(); ++v) {
+    const ver_ptr& vptr = vertex_ptr(*v);
+    if (vptr->is_a_target() && vptr->num_entry_arcs() == 0)
+      ready.push_back(vptr);
+  }
+
+  const long cache_size = registry()->schedule_cache_size();
+  while (!ready.empty()) {
+    auto next = ready.end() - 1;
+    long min_delta = delta(*next);
+    if (static_cast<long>(live_size) + min_delta > cache_size) {
+      // on ties prefer the vertex that became ready last
+      for(auto r=ready.end() - 1; r!=ready.begin(); ) {
+        --r;
+        const long d = delta(*r);
+        if (d < min_delta) {
+          min_delta = d;
+          next = r;
+        }
+      }
+    }
+    const SafePtr<DGVertex> v = *next;
+    ready.erase(next);
+    process(v);
+  }
+}
+
 void
 DirectedGraph::schedule_computation(const SafePtr<DGVertex>& vertex)
 {
@@ -432,13 +578,18 @@ DirectedGraph::print_to_dot(bool symbols, std::ostream& os) const
 void
 DirectedGraph::reset()
 {
-  // Reset each vertex, releasing all arcs
+  // Release the arcs between the vertices at once, then reset each vertex
+  __release_arcs ra(this);
+  foreach(ra);
   __reset_dgvertex rv;
   foreach(rv);
   __reset_safeptr rptr;
   foreach(rptr);
 
   // if everything went OK then empty out stack_ and targets_
+#if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
+  vertex_table_.clear();
+#endif
   stack_.clear();
   targets_.clear();
   first_to_compute_.reset();
@@ -474,7 +625,7 @@ DirectedGraph::apply(const SafePtr<Strategy>& strategy,
 	child = dgchild;
 	new_vertex = false;
       }
-      SafePtr<DGArc> arc(new DGArcRel<RecurrenceRelation>(target,child,rr0));
+      SafePtr<DGArc> arc = make_arc< DGArcRel<RecurrenceRelation> >(target,child,rr0);
       target->add_exit_arc(arc);
       if (new_vertex)
         apply_to(child,strategy,tactic);
@@ -505,7 +656,7 @@ DirectedGraph::apply_to(const SafePtr<DGVertex>& vertex,
       child = dgchild;
       new_vertex = false;
     }
-    SafePtr<DGArc> arc(new DGArcRel<RecurrenceRelation>(target,child,rr0));
+    SafePtr<DGArc> arc = make_arc< DGArcRel<RecurrenceRelation> >(target,child,rr0);
     try {
       target->add_exit_arc(arc);
     }
@@ -564,7 +715,7 @@ DirectedGraph::replace_rr_with_expr()
         SafePtr<RecurrenceRelation::ExprType> rr_expr = rr->rr_expr();
         SafePtr<DGVertex> expr_vertex = static_pointer_cast<RecurrenceRelation::ExprType,DGVertex>(rr_expr);
         expr_vertex = insert_expr_at((vptr),rr_expr);
-        SafePtr<DGArc> arc(new DGArcDirect((vptr),expr_vertex));
+        SafePtr<DGArc> arc = make_arc<DGArcDirect>((vptr),expr_vertex);
         (vptr)->add_exit_arc(arc);
 
       }
@@ -680,9 +831,9 @@ DirectedGraph::insert_expr_at(const SafePtr<DGVertex>& where, const SafePtr<Recu
     }
     expr_vertex = dgexpr_vertex;
   }
-  SafePtr<DGArc> left_arc(new DGArcDirect(expr_vertex,left_oper));
+  SafePtr<DGArc> left_arc = make_arc<DGArcDirect>(expr_vertex,left_oper);
   expr_vertex->add_exit_arc(left_arc);
-  SafePtr<DGArc> right_arc(new DGArcDirect(expr_vertex,right_oper));
+  SafePtr<DGArc> right_arc = make_arc<DGArcDirect>(expr_vertex,right_oper);
   expr_vertex->add_exit_arc(right_arc);
 #if DEBUG
   cout << "insert_expr_at: added arc between " << where->description() << " and " << expr_vertex->description() << endl;
@@ -794,6 +945,18 @@ namespace {
     } // end of while
     return symb;
   }
+
+  /// Returns true if a statement that assigns to symbol 'target' can be written with explicit SIMD kernels,
+  /// i.e. the target is a line and the arguments are lines or scalars, rather than condensed expressions
+  inline bool is_simd_statement(const std::string& target, const std::vector<std::string>& args)
+  {
+    if (target.find('[') == std::string::npos || target.find(' ') != std::string::npos)
+      return false;
+    for(std::vector<std::string>::const_iterator a=args.begin(); a!=args.end(); ++a)
+      if (a->find(' ') != std::string::npos)
+        return false;
+    return true;
+  }
 };
 
 //
@@ -921,7 +1084,7 @@ DirectedGraph::remove_vertex_at(const SafePtr<DGVertex>& v1, const SafePtr<DGVer
     cout << "remove_vertex_at: replacing arc " << c << " connecting " << parent->description() << " to " << (*i)->dest()->description() << endl;
     cout << "remove_vertex_at: replacing arc " << c << " connecting " << parent << " to " << (*i)->dest() << endl;
 #endif
-    SafePtr<DGArcDirect> new_arc(new DGArcDirect(parent,v2));
+    SafePtr<DGArcDirect> new_arc = make_arc<DGArcDirect>(parent,v2);
 #if DEBUG || DEBUG_RESTRUCTURE
     cout << "remove_vertex_at:      with arc " << " connecting " << parent->description() << " to " << v2->description() << endl;
     cout << "remove_vertex_at:      with arc " << " connecting " << parent << " to " << v2 << endl;
@@ -1207,6 +1370,16 @@ unsigned int min_size_to_alloc)
   // First, reset tag counters
   prepare_to_traverse();
 
+  // addresses assigned here may be provisional (see MemoryManager::finalize()), hence
+  // remember the vertices and accumulators whose addresses are assigned elsewhere
+  std::set<const DGVertex*> preallocated;
+  for(vertices::const_iterator v=stack_.begin(); v!=stack_.end(); ++v) {
+    const ver_ptr& vptr = vertex_ptr(*v);
+    if (!vptr->refers_to_another() && vptr->address_set())
+      preallocated.insert(vptr.get());
+  }
+  const size_t npreallocated_accums = target_accums_.size();
+
   struct TargetAllocator {
     typedef DirectedGraph::targets::const_iterator target_citer;
     typedef DirectedGraph::targets::iterator target_iter;
@@ -1403,6 +1576,16 @@ unsigned int min_size_to_alloc)
     }
     vertex = vertex->postcalc();
   }while (vertex != 0);
+
+  // all allocations are known now, replace provisional addresses with the final ones
+  memman->finalize();
+  for(vertices::iterator v=stack_.begin(); v!=stack_.end(); ++v) {
+    const ver_ptr& vptr = vertex_ptr(*v);
+    if (!vptr->refers_to_another() && vptr->address_set() && preallocated.find(vptr.get()) == preallocated.end())
+      vptr->set_address(memman->final_address(vptr->address()));
+  }
+  for(size_t a=npreallocated_accums; a<target_accums_.size(); ++a)
+    target_accums_[a] = memman->final_address(target_accums_[a]);
 }
 
 void
@@ -1726,6 +1909,8 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
   const bool vectorize = (max_vector_length != 1);
   const bool vectorize_by_line = context->cparams()->vectorize_by_line();
   const bool create_outer_vector_loop = !vectorize_by_line && !cannot_enclose_in_outer_vloop();
+  // lines can be evaluated with explicit SIMD kernels instead of the line loops
+  const bool explicit_simd = vectorize_by_line && !context->cparams()->vector_isa().empty();
   varname = "vi";
   // outer vector loop
   SafePtr<ForLoop> outer_vloop;
@@ -1750,6 +1935,7 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
   // generate code for vertices
   //
   unsigned int nflops_total = 0;
+  cost_ = CodeCost();
   SafePtr<DGVertex> current_vertex = first_to_compute_;
   do {
 
@@ -1819,7 +2005,12 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
           SafePtr<oper_type> parent_oper_ptr;
           SafePtr<DGVertex> fma_other_arg;
 #if LIBINT_GENERATE_FMA
-          {
+          const bool detect_fma = true;
+#else
+          // explicit SIMD kernels fuse multiply-add even if FMA instructions are not generated otherwise
+          const bool detect_fma = explicit_simd;
+#endif
+          if (detect_fma) {
             if (oper_ptr->type() == algebra::OperatorTypes::Times &&
                 oper_ptr->num_entry_arcs() == 1) {
               parent_oper_ptr =
@@ -1882,7 +2073,6 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
               }
             }
           }
-#endif // LIBINT_GENERATE_FMA=1
 
           // convert symbols to their vector form if needed
           std::string curr_symbol = current_vertex->symbol();
@@ -1890,7 +2080,14 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
           std::string right_symbol = right_arg->symbol();
           std::string parent_symbol = generate_fma ? parent_oper_ptr->symbol() : "";
           std::string fma_other_arg_symbol = generate_fma ? fma_other_arg->symbol() : "";
-          if (vectorize) {
+          std::vector<std::string> simd_args;
+          simd_args.push_back(left_symbol);
+          simd_args.push_back(right_symbol);
+          if (generate_fma)
+            simd_args.push_back(fma_other_arg_symbol);
+          const bool simd_statement = explicit_simd &&
+              is_simd_statement(generate_fma ? parent_symbol : curr_symbol, simd_args);
+          if (vectorize && !simd_statement) {
             curr_symbol = to_vector_symbol(current_vertex);
             left_symbol = to_vector_symbol(left_arg);
             right_symbol = to_vector_symbol(right_arg);
@@ -1911,11 +2108,17 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
           }
 #endif
 
-          if (vectorize_by_line)
+          if (vectorize_by_line && !simd_statement)
             os << line_vloop->open();
           // the statement that does the work
           {
-            if (accumulate_not_assign) {
+            if (simd_statement) {
+              os << context->simd_line_expr(generate_fma ? parent_symbol : curr_symbol, simd_args,
+                                            oper_ptr->label(), generate_fma ? parent_oper_ptr->label() : "",
+                                            accumulate_not_assign);
+              nflops_total += (generate_fma ? 1 : 0) + (accumulate_not_assign ? 1 : 0);
+            }
+            else if (accumulate_not_assign) {
 
               if (generate_fma) {
                 os << context->accumulate_ternary_expr(parent_symbol,
@@ -1955,7 +2158,7 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
 
             nflops_total += (1 + nflops(left_symbol) + nflops(right_symbol));
           }
-          if (vectorize_by_line)
+          if (vectorize_by_line && !simd_statement)
             os << line_vloop->close();
 
           // if produced FMA, do not forget to mark the parent scheduled
@@ -2003,21 +2206,27 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
           // convert symbols to their vector form if needed
           std::string curr_symbol = current_vertex->symbol();
           std::string rhs_symbol = arc_ptr->dest()->symbol();
-          if (vectorize) {
+          const std::vector<std::string> simd_args(1, rhs_symbol);
+          const bool simd_statement = explicit_simd && is_simd_statement(curr_symbol, simd_args);
+          if (vectorize && !simd_statement) {
             curr_symbol = to_vector_symbol(current_vertex);
             rhs_symbol = to_vector_symbol(arc_ptr->dest());
           }
 
-          if (vectorize_by_line)
+          if (vectorize_by_line && !simd_statement)
             os << line_vloop->open();
-          if (accumulate_not_assign) {
+          if (simd_statement) {
+            os << context->simd_line_expr(curr_symbol, simd_args, "", "", accumulate_not_assign);
+            nflops_total += nflops(rhs_symbol) + (accumulate_not_assign ? 1 : 0);
+          }
+          else if (accumulate_not_assign) {
             os << context->accumulate(curr_symbol, rhs_symbol);
             nflops_total += nflops(rhs_symbol) + 1; // +1 due to +=
           } else {
             os << context->assign(curr_symbol, rhs_symbol);
             nflops_total += nflops(rhs_symbol);
           }
-          if (vectorize_by_line)
+          if (vectorize_by_line && !simd_statement)
             os << line_vloop->close();
 
           goto next;
@@ -2037,6 +2246,7 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
           SafePtr<RecurrenceRelation> rr = arc_ptr->rr();
           os << rr->spfunction_call(context, dims);
           nflops_total += rr->nflops();
+          cost_.calls[context->cparams()->api_prefix() + rr->label()] += rr->spfunction_call_multiplicity();
 
           goto next;
         }
@@ -2162,6 +2372,7 @@ DirectedGraph::print_def(const SafePtr<CodeContext>& context, std::ostream& os,
   }
 
   // Print out the number of flops
+  cost_.nflops = nflops_total;
   oss.str(null_str);
   oss << "Number of flops = " << nflops_total;
   os << context->comment(oss.str()) << endl;
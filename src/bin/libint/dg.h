@@ -25,6 +25,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <deque>
 #include <algorithm>
@@ -36,6 +37,8 @@
 #include <smart_ptr.h>
 #include <key.h>
 #include <dgvertex.h>
+#include <pool.h>
+#include <cost.h>
 
 namespace libint2 {
 
@@ -67,7 +70,8 @@ namespace libint2 {
     typedef SafePtr<DGVertex> ver_ptr;
     typedef SafePtr<DGArc> arc_ptr;
     typedef DGVertexKey key_type;
-    typedef std::multimap<key_type,ver_ptr> VPtrAssociativeContainer;
+    typedef std::multimap<key_type,ver_ptr,std::less<key_type>,
+                          PoolAllocator<std::pair<const key_type,ver_ptr> > > VPtrAssociativeContainer;
     typedef std::list<ver_ptr> VPtrSequenceContainer;
 
     typedef VPtrSequenceContainer targets;
@@ -75,6 +79,13 @@ namespace libint2 {
     typedef VPtrAssociativeContainer vertices;
 #else
     typedef VPtrSequenceContainer vertices;
+#endif
+#if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
+    /// hash of a vertex, equivalent vertices have equal hashes
+    typedef LIBINT2_UINT_LEAST64 hash_type;
+    /// finds vertices on the graph by hash, refers to the container of vertices
+    typedef std::unordered_multimap<hash_type,VPtrAssociativeContainer::iterator,std::hash<hash_type>,std::equal_to<hash_type>,
+                                    PoolAllocator<std::pair<const hash_type,VPtrAssociativeContainer::iterator> > > VPtrHashTable;
 #endif
     typedef targets::iterator target_iter;
     typedef targets::const_iterator target_citer;
@@ -175,7 +186,7 @@ namespace libint2 {
         for(int c=0; c<num_children; c++) {
 
           SafePtr<DGVertex> child = rr0->child(c);
-          SafePtr<DGArc> arc(new DGArcRel<RR>(tptr,child,rr0));
+          SafePtr<DGArc> arc = make_arc< DGArcRel<RR> >(tptr,child,rr0);
           tptr->add_exit_arc(arc);
 
           recurse<RR>(child);
@@ -257,6 +268,7 @@ namespace libint2 {
 
     /** after all apply's have been called, traverse()
         construct a heuristic order of traversal for the graph.
+        The algorithm is selected by GraphRegistry::schedule().
      */
     void traverse();
 
@@ -322,10 +334,18 @@ namespace libint2 {
     /// return true if there are vertices with 0 children but not pre-computed
     bool missing_prerequisites() const;
 
+    /// returns the cost of the code produced by the last call to generate_code()
+    const CodeCost& cost() const { return cost_; }
+
   private:
 
     /// contains vertices
     vertices stack_;
+#if USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
+    /** the hash table of vertices on stack_, used by vertex_is_on(). The key of stack_ is not unique for some vertices
+        (e.g. it is the same for all AlgebraicOperators), which made finding them on the graph require a linear search */
+    VPtrHashTable vertex_table_;
+#endif
     /// refers to targets, cannot be an associative container -- order of iteration over targets is important
     targets targets_;
     /// addresses of blocks which accumulate targets
@@ -340,6 +360,9 @@ namespace libint2 {
      */
     FuncNameContainer func_names_;
 
+    /// cost of the code produced by print_def()
+    CodeCost cost_;
+
 #if !USE_ASSOCCONTAINER_BASED_DIRECTEDGRAPH
     static const unsigned int default_size_ = 100;
 #endif
@@ -376,7 +399,7 @@ namespace libint2 {
       for(int c=0; c<num_children; c++) {
 
         SafePtr<DGVertex> child = rr0->child(c);
-        SafePtr<DGArc> arc(new DGArcRel<RR>(vertex,child,rr0));
+        SafePtr<DGArc> arc = make_arc< DGArcRel<RR> >(vertex,child,rr0);
         vertex->add_exit_arc(arc);
 
         SafePtr<I> child_cast = dynamic_pointer_cast<I,DGVertex>(child);
@@ -406,7 +429,7 @@ namespace libint2 {
       for(int c=0; c<num_children; c++) {
 
         SafePtr<DGVertex> child = rr0->child(c);
-        SafePtr<DGArc> arc(new DGArcRel<RR>(vertex,child,rr0));
+        SafePtr<DGArc> arc = make_arc< DGArcRel<RR> >(vertex,child,rr0);
         vertex->add_exit_arc(arc);
 
         recurse<RR>(child);
@@ -450,6 +473,8 @@ namespace libint2 {
     void prepare_to_traverse();
     // traverse_from(arc) build recurively the traversal order
     void traverse_from(const SafePtr<DGArc>&);
+    // builds the traversal order by list scheduling that minimizes the working set
+    void traverse_min_working_set();
     // schedule_computation(vertex) puts vertex first in the computation order
     void schedule_computation(const SafePtr<DGVertex>&);
 
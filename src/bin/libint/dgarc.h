@@ -20,7 +20,9 @@
 
 //#include <rr.h>
 #include <iostream>
+#include <utility>
 #include <smart_ptr.h>
+#include <pool.h>
 
 #ifndef _libint2_src_bin_libint_dgarc_h_
 #define _libint2_src_bin_libint_dgarc_h_
@@ -40,8 +42,8 @@ namespace libint2 {
     DGArc(const SafePtr<DGVertex>& orig, const SafePtr<DGVertex>& dest);
     virtual ~DGArc() {}
 
-    SafePtr<DGVertex> orig() const { return orig_; }
-    SafePtr<DGVertex> dest() const { return dest_; }
+    const SafePtr<DGVertex>& orig() const { return orig_; }
+    const SafePtr<DGVertex>& dest() const { return dest_; }
 
     /// Print out the arc
     virtual void print(std::ostream& os) const =0;
@@ -113,6 +115,13 @@ namespace libint2 {
     {
     };
 
+  /// creates an arc of type Arc, allocated along with its reference count from a pool (see PoolAllocator)
+  template <class Arc, class... Args>
+    SafePtr<Arc> make_arc(Args&&... args)
+    {
+      return allocate_SafePtr<Arc>(PoolAllocator<Arc>(), std::forward<Args>(args)...);
+    }
+
 };
 
 #endif
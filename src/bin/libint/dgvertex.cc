@@ -28,13 +28,18 @@ using namespace libint2;
 
 #define LOCAL_DEBUG 0
 
+namespace {
+  /// children_ of vertices with at least this many exit arcs are indexed
+  const size_t children_index_threshold = 16;
+}
+
 DGVertex::DGVertex(ClassID tid) :
   typeid_(tid), instid_(), dg_(0), graph_label_(), referred_vertex_(0),
   refs_(), symbol_(), address_(MemoryManager::InvalidAddress), need_to_compute_(true),
 #if CHECK_SAFETY
   declared_(false),
 #endif
-  parents_(), children_(), target_(false), can_add_arcs_(true), num_tagged_arcs_(0),
+  parents_(), children_(), children_index_(), target_(false), can_add_arcs_(true), num_tagged_arcs_(0),
   postcalc_(), scheduled_(false), subtree_(SafePtr<DRTree>())
 {
 }
@@ -45,7 +50,7 @@ DGVertex::DGVertex(const DGVertex& v) :
 #if CHECK_SAFETY
   declared_(v.declared_),
 #endif
-  parents_(v.parents_), children_(v.children_), target_(v.target_),
+  parents_(v.parents_), children_(v.children_), children_index_(v.children_index_), target_(v.target_),
   can_add_arcs_(v.can_add_arcs_), num_tagged_arcs_(v.num_tagged_arcs_),
   postcalc_(v.postcalc_), scheduled_(false), subtree_(v.subtree_)
 {
@@ -65,10 +70,15 @@ void
 DGVertex::add_exit_arc(const SafePtr<DGArc>& arc)
 {
   if (can_add_arcs_) {
-    SafePtr<DGVertex> child = arc->dest();
+    const SafePtr<DGVertex>& child = arc->dest();
 
     // check if such arc exists already
-    if (!children_.empty()) {
+    if (!children_index_.empty()) {
+      if (children_index_.find(child.get()) != children_index_.end())
+        return;
+      children_index_.insert(child.get());
+    }
+    else if (!children_.empty()) {
       typedef ArcSetType::const_iterator aciter;
       const aciter abegin = children_.begin();
       const aciter aend = children_.end();
@@ -76,6 +86,12 @@ DGVertex::add_exit_arc(const SafePtr<DGArc>& arc)
 	if ((*a)->dest() == child)
 	  return;
       }
+      // this vertex has many children, from now on look them up in the index
+      if (children_.size() + 1 >= children_index_threshold) {
+        for(aciter a=abegin; a!=aend; ++a)
+          children_index_.insert((*a)->dest().get());
+        children_index_.insert(child.get());
+      }
     }
 
     children_.push_back(arc);
@@ -99,6 +115,8 @@ DGVertex::del_exit_arc(const SafePtr<DGArc>& arc)
 #if DEBUG
     std::cout << "del_exit_arc: removed arc from " << arc->orig()->description() << " to " << arc->dest()->description() << std::endl;
 #endif
+        if (!children_index_.empty())
+          children_index_.erase(children_index_.find(arc->dest().get()));
         children_.erase(pos);
       }
       else
@@ -156,6 +174,10 @@ DGVertex::replace_exit_arc(const SafePtr<DGArc>& A, const SafePtr<DGArc>& B)
 #endif
       aiter posA = find(begin,end,A);
       if (posA != end) {
+        if (!children_index_.empty()) {
+          children_index_.erase(children_index_.find(A->dest().get()));
+          children_index_.insert(B->dest().get());
+        }
         *posA = B;
         A->dest()->del_entry_arc(A);
         B->dest()->add_entry_arc(B);
@@ -284,6 +306,7 @@ DGVertex::reset()
     (*a).reset();
   }
   children_.clear();
+  children_index_.clear();
 
   target_ = false;
   can_add_arcs_ = true;
@@ -297,6 +320,23 @@ DGVertex::reset()
   refs_.resize(0);
 }
 
+void
+DGVertex::release_arcs(const DirectedGraph* dg)
+{
+  // arcs to vertices that are not on dg are removed from their destinations
+  typedef ArcSetType::const_iterator citer;
+  const citer end = children_.end();
+  for(citer a=children_.begin(); a!=end; ++a) {
+    if ((*a)->dest()->dg() != dg)
+      (*a)->dest()->del_entry_arc(*a);
+  }
+  children_.clear();
+  children_index_.clear();
+
+  // arcs from the vertices of dg are released by their origins
+  parents_.remove_if([dg](const SafePtr<DGArc>& a) { return a->orig()->dg() == dg; });
+}
+
 const std::string&
 DGVertex::graph_label() const
 {
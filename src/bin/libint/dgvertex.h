@@ -22,11 +22,13 @@
 #define _libint2_src_bin_libint_dgvertex_h_
 
 #include <list>
+#include <unordered_set>
 #include <vector>
 //#include <dg.h>
 #include <global_macros.h>
 #include <drtree.h>
 #include <dgarc.h>
+#include <pool.h>
 #include <iostream>
 #include <string>
 #include <smart_ptr.h>
@@ -61,7 +63,7 @@ namespace libint2 {
     typedef KeyTypes::InstanceID KeyType;
     typedef Hashable<KeyType,ComputeKey>::KeyReturnType KeyReturnType;
     /// ArcSetType is a container used to maintain entry and exit arcs
-    typedef std::list< SafePtr<DGArc> > ArcSetType;
+    typedef std::list< SafePtr<DGArc>, PoolAllocator< SafePtr<DGArc> > > ArcSetType;
 
     /** typeid stores the ClassID of the concrete type. It is used to check quickly whether
         2 DGVertices are of the same type. Dynamic casts are too expensive. */
@@ -214,6 +216,11 @@ namespace libint2 {
 
     /// Resets the vertex, releasing all arcs
     void reset();
+    /** Releases the arcs between this vertex and the other vertices of graph dg. DirectedGraph::reset() calls this
+        for all of its vertices before resetting them, which is much cheaper than releasing the arcs one by one
+        (each exit arc must be found among the entry arcs of its destination).
+      */
+    void release_arcs(const DirectedGraph* dg);
     /// If vertex is a singleton then remove it from the SingletonManager. Must be reimplemented in derived singleton class
     virtual void unregister() const;
 
@@ -256,6 +263,10 @@ namespace libint2 {
     ArcSetType parents_;
     /// Arcs leaving this DGVertex. Derived classes may need direct access to exit arcs.
     ArcSetType children_;
+    /** Destinations of children_, only maintained for vertices with many exit arcs
+        (e.g. unrolled integral sets) so that add_exit_arc() does not have to search children_ */
+    std::unordered_multiset<const DGVertex*, std::hash<const DGVertex*>, std::equal_to<const DGVertex*>,
+                            PoolAllocator<const DGVertex*> > children_index_;
 
     // Whether this is a "target" vertex, i.e. the target of a calculation
     bool target_;
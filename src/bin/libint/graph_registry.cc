@@ -24,7 +24,8 @@ using namespace libint2;
 
 GraphRegistry::GraphRegistry() :
   accumulate_targets_(false), return_targets_(true), unroll_threshold_(0), uncontract_(false), ignore_missing_prereqs_(false),
-  do_cse_(false), condense_expr_(false), stack_name_("inteval->stack"), current_timer_(-1)
+  do_cse_(false), condense_expr_(false), stack_name_("inteval->stack"), current_timer_(-1),
+  schedule_(Schedule::DepthFirst), schedule_cache_size_(4096)
 {
 }
 
@@ -70,6 +70,17 @@ namespace libint2 {
     /// if -1, no profiling, otherwise, indicates the current timer
     int current_timer() const { return current_timer_; }
     void current_timer(int ct) { current_timer_ = ct; }
+    /// Algorithms that schedule the computation (see DirectedGraph::traverse())
+    enum class Schedule {
+      DepthFirst,    //!< depth-first traversal that computes the children with fewer parents last
+      MinWorkingSet  //!< list scheduling that keeps the working set within schedule_cache_size()
+    };
+    /// How to schedule the computation? The default is DepthFirst.
+    Schedule schedule() const { return schedule_; }
+    void schedule(Schedule s) { schedule_ = s; }
+    /// The working set size (in stack elements) that Schedule::MinWorkingSet tries not to exceed. The default is 4096.
+    unsigned int schedule_cache_size() const { return schedule_cache_size_; }
+    void schedule_cache_size(unsigned int scs) { schedule_cache_size_ = scs; }
     
     private:
     bool accumulate_targets_;
@@ -81,6 +92,8 @@ namespace libint2 {
     bool condense_expr_;
     std::string stack_name_;
     int current_timer_;
+    Schedule schedule_;
+    unsigned int schedule_cache_size_;
   };
   
   /**
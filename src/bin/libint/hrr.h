@@ -112,6 +112,8 @@ namespace libint2 {
       /// Implementation of RecurrenceRelation::spfunction_call()
       std::string spfunction_call(const SafePtr<CodeContext>& context,
           const SafePtr<ImplicitDimensions>& dims) const;
+      /// Implementation of RecurrenceRelation::spfunction_call_multiplicity()
+      unsigned int spfunction_call_multiplicity() const;
 
       private:
       /**
@@ -141,6 +143,8 @@ namespace libint2 {
        */
       bool expl_high_dim() const;
       bool expl_low_dim() const;
+      /// computes the ranks of the high (hsr) and low (lsr) dimensions of the target
+      void call_dims_(unsigned int& hsr, unsigned int& lsr) const;
     };
 
     template <class IntType, class F, int part,
@@ -564,7 +568,43 @@ namespace libint2 {
           os << ", " << context->value_to_pointer(rr_child(c)->symbol());
         }
         // then dimensions of basis function sets not involved in the transfer
-        unsigned int hsr = 1;
+        unsigned int hsr, lsr;
+        call_dims_(hsr, lsr);
+        // Use TaskParameters to keep track of maximum hsr
+        LibraryTaskManager& taskmgr = LibraryTaskManager::Instance();
+        taskmgr.current().params()->max_hrr_hsrank(hsr);
+
+        // can only do a simple bra->ket or ket->bra transfer so far
+        //unsigned int isr = 1;
+        if (loc_a == loc_b && pos_a != 0 && pos_b != 0)
+          throw CodeDoesNotExist("HRR::spfunction_call -- has not been generalized yet");
+
+        if (expl_high_dim())
+          os << "," << hsr;
+        if (expl_low_dim())
+          os << "," << lsr;
+        os << ")" << context->end_of_stat() << endl;
+        return os.str();
+        }
+
+    template <class IntType, class F, int part,
+    FunctionPosition loc_a, unsigned int pos_a,
+    FunctionPosition loc_b, unsigned int pos_b>
+    unsigned int
+    HRR<IntType,F,part,loc_a,pos_a,loc_b,pos_b>::spfunction_call_multiplicity() const
+        {
+        unsigned int hsr, lsr;
+        call_dims_(hsr, lsr);
+        return (expl_high_dim() ? hsr : 1) * (expl_low_dim() ? lsr : 1);
+        }
+
+    template <class IntType, class F, int part,
+    FunctionPosition loc_a, unsigned int pos_a,
+    FunctionPosition loc_b, unsigned int pos_b>
+    void
+    HRR<IntType,F,part,loc_a,pos_a,loc_b,pos_b>::call_dims_(unsigned int& hsr, unsigned int& lsr) const
+        {
+        hsr = 1;
         // a cleaner way to count the number of function sets referring
         // to some particles is to construct a dummy integral and
         // use subiterator policy
@@ -583,17 +623,9 @@ namespace libint2 {
             delete iter;
           }
         }
-        // Use TaskParameters to keep track of maximum hsr
-        LibraryTaskManager& taskmgr = LibraryTaskManager::Instance();
-        taskmgr.current().params()->max_hrr_hsrank(hsr);
-
-        // can only do a simple bra->ket or ket->bra transfer so far
-        //unsigned int isr = 1;
-        if (loc_a == loc_b && pos_a != 0 && pos_b != 0)
-          throw CodeDoesNotExist("HRR::spfunction_call -- has not been generalized yet");
 
         /// WARNING !!!
-        unsigned int lsr = 1;
+        lsr = 1;
         unsigned int np = IntType::OperType::Properties::np;
         for(unsigned int p=part+1; p<np; p++) {
           unsigned int nbra = target_->bra().num_members(p);
@@ -609,15 +641,6 @@ namespace libint2 {
             delete iter;
           }
         }
-        // Use TaskParameters to keep track of maximum hsr
-        taskmgr.current().params()->max_hrr_hsrank(hsr);
-
-        if (expl_high_dim())
-          os << "," << hsr;
-        if (expl_low_dim())
-          os << "," << lsr;
-        os << ")" << context->end_of_stat() << endl;
-        return os.str();
         }
 
     template <class IntType, class F, int part,
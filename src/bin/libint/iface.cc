@@ -93,6 +93,18 @@ Libint2Iface::Libint2Iface(const SafePtr<CompilationParameters>& cparams,
   ih_ << "#ifdef __cplusplus\n# include <cstddef>\n#else\n# include <stddef.h>\n#endif" << endl
       << ctext_->code_prefix();
 
+  // the type of the entries of libint2_cost_<task>; several libraries (with different API prefixes) may share it
+  ih_ << "#ifndef LIBINT2_CLASSCOST_DEFINED" << endl
+      << "#define LIBINT2_CLASSCOST_DEFINED" << endl
+      << "/* cost of evaluating a shell set of one class of integrals; all members are 0 if not known */" << endl
+      << "typedef struct {" << endl
+      << "  unsigned long nflops_shellset;   /* flops executed once per shell set, e.g. by HRR */" << endl
+      << "  unsigned long nflops_primitive;  /* flops executed once per primitive combination, e.g. by VRR */" << endl
+      << "  unsigned int stack_size;         /* the number of LIBINT2_REALTYPE elements of the stack used */" << endl
+      << "  unsigned int target_size;        /* the number of integrals in the targets */" << endl
+      << "} Libint2_ClassCost;" << endl
+      << "#endif" << endl;
+
   oss_.str(null_str_);
   oss_ << ctext_->std_header() << "#include <" << ih_name << ">" << endl
                                << "#include <" << ii_name << ">" << endl
@@ -122,6 +134,17 @@ Libint2Iface::Libint2Iface(const SafePtr<CompilationParameters>& cparams,
     oss << ")(" << ctext_->const_modifier() << ctext_->inteval_type_name(tlabel) << "*);" << endl;
     ih_ << "extern " << oss.str();
     si_ << oss.str();
+
+    // the table of the cost of each class, indexed like the array of evaluator functions
+    oss.str(null_str_);
+    oss << "Libint2_ClassCost " << ctext->label_to_name(cparams->api_prefix()) << "libint2_cost_" << tlabel;
+    for(unsigned int c=0; c<nbf; ++c) {
+      const unsigned int lmax = const_cast<const CompilationParameters*>(cparams_.get())->max_am(tlabel, c);
+      oss << "[" << lmax+1 << "]";
+    }
+    oss << ";" << endl;
+    ih_ << "extern " << oss.str();
+    si_ << oss.str();
   }
   
   // Declare library constructor/destructor
@@ -27,6 +27,7 @@
 #include <default_params.h>
 #include <context.h>
 #include <task.h>
+#include <cache.h>
 
 using namespace std;
 
@@ -118,7 +119,8 @@ namespace libint2 {
 
       std::string lf_decl_;   // _init_flopcounter
 
-      typedef std::basic_ofstream<char> fstream;
+      // the files are rewritten only if their contents change, hence unchanged files need not be recompiled
+      typedef GeneratedFile fstream;
       
       fstream th_;
       fstream ph_;
@@ -495,6 +495,193 @@ LastFitMemoryManager::alloc(const Size& size)
 
 }
 
+///////////////
+
+LivenessMemoryManager::LivenessMemoryManager(const Size& maxsize) :
+  MemoryManager(maxsize), next_address_(0), finalized_(false), max_memory_used_(0)
+{
+}
+
+LivenessMemoryManager::~LivenessMemoryManager()
+{
+}
+
+MemoryManager::Address
+LivenessMemoryManager::alloc(const Size& size)
+{
+  if (size == 0)
+    throw std::runtime_error("LivenessMemoryManager::alloc(size) -- size is 0");
+  if (finalized_)
+    throw std::runtime_error("LivenessMemoryManager::alloc() -- called after finalize(), must reset() first");
+
+  const size_t b = blocks_.size();
+  Block blk;
+  blk.address = next_address_;
+  blk.size = size;
+  blk.start = events_.size();
+  blk.end = never;
+  blocks_.push_back(blk);
+  block_index_[next_address_] = b;
+  events_.push_back(b);
+  next_address_ += size;
+  return blk.address;
+}
+
+void
+LivenessMemoryManager::free(const Address& address)
+{
+  std::map<Address,size_t>::const_iterator b = block_index_.find(address);
+  if (b == block_index_.end())
+    throw std::runtime_error("LivenessMemoryManager::free() -- didn't find a block at this address");
+  Block& blk = blocks_[b->second];
+  if (blk.end != never)
+    throw std::runtime_error("LivenessMemoryManager::free() tried to free a free block");
+  blk.end = events_.size();
+  events_.push_back(~static_cast<long>(b->second));
+}
+
+void
+LivenessMemoryManager::finalize()
+{
+  if (finalized_)
+    return;
+  finalized_ = true;
+
+  Size peak = pack(final_addresses_);
+
+  // compare to the other MemoryManagers, the last type produced by the factory is LivenessMemoryManager
+  MemoryManagerFactory factory;
+  report_.online_peaks.resize(MemoryManagerFactory::ntypes - 1, 0);
+  for(unsigned int t=0; t!=MemoryManagerFactory::ntypes - 1; ++t) {
+    std::vector<Address> addresses;
+    const Size online_peak = replay(factory.memman(t), addresses);
+    report_.online_peaks[t] = std::max(report_.online_peaks[t], online_peak);
+    if (online_peak < peak) {
+      peak = online_peak;
+      final_addresses_.swap(addresses);
+    }
+  }
+
+  report_.peak = std::max(report_.peak, peak);
+  max_memory_used_ = std::max(max_memory_used_, peak);
+}
+
+MemoryManager::Address
+LivenessMemoryManager::final_address(const Address& address) const
+{
+  if (!finalized_)
+    throw std::runtime_error("LivenessMemoryManager::final_address() -- called before finalize()");
+  // find the block that contains address
+  std::map<Address,size_t>::const_iterator b = block_index_.upper_bound(address);
+  if (b == block_index_.begin())
+    throw std::runtime_error("LivenessMemoryManager::final_address() -- address is not in any block");
+  --b;
+  const Block& blk = blocks_[b->second];
+  if (address >= blk.address + static_cast<Address>(blk.size))
+    throw std::runtime_error("LivenessMemoryManager::final_address() -- address is not in any block");
+  return final_addresses_[b->second] + (address - blk.address);
+}
+
+void
+LivenessMemoryManager::reset()
+{
+  MemoryManager::reset();
+  blocks_.clear();
+  block_index_.clear();
+  events_.clear();
+  final_addresses_.clear();
+  next_address_ = 0;
+  finalized_ = false;
+}
+
+LivenessMemoryManager::Report
+LivenessMemoryManager::take_report()
+{
+  Report result;
+  std::swap(result, report_);
+  return result;
+}
+
+namespace {
+  /// the size class of a block is floor(log2(size))
+  unsigned int size_class(size_t size) {
+    unsigned int result = 0;
+    while (size >>= 1)
+      ++result;
+    return result;
+  }
+};
+
+MemoryManager::Size
+LivenessMemoryManager::pack(std::vector<Address>& addresses) const
+{
+  const size_t nblocks = blocks_.size();
+  addresses.assign(nblocks, Address(InvalidAddress));
+  Size peak = 0;
+
+  // blocks allocated before the first free keep their addresses
+  std::vector<size_t> placed;
+  std::vector<size_t> unplaced;
+  bool freed = false;
+  for(std::vector<long>::const_iterator e=events_.begin(); e!=events_.end(); ++e) {
+    if (*e < 0) {
+      freed = true;
+      continue;
+    }
+    const Block& blk = blocks_[*e];
+    if (!freed) {
+      addresses[*e] = blk.address;
+      peak = std::max(peak, static_cast<Size>(blk.address) + blk.size);
+      placed.push_back(*e);
+    }
+    else
+      unplaced.push_back(*e);
+  }
+
+  std::stable_sort(unplaced.begin(), unplaced.end(), [this](size_t i, size_t j) {
+    const unsigned int ci = size_class(blocks_[i].size);
+    const unsigned int cj = size_class(blocks_[j].size);
+    return ci > cj || (ci == cj && blocks_[i].start < blocks_[j].start);
+  });
+
+  // place each block at the lowest address that does not conflict with the placed blocks whose live ranges overlap
+  std::vector< std::pair<Address,Address> > busy; // [begin,end) address ranges
+  for(std::vector<size_t>::const_iterator b=unplaced.begin(); b!=unplaced.end(); ++b) {
+    const Block& blk = blocks_[*b];
+    busy.resize(0);
+    for(std::vector<size_t>::const_iterator p=placed.begin(); p!=placed.end(); ++p) {
+      const Block& pblk = blocks_[*p];
+      if (pblk.start < blk.end && blk.start < pblk.end)
+        busy.push_back(std::make_pair(addresses[*p], addresses[*p] + static_cast<Address>(pblk.size)));
+    }
+    std::sort(busy.begin(), busy.end());
+    Address address = 0;
+    for(std::vector< std::pair<Address,Address> >::const_iterator r=busy.begin(); r!=busy.end(); ++r) {
+      if (r->first >= address + static_cast<Address>(blk.size))
+        break;
+      address = std::max(address, r->second);
+    }
+    addresses[*b] = address;
+    peak = std::max(peak, static_cast<Size>(address) + blk.size);
+    placed.push_back(*b);
+  }
+
+  return peak;
+}
+
+MemoryManager::Size
+LivenessMemoryManager::replay(const SafePtr<MemoryManager>& memman, std::vector<Address>& addresses) const
+{
+  addresses.assign(blocks_.size(), Address(InvalidAddress));
+  for(std::vector<long>::const_iterator e=events_.begin(); e!=events_.end(); ++e) {
+    if (*e >= 0)
+      addresses[*e] = memman->alloc(blocks_[*e].size);
+    else
+      memman->free(addresses[~*e]);
+  }
+  return memman->max_memory_used();
+}
+
 //////////////
 
 SafePtr<MemoryManager>
@@ -541,6 +728,11 @@ MemoryManagerFactory::memman(unsigned int type) const
       SafePtr<MemoryManager> result(new LastFitMemoryManager(false));
       return result;
     }
+  case 8:
+    {
+      SafePtr<MemoryManager> result(new LivenessMemoryManager());
+      return result;
+    }
   default:
     throw std::runtime_error("MemoryManagerFactory::memman(type) -- invalid type");
   }
@@ -555,7 +747,8 @@ namespace MMTypes {
       "FirstFitMemoryManager(true)",
       "FirstFitMemoryManager(false)",
       "LastFitMemoryManager(true)",
-      "LastFitMemoryManager(false)"
+      "LastFitMemoryManager(false)",
+      "LivenessMemoryManager"
       };
 
 };
@@ -20,6 +20,9 @@
 
 #include <limits.h>
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 #include <smart_ptr.h>
 
 #ifndef _libint2_src_bin_libint_memory_h_
@@ -179,10 +182,17 @@ namespace libint2 {
     /// Release a block previously reserved using alloc
     virtual void free(const Address& address);
     /// Returns the max amount of memory used up to this moment
-    Size max_memory_used() const { return max_memory_used_; }
+    virtual Size max_memory_used() const { return max_memory_used_; }
+
+    /** Called once all blocks of a computation have been allocated (and possibly released).
+        MemoryManagers that assign addresses in alloc() do nothing here. */
+    virtual void finalize() {}
+    /** Returns the final address of the location at \c address , which is either an address returned by alloc()
+        or an address inside such block. Only valid after finalize(); the default is the identity. */
+    virtual Address final_address(const Address& address) const { return address; }
 
     /// resets the state of MemoryManager; does not invalidate stats, however
-    void reset();
+    virtual void reset();
 
   protected:
     MemoryManager(const Size& maxmem);
@@ -273,12 +283,84 @@ namespace libint2 {
     bool search_exact_;
   };
 
+  /**
+     LivenessMemoryManager assigns addresses after the entire computation has been scheduled.
+     alloc() and free() only record the live range of each block (blocks that are not
+     released live until the end of the computation) and return provisional addresses;
+     finalize() computes the final addresses. Blocks allocated before the first free() keep their
+     provisional (consecutive) addresses, like with any other MemoryManager, since the layout of targets
+     and prerequisites must agree between a graph and its prerequisite graph. The remaining blocks are
+     placed in order of decreasing size class (powers of 2), and by the start of their live range within a class,
+     at the lowest address that does not overlap a block that is simultaneously live.
+     The same sequence of alloc() and free() is also replayed through each type of MemoryManager
+     produced by MemoryManagerFactory, and the layout with the smallest peak is used, hence the stack
+     is never larger than with any of the other MemoryManagers.
+  */
+  class LivenessMemoryManager : public MemoryManager {
+  public:
+    /// The peak memory of the computations finalized since the last call to take_report()
+    struct Report {
+      /// peak memory of the layout used by this object
+      Size peak;
+      /// peak memory of each type of MemoryManager produced by MemoryManagerFactory
+      std::vector<Size> online_peaks;
+      Report() : peak(0) {}
+    };
+
+    LivenessMemoryManager(const Size& maxsize = ULONG_MAX);
+    virtual ~LivenessMemoryManager();
+
+    /// Implementation of MemoryManager::alloc()
+    Address alloc(const Size& size);
+    /// Overload of MemoryManager::free()
+    void free(const Address& address);
+    /// Overload of MemoryManager::max_memory_used()
+    Size max_memory_used() const { return max_memory_used_; }
+    /// Overload of MemoryManager::finalize()
+    void finalize();
+    /// Overload of MemoryManager::final_address()
+    Address final_address(const Address& address) const;
+    /// Overload of MemoryManager::reset()
+    void reset();
+
+    /// returns the report without starting a new one
+    const Report& report() const { return report_; }
+    /// returns the report and starts a new one
+    Report take_report();
+
+  private:
+    struct Block {
+      Address address;  // provisional address
+      Size size;
+      unsigned int start;  // event at which the block is allocated
+      unsigned int end;    // event at which the block is released
+    };
+    static const unsigned int never = UINT_MAX;
+
+    std::vector<Block> blocks_;
+    /// maps the provisional address of each block to its index
+    std::map<Address,size_t> block_index_;
+    /// alloc and free events; the block index is encoded as i for alloc and ~i for free
+    std::vector<long> events_;
+    /// final addresses of blocks
+    std::vector<Address> final_addresses_;
+    Address next_address_;
+    bool finalized_;
+    Size max_memory_used_;
+    Report report_;
+
+    /// assigns the final addresses in order of decreasing size class, returns the peak memory
+    Size pack(std::vector<Address>& addresses) const;
+    /// replays the events through a MemoryManager, returns the peak memory
+    Size replay(const SafePtr<MemoryManager>& memman, std::vector<Address>& addresses) const;
+  };
+
   /**
      MemoryManagerFactory is a very dumb factory for MemoryManagers
   */
   class MemoryManagerFactory {
   public:
-    static const unsigned int ntypes = 8;
+    static const unsigned int ntypes = 9;
     SafePtr<MemoryManager> memman(unsigned int type) const;
     std::string label(unsigned int type) const;
   };
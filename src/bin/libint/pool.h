@@ -0,0 +1,124 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _libint2_src_bin_libint_pool_h_
+#define _libint2_src_bin_libint_pool_h_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace libint2 {
+
+  /**
+     FixedSizePool allocates blocks of a fixed size. The blocks are carved out of large chunks,
+     and released blocks are kept on a free list to be reused, hence allocating and releasing a block
+     costs a few instructions. The chunks are only returned to the system when the pool is destroyed.
+  */
+  class FixedSizePool {
+    public:
+      FixedSizePool(size_t block_size) :
+        block_size_(((block_size < sizeof(void*) ? sizeof(void*) : block_size) + alignment - 1) / alignment * alignment),
+        free_(0), next_(0), end_(0) {}
+      ~FixedSizePool() {
+        for(auto c: chunks_)
+          ::operator delete(c);
+      }
+
+      void* allocate() {
+        if (free_) {
+          void* block = free_;
+          free_ = *static_cast<void**>(free_);
+          return block;
+        }
+        if (next_ == end_)
+          grow();
+        void* block = next_;
+        next_ += block_size_;
+        return block;
+      }
+      void deallocate(void* block) {
+        *static_cast<void**>(block) = free_;
+        free_ = block;
+      }
+
+    private:
+      static const size_t alignment = alignof(std::max_align_t);
+      static const size_t chunk_size = 64 * 1024;
+
+      size_t block_size_;
+      /// the list of released blocks, linked through their first word
+      void* free_;
+      /// the unused part of the last chunk
+      char* next_;
+      char* end_;
+      std::vector<char*> chunks_;
+
+      void grow() {
+        const size_t nblocks = block_size_ < chunk_size ? chunk_size / block_size_ : 1;
+        char* chunk = static_cast<char*>(::operator new(nblocks * block_size_));
+        chunks_.push_back(chunk);
+        next_ = chunk;
+        end_ = chunk + nblocks * block_size_;
+      }
+  };
+
+  /**
+     PoolAllocator is a standard allocator that takes single objects of type T from a FixedSizePool
+     (arrays are allocated by operator new). It is meant for the small objects that the generator creates
+     and destroys by the millions, such as the arcs of DirectedGraph and the nodes of containers of arcs and vertices.
+     There is one pool per type; the pool is never destroyed, since objects allocated from it may be
+     destroyed during static destruction.
+  */
+  template <typename T>
+  class PoolAllocator {
+    public:
+      typedef T value_type;
+
+      PoolAllocator() {}
+      template <typename U> PoolAllocator(const PoolAllocator<U>&) {}
+
+      T* allocate(size_t n) {
+        if (n == 1)
+          return static_cast<T*>(pool().allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+      }
+      void deallocate(T* p, size_t n) {
+        if (n == 1)
+          pool().deallocate(p);
+        else
+          ::operator delete(p);
+      }
+
+    private:
+      static FixedSizePool& pool() {
+        static FixedSizePool* pool_ = new FixedSizePool(sizeof(T));
+        return *pool_;
+      }
+  };
+
+  template <typename T, typename U>
+  bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+  template <typename T, typename U>
+  bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+};
+
+#endif // header guard
@@ -33,6 +33,7 @@
 #include <task.h>
 #include <prefactors.h>
 #include <singl_stack.h>
+#include <cost.h>
 
 using namespace libint2;
 using namespace libint2::prefactor;
@@ -115,6 +116,8 @@ RecurrenceRelation::generate_code(const SafePtr<CodeContext>& context,
     const bool need_to_optimize = (max_am <= cparams->max_am_opt());
     dg->registry()->do_cse(need_to_optimize);
   }
+  // intermediates of RR code with vectorized lines cannot be placed on vstack, hence expressions are condensed
+  // even if explicit SIMD kernels are used; the condensed expressions are evaluated by line loops
   dg->registry()->condense_expr(condense_expr(std::numeric_limits<unsigned int>::max(),cparams->max_vector_length()>1));
   dg->registry()->ignore_missing_prereqs(true);  // assume all prerequisites are available -- if some are not, something is VERY broken
 
@@ -141,6 +144,7 @@ RecurrenceRelation::generate_code(const SafePtr<CodeContext>& context,
   SafePtr<MemoryManager> memman(new WorstFitMemoryManager());
   SafePtr<ImplicitDimensions> localdims = adapt_dims_(dims);
   dg->generate_code(context,memman,localdims,symbols,funcname,decl,def);
+  FunctionCosts::Instance().add(funcname, dg->cost());
 
   // extract all external symbols -- these will be members of the evaluator structure
   SafePtr<ExtractExternSymbols> extractor(new ExtractExternSymbols);
@@ -234,6 +238,11 @@ RecurrenceRelation::generate_generic_code(const SafePtr<CodeContext>& context,
   // ... end the body
   def << context->close_block() << endl;
   def << context->code_postfix();
+
+  // the flops of the generic code are not counted: assume a multiply-add per child for each target element
+  CodeCost cost;
+  cost.nflops = 2ul * num_children() * target_vptr->size();
+  FunctionCosts::Instance().add(funcname, cost);
 }
 
 SafePtr<DirectedGraph>
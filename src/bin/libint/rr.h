@@ -178,6 +178,9 @@ namespace libint2 {
 
     /// Return the number of FLOPs per this recurrence relation
     unsigned int nflops() const { return nflops_; }
+    /// Return the number of times the function called by spfunction_call() evaluates its body per call,
+    /// i.e. the product of the implicit dimensions passed to it explicitly
+    virtual unsigned int spfunction_call_multiplicity() const { return 1; }
 
     /// RecurrenceRelation is managed by SingletonStack but doesn't need to keep track of instance ID
     void inst_id(const SingletonStack<RecurrenceRelation,string>::InstanceID& i) {}
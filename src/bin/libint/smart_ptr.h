@@ -26,6 +26,7 @@
 #if HAVE_SHARED_PTR_IN_BOOST
   #include <boost/shared_ptr.hpp>
   #include <boost/enable_shared_from_this.hpp>
+  #include <boost/make_shared.hpp>
   using namespace boost;
 
   // For now I'll do a cheat since templated typedefs are not standard
@@ -33,6 +34,7 @@
   #define SafePtr boost::shared_ptr
   #define EnableSafePtrFromThis boost::enable_shared_from_this
   #define SafePtr_from_this shared_from_this
+  #define allocate_SafePtr boost::allocate_shared
 #else
   #include <memory>
   // For now I'll do a cheat since templated typedefs are not standard
@@ -40,6 +42,7 @@
   #define SafePtr std::shared_ptr
   #define EnableSafePtrFromThis std::enable_shared_from_this
   #define SafePtr_from_this shared_from_this
+  #define allocate_SafePtr std::allocate_shared
   using std::dynamic_pointer_cast;
 #endif
 
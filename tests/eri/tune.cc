@@ -0,0 +1,182 @@
+/*
+ *  Copyright (C) 2004-2019 Edward F. Valeev
+ *
+ *  This file is part of Libint.
+ *
+ *  Libint is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Libint is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Libint.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/// This program times each class of 2-body repulsion integrals (4, 3, and 2-center varieties)
+/// of the given derivative order; it is used by tune.pl to select the fastest variant of the code
+/// generated for each class. For each class a line "<task> <am> ... <seconds per evaluation>" is printed,
+/// where <am> are the indices of the class in libint2_build_<task>.
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+
+#include <libint2.h>
+#include <libint2/deriv_iter.h>
+#include <prep_libint2.h>
+#include <libint2/util/memory.h>
+#if !LIBINT2_CONSTEXPR_STATICS
+#  include <libint2/statics_definition.h>
+#endif
+
+using namespace std;
+using namespace libint2;
+
+libint2::FmEval_Chebyshev7<double> fmeval_chebyshev(std::max(LIBINT_MAX_AM,4)*4 + 2);
+libint2::FmEval_Taylor<double,6> fmeval_taylor(std::max(LIBINT_MAX_AM,4)*4 + 2, 1e-15);
+
+namespace {
+
+  typedef void (*build_function)(const Libint_t*);
+
+  /// the minimum time spent on timing each class, in seconds
+  const double min_time = 0.1;
+
+  /// times the classes in table, an N-dimensional array of build functions of task
+  template <unsigned int N, typename Table, typename Init, typename Cleanup>
+  void time_task(const std::string& task, const Table& table, unsigned int deriv_order,
+                 Init init, Cleanup cleanup) {
+    static_assert(std::rank<Table>::value == N, "time_task: table has wrong rank");
+    const unsigned int nclasses = sizeof(table) / sizeof(build_function);
+    const build_function* functions = reinterpret_cast<const build_function*>(&table);
+    const unsigned int extents[] = {std::extent<Table, 0>::value, std::extent<Table, 1>::value,
+                                    std::extent<Table, 2>::value, std::extent<Table, 3>::value};
+    const unsigned int lmax = *std::max_element(extents, extents + N) - 1;
+
+    const unsigned int veclen = LIBINT2_MAX_VECLEN;
+#if LIBINT_CONTRACTED_INTS
+    const unsigned int contrdepth = 2;
+#else
+    const unsigned int contrdepth = 1;
+#endif
+    unsigned int contrdepthN = 1;
+    for(unsigned int i=0; i<N; ++i)
+      contrdepthN *= contrdepth;
+
+    Libint_t* inteval = libint2::malloc<Libint_t>(contrdepthN);
+    init(&inteval[0], lmax, 0);
+
+    for(unsigned int c=0; c!=nclasses; ++c) {
+      if (functions[c] == 0)
+        continue;
+
+      // the indices of the class, the last index runs fastest
+      unsigned int am[N];
+      unsigned int cc = c;
+      for(int i=N-1; i>=0; --i) {
+        am[i] = cc % extents[i];
+        cc /= extents[i];
+      }
+
+      RandomShellSet<N> rsqset(am, veclen, contrdepth);
+      prep_libint2(inteval, rsqset, 0, deriv_order);
+#if LIBINT_CONTRACTED_INTS
+      inteval[0].contrdepth = contrdepthN;
+#endif
+
+      // double the number of evaluations until the timing takes at least min_time
+      typedef std::chrono::high_resolution_clock clock;
+      double elapsed = 0.0;
+      unsigned long nrepeats = 1;
+      for(; ; nrepeats *= 2) {
+        const auto start = clock::now();
+        for(unsigned long k=0; k!=nrepeats; ++k)
+          functions[c](&inteval[0]);
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        if (elapsed >= min_time)
+          break;
+      }
+
+      cout << task;
+      for(unsigned int i=0; i<N; ++i)
+        cout << " " << am[i];
+      cout << " " << elapsed / nrepeats << endl;
+    }
+
+    cleanup(&inteval[0]);
+    free(inteval);
+  }
+
+}
+
+/// give optional derivative order (default = 0, i.e. regular integrals)
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    cerr << "Usage: tune [deriv_order]" << endl;
+    return 1;
+  }
+  const unsigned int deriv_order = (argc == 2) ? atoi(argv[1]) : 0u;
+
+  LIBINT2_PREFIXED_NAME(libint2_static_init)();
+
+#ifdef INCLUDE_ERI
+  if (deriv_order == 0)
+    time_task<4>("eri", LIBINT2_PREFIXED_NAME(libint2_build_eri), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_eri), LIBINT2_PREFIXED_NAME(libint2_cleanup_eri));
+#if INCLUDE_ERI >= 1
+  if (deriv_order == 1)
+    time_task<4>("eri1", LIBINT2_PREFIXED_NAME(libint2_build_eri1), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_eri1), LIBINT2_PREFIXED_NAME(libint2_cleanup_eri1));
+#endif
+#if INCLUDE_ERI >= 2
+  if (deriv_order == 2)
+    time_task<4>("eri2", LIBINT2_PREFIXED_NAME(libint2_build_eri2), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_eri2), LIBINT2_PREFIXED_NAME(libint2_cleanup_eri2));
+#endif
+#endif // INCLUDE_ERI
+
+#ifdef INCLUDE_ERI3
+  if (deriv_order == 0)
+    time_task<3>("3eri", LIBINT2_PREFIXED_NAME(libint2_build_3eri), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_3eri), LIBINT2_PREFIXED_NAME(libint2_cleanup_3eri));
+#if INCLUDE_ERI3 >= 1
+  if (deriv_order == 1)
+    time_task<3>("3eri1", LIBINT2_PREFIXED_NAME(libint2_build_3eri1), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_3eri1), LIBINT2_PREFIXED_NAME(libint2_cleanup_3eri1));
+#endif
+#if INCLUDE_ERI3 >= 2
+  if (deriv_order == 2)
+    time_task<3>("3eri2", LIBINT2_PREFIXED_NAME(libint2_build_3eri2), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_3eri2), LIBINT2_PREFIXED_NAME(libint2_cleanup_3eri2));
+#endif
+#endif // INCLUDE_ERI3
+
+#ifdef INCLUDE_ERI2
+  if (deriv_order == 0)
+    time_task<2>("2eri", LIBINT2_PREFIXED_NAME(libint2_build_2eri), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_2eri), LIBINT2_PREFIXED_NAME(libint2_cleanup_2eri));
+#if INCLUDE_ERI2 >= 1
+  if (deriv_order == 1)
+    time_task<2>("2eri1", LIBINT2_PREFIXED_NAME(libint2_build_2eri1), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_2eri1), LIBINT2_PREFIXED_NAME(libint2_cleanup_2eri1));
+#endif
+#if INCLUDE_ERI2 >= 2
+  if (deriv_order == 2)
+    time_task<2>("2eri2", LIBINT2_PREFIXED_NAME(libint2_build_2eri2), deriv_order,
+                 LIBINT2_PREFIXED_NAME(libint2_init_2eri2), LIBINT2_PREFIXED_NAME(libint2_cleanup_2eri2));
+#endif
+#endif // INCLUDE_ERI2
+
+  LIBINT2_PREFIXED_NAME(libint2_static_cleanup)();
+
+  return 0;
+}
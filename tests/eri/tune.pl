@@ -0,0 +1,76 @@
+#!/usr/bin/perl
+
+#
+# Selects the fastest variant of the code generated for each class of 2-body integrals.
+# The library in the build tree is generated and compiled with each variant
+# (see Variant in src/bin/libint/build_libint.cc), each class is timed by the tune program,
+# and the fastest variant of each class is written to the manifest. Once the library
+# is generated with "make BUILD_LIBINT_FLAGS=--tune-manifest=<manifest>" each class uses its fastest variant.
+#
+
+use strict;
+use Getopt::Long;
+use Cwd qw(abs_path);
+
+my $builddir = "";
+my $manifest = "tune.manifest";
+my $maxderiv = 0;
+my $makevars = "";
+my @variants = ("default", "first-choice", "no-cse", "no-unroll");
+&GetOptions("builddir=s" => \$builddir,
+            "manifest=s" => \$manifest,
+            "maxderiv=i" => \$maxderiv,
+            "makevars=s" => \$makevars);
+@variants = @ARGV if ($#ARGV >= 0);
+(usage() and die) if ($builddir eq "");
+$builddir = abs_path($builddir);
+
+# time of each class for each variant
+my %timings = ();
+foreach my $variant (@variants) {
+  printf STDOUT "Generating and compiling the library with variant $variant ... ";
+  my $libdir = "$builddir/src/lib/libint";
+  system("make -C $libdir $makevars realclean > /dev/null") && die("could not clean $libdir");
+  system("make -C $libdir $makevars BUILD_LIBINT_FLAGS=--variant=$variant > tune.$variant.log 2>&1")
+    && die("could not build the library with variant $variant, see tune.$variant.log");
+  printf STDOUT "done\n";
+
+  my $testdir = "$builddir/tests/eri";
+  unlink("$testdir/tune");
+  system("make -C $testdir $makevars tune >> tune.$variant.log 2>&1") && die("could not compile the tune program");
+  for(my $d=0; $d<=$maxderiv; ++$d) {
+    printf STDOUT "Timing the classes of derivative order $d ... ";
+    open(TIMES, "$testdir/tune $d |") or die("could not run the tune program");
+    while (<TIMES>) {
+      chomp;
+      my @fields = split;
+      my $time = pop @fields;
+      push @{$timings{join(" ", @fields)}}, [$variant, $time];
+    }
+    close(TIMES) or die("the tune program failed");
+    printf STDOUT "done\n";
+  }
+}
+
+open(MANIFEST, ">$manifest") or die("could not open $manifest");
+printf MANIFEST "# the fastest variant of each class, produced by tune.pl\n";
+printf MANIFEST "# task, indices of the class in libint2_build_<task>, variant\n";
+foreach my $class (sort keys %timings) {
+  my @sorted = sort { $a->[1] <=> $b->[1] } @{$timings{$class}};
+  next if ($sorted[0]->[0] eq "default");
+  printf MANIFEST "$class $sorted[0]->[0]\n";
+}
+close MANIFEST;
+printf STDOUT "Wrote $manifest; the library in $builddir is left generated with variant $variants[-1]\n";
+
+exit(0);
+
+sub usage {
+  printf STDERR "USAGE: tune.pl --builddir=dir [options] [variant ...]\n";
+  printf STDERR "         variant -- variants to consider. Defaults to all variants.\n";
+  printf STDERR "       Options:\n";
+  printf STDERR "         --builddir=dir    -- top build directory of the library (required).\n";
+  printf STDERR "         --manifest=file   -- the manifest to write. Defaults to tune.manifest.\n";
+  printf STDERR "         --maxderiv=n      -- time the classes of derivative order up to n. Defaults to 0.\n";
+  printf STDERR "         --makevars=S      -- pass S to make command. Can be used to override make variables, etc.\n";
+}
@@ -38,13 +38,10 @@
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 
-// have BTAS library?
-#ifdef LIBINT2_HAVE_BTAS
-#include <btas/btas.h>
-#endif  // LIBINT2_HAVE_BTAS
-
 // Libint Gaussian integrals library
+#include <libint2/df_integral_store.h>
 #include <libint2/diis.h>
+#include <libint2/fock_builder.h>
 #include <libint2/util/intpart_iter.h>
 #include <libint2/chemistry/sto3g_atomic_density.h>
 #include <libint2/lcao/molden.h>
@@ -155,22 +152,22 @@ std::vector<Matrix> compute_2body_fock_deriv(
 std::tuple<Matrix, Matrix, double> conditioning_orthogonalizer(
     const Matrix& S, double S_condition_number_threshold);
 
-#ifdef LIBINT2_HAVE_BTAS
 #define HAVE_DENSITY_FITTING 1
 struct DFFockEngine {
   const BasisSet& obs;
   const BasisSet& dfbs;
-  DFFockEngine(const BasisSet& _obs, const BasisSet& _dfbs)
-      : obs(_obs), dfbs(_dfbs) {}
+  // if not empty, the 3-center integrals are kept in this file
+  std::string scratch_file;
+  DFFockEngine(const BasisSet& _obs, const BasisSet& _dfbs,
+               const std::string& _scratch_file = std::string())
+      : obs(_obs), dfbs(_dfbs), scratch_file(_scratch_file) {}
 
-  typedef btas::RangeNd<CblasRowMajor, std::array<long, 3>> Range3d;
-  typedef btas::Tensor<double, Range3d> Tensor3d;
-  Tensor3d xyK;
+  // 3-center integrals in the orthonormalized DF basis
+  std::unique_ptr<libint2::DFIntegralStore> xyK;
 
   // a DF-based builder, using coefficients of occupied MOs
   Matrix compute_2body_fock_dfC(const Matrix& Cocc);
 };
-#endif  // HAVE_DENSITY_FITTING
 
 namespace libint2 {
 int nthreads;
@@ -363,10 +360,46 @@ int main(int argc, char* argv[]) {
     // pre-compute data for Schwarz bounds
     auto K = compute_schwarz_ints<>(obs);
 
+    // keep the integrals in files in this directory, rather than recompute
+    // them in every iteration?
+    std::string scratch_dir;
+    {
+      auto scratch_dir_cstr = getenv("LIBINT_SCRATCH_DIR");
+      if (scratch_dir_cstr && strcmp(scratch_dir_cstr, ""))
+        scratch_dir = scratch_dir_cstr;
+    }
+    // the integrals of the conventional (non-DF) Fock builds are either kept in
+    // files, or recomputed in every iteration and screened with the integral
+    // norms cached here, so that the incremental builds only visit the shell
+    // quartets that can contribute; in either case, only the quartets that
+    // survive the distance-including (QQR) screening are computed
+    std::unique_ptr<libint2::FockBuilder> fock_builder;
+    if (!do_density_fitting) {
+      const auto tstart = std::chrono::high_resolution_clock::now();
+      fock_builder.reset(new libint2::FockBuilder(
+          obs, libint2::nthreads, std::numeric_limits<double>::epsilon(), K));
+      fock_builder->enable_distance_screening();
+      if (!scratch_dir.empty()) {
+        std::cout << "storing the integrals in " << scratch_dir << " ... ";
+        fock_builder->store_integrals(scratch_dir + "/hartree-fock++.eri");
+      } else {
+        std::cout << "caching the integral norms ... ";
+        fock_builder->cache_integral_norms();
+      }
+      const auto tstop = std::chrono::high_resolution_clock::now();
+      const std::chrono::duration<double> time_elapsed = tstop - tstart;
+      std::cout << "done (" << time_elapsed.count() << " s)" << std::endl;
+    }
+
 // prepare for density fitting
 #ifdef HAVE_DENSITY_FITTING
     std::unique_ptr<DFFockEngine> dffockengine(
-        do_density_fitting ? new DFFockEngine(obs, dfbs) : nullptr);
+        do_density_fitting
+            ? new DFFockEngine(obs, dfbs,
+                               scratch_dir.empty()
+                                   ? std::string()
+                                   : scratch_dir + "/hartree-fock++.df")
+            : nullptr);
 #endif  // HAVE_DENSITY_FITTING
 
     /*** =========================== ***/
@@ -426,7 +459,9 @@ int main(int argc, char* argv[]) {
         const auto precision_F = std::min(
             std::min(1e-3 / XtX_condition_number, 1e-7),
             std::max(rms_error / 1e4, std::numeric_limits<double>::epsilon()));
-        F += compute_2body_fock(obs, D_diff, precision_F, K);
+        fock_builder->set_precision(precision_F);
+        const auto JK = fock_builder->compute(D_diff);
+        F += 2.0 * JK.first - JK.second;
       }
 #if HAVE_DENSITY_FITTING
       else {  // do DF
@@ -610,19 +645,13 @@ int main(int argc, char* argv[]) {
 
 #if LIBINT2_DERIV_ERI_ORDER
       // compute 2-e forces
-      Matrix F2 = Matrix::Zero(atoms.size(), 3);
-
       //////////
       // two-body contributions to the forces
+      // identity prefactor since E(HF) = trace(H + F, D) = trace(2H + G, D)
+      // the derivative integrals are contracted with D on the fly, without forming the derivatives of G
       //////////
-      auto G1 = compute_2body_fock_deriv<1>(obs, atoms, D);
-      for (auto atom = 0, i = 0; atom != atoms.size(); ++atom) {
-        for (auto xyz = 0; xyz != 3; ++xyz, ++i) {
-          // identity prefactor since E(HF) = trace(H + F, D) = trace(2H + G, D)
-          auto force = G1[i].cwiseProduct(D).sum();
-          F2(atom, xyz) += force;
-        }
-      }
+      libint2::FockBuilder fock_builder(obs, libint2::nthreads);
+      Matrix F2 = fock_builder.compute_gradient(D, atoms);
 
       std::cout << "** 2-body forces = ";
       for (int atom = 0; atom != atoms.size(); ++atom)
@@ -731,19 +760,13 @@ int main(int argc, char* argv[]) {
 
 #if LIBINT2_DERIV_ERI_ORDER > 1
       // compute 2-e forces
-      Matrix H2 = Matrix::Zero(ncoords, ncoords);
-
       //////////
-      // two-body contributions to the forces
+      // two-body contributions to the hessian
+      // identity prefactor since E(HF) = trace(H + F, D) = trace(2H + G, D)
+      // NB the full matrix is computed, only its upper triangle is used
       //////////
-      auto G2 = compute_2body_fock_deriv<2>(obs, atoms, D);
-      for (auto row = 0, i = 0; row != ncoords; ++row) {
-        for (auto col = row; col != ncoords; ++col, ++i) {
-          // identity prefactor since E(HF) = trace(H + F, D) = trace(2H + G, D)
-          auto hess = G2[i].cwiseProduct(D).sum();
-          H2(row, col) += hess;
-        }
-      }
+      libint2::FockBuilder fock_builder(obs, libint2::nthreads);
+      Matrix H2 = fock_builder.compute_hessian(D, atoms);
 
       std::cout << "** 2-body hessian = ";
       for (auto row = 0, i = 0; row != ncoords; ++row) {
@@ -1470,8 +1493,10 @@ Matrix compute_2body_2index_ints(const BasisSet& bs) {
   using libint2::Engine;
   std::vector<Engine> engines(nthreads);
   engines[0] =
-      Engine(libint2::Operator::coulomb, bs.max_nprim(), bs.max_l(), 0);
-  engines[0].set(BraKet::xs_xs);
+      Engine(libint2::Operator::coulomb, bs.max_nprim(), bs.max_l(), 0,
+             std::numeric_limits<double>::epsilon(),
+             libint2::operator_traits<libint2::Operator::coulomb>::default_params(),
+             BraKet::xs_xs);
   for (size_t i = 1; i != nthreads; ++i) {
     engines[i] = engines[0];
   }
@@ -2121,160 +2146,67 @@ Matrix DFFockEngine::compute_2body_fock_dfC(const Matrix& Cocc) {
   const auto n = obs.nbf();
   const auto ndf = dfbs.nbf();
 
-  libint2::Timers<1> wall_timer;
-  wall_timer.set_now_overhead(25);
-  std::vector<libint2::Timers<5>> timers(nthreads);
-  for(auto& timer: timers) timer.set_now_overhead(25);
-
-  typedef btas::RangeNd<CblasRowMajor, std::array<long, 1>> Range1d;
-  typedef btas::RangeNd<CblasRowMajor, std::array<long, 2>> Range2d;
-  typedef btas::Tensor<double, Range1d> Tensor1d;
-  typedef btas::Tensor<double, Range2d> Tensor2d;
+  libint2::Timers<4> timers;
+  timers.set_now_overhead(25);
 
   // using first time? compute 3-center ints and transform to inv sqrt
   // representation
-  if (xyK.size() == 0) {
-
-    wall_timer.start(0);
-
-    const auto nshells = obs.size();
-    const auto nshells_df = dfbs.size();
-    const auto& unitshell = libint2::Shell::unit();
-
-    // construct the 2-electron 3-center repulsion integrals engine
-    // since the code assumes (xx|xs) braket, and Engine/libint only produces
-    // (xs|xx), use 4-center engine
-    std::vector<libint2::Engine> engines(nthreads);
-    engines[0] = libint2::Engine(libint2::Operator::coulomb,
-                                 std::max(obs.max_nprim(), dfbs.max_nprim()),
-                                 std::max(obs.max_l(), dfbs.max_l()), 0);
-    engines[0].set(BraKet::xs_xx);
-    for (size_t i = 1; i != nthreads; ++i) {
-      engines[i] = engines[0];
-    }
+  if (!xyK) {
 
-    auto shell2bf = obs.shell2bf();
-    auto shell2bf_df = dfbs.shell2bf();
-
-    Tensor3d Zxy{ndf, n, n};
-
-    auto lambda = [&](int thread_id) {
-
-      auto& engine = engines[thread_id];
-      auto& timer = timers[thread_id];
-      const auto& results = engine.results();
-
-      // loop over permutationally-unique set of shells
-      for (auto s1 = 0l, s123 = 0l; s1 != nshells_df; ++s1) {
-        auto bf1_first = shell2bf_df[s1];  // first basis function in this shell
-        auto n1 = dfbs[s1].size();  // number of basis functions in this shell
-
-        for (auto s2 = 0; s2 != nshells; ++s2) {
-          auto bf2_first = shell2bf[s2];
-          auto n2 = obs[s2].size();
-          const auto n12 = n1 * n2;
-
-          for (auto s3 = 0; s3 != nshells; ++s3, ++s123) {
-            if (s123 % nthreads != thread_id) continue;
-
-            auto bf3_first = shell2bf[s3];
-            auto n3 = obs[s3].size();
-            const auto n123 = n12 * n3;
-
-            timer.start(0);
-
-            engine.compute2<Operator::coulomb, BraKet::xs_xx, 0>(
-                dfbs[s1], unitshell, obs[s2], obs[s3]);
-            const auto* buf = results[0];
-            if (buf == nullptr)
-              continue;
-
-            timer.stop(0);
-            timer.start(1);
-
-            auto lower_bound = {bf1_first, bf2_first, bf3_first};
-            auto upper_bound = {bf1_first + n1, bf2_first + n2, bf3_first + n3};
-            auto view = btas::make_view(
-                Zxy.range().slice(lower_bound, upper_bound), Zxy.storage());
-            std::copy(buf, buf + n123, view.begin());
-
-            timer.stop(1);
-          }  // s3
-        }    // s2
-      }      // s1
-
-    };  // lambda
+    timers.start(0);
 
-    libint2::parallel_do(lambda);
+    // only the significant {μ,ν} shell pairs with μ>=ν are stored
+    xyK.reset(new libint2::DFIntegralStore(
+        obs, dfbs, nthreads, std::numeric_limits<double>::epsilon(),
+        scratch_file));
 
-    wall_timer.stop(0);
-
-    double ints_time = 0;
-    for(const auto& timer: timers) ints_time += timer.read(0);
-    std::cout << "time for Zxy integrals = " << ints_time << " (total from all threads)" << std::endl;
-    double copy_time = 0;
-    for(const auto& timer: timers) copy_time += timer.read(1);
-    std::cout << "time for copying into BTAS = " << copy_time << " (total from all threads)"<< std::endl;
-    std::cout << "wall time for Zxy integrals + copy = " << wall_timer.read(0) << std::endl;
+    timers.stop(0);
+    std::cout << "time for Zxy integrals = " << timers.read(0) << std::endl;
+    std::cout << "# of significant (P|μν) shell sets = " << xyK->nsignificant()
+              << ", memory = " << xyK->nbytes() / (1024. * 1024.) << " MB"
+              << std::endl;
 
-    timers[0].start(2);
+    timers.start(1);
 
     Matrix V = compute_2body_2index_ints(dfbs);
     Eigen::LLT<Matrix> V_LLt(V);
     Matrix I = Matrix::Identity(ndf, ndf);
     auto L = V_LLt.matrixL();
-    Matrix V_L = L;
     Matrix Linv_t = L.solve(I).transpose();
-    // check
-    //  std::cout << "||V - L L^t|| = " << (V - V_L * V_L.transpose()).norm() <<
-    //  std::endl;
-    //  std::cout << "||I - L L^-1|| = " << (I - V_L *
-    //  Linv_t.transpose()).norm() << std::endl;
-    //  std::cout << "||V^-1 - L^-1^t L^-1|| = " << (V.inverse() - Linv_t *
-    //  Linv_t.transpose()).norm() << std::endl;
-
-    Tensor2d K{ndf, ndf};
-    std::copy(Linv_t.data(), Linv_t.data() + ndf * ndf, K.begin());
-
-    xyK = Tensor3d{n, n, ndf};
-    btas::contract(1.0, Zxy, {1, 2, 3}, K, {1, 4}, 0.0, xyK, {2, 3, 4});
-    Zxy = Tensor3d{0, 0, 0};  // release memory
-
-    timers[0].stop(2);
-    std::cout << "time for integrals metric tform = " << timers[0].read(2)
+    xyK->transform(Linv_t);
+
+    timers.stop(1);
+    std::cout << "time for integrals metric tform = " << timers.read(1)
               << std::endl;
-  }  // if (xyK.size() == 0)
+  }  // if (!xyK)
 
   // compute exchange
-  timers[0].start(3);
+  timers.start(2);
 
   const auto nocc = Cocc.cols();
-  Tensor2d Co{n, nocc};
-  std::copy(Cocc.data(), Cocc.data() + n * nocc, Co.begin());
-  Tensor3d xiK{n, nocc, ndf};
-  btas::contract(1.0, xyK, {1, 2, 3}, Co, {2, 4}, 0.0, xiK, {1, 4, 3});
+  // xiK(K, x*nocc + i) = sum_y xyK(K, x, y) Cocc(y, i)
+  const Matrix xiK = xyK->contract_ao(Cocc);
 
-  Tensor2d G{n, n};
-  btas::contract(1.0, xiK, {1, 2, 3}, xiK, {4, 2, 3}, 0.0, G, {1, 4});
+  Matrix G = Matrix::Zero(n, n);
+  for (auto K = 0l; K != ndf; ++K) {
+    Eigen::Map<const Matrix> xi(xiK.data() + K * n * nocc, n, nocc);
+    G.noalias() += xi * xi.transpose();
+  }
 
-  timers[0].stop(3);
-  std::cout << "time for exchange = " << timers[0].read(3) << std::endl;
+  timers.stop(2);
+  std::cout << "time for exchange = " << timers.read(2) << std::endl;
 
   // compute Coulomb
-  timers[0].start(4);
+  timers.start(3);
 
-  Tensor1d Jtmp{ndf};
-  btas::contract(1.0, xiK, {1, 2, 3}, Co, {1, 2}, 0.0, Jtmp, {3});
-  xiK = Tensor3d{0, 0, 0};
-  btas::contract(2.0, xyK, {1, 2, 3}, Jtmp, {3}, -1.0, G, {1, 2});
+  Eigen::Map<const Eigen::VectorXd> Co(Cocc.data(), n * nocc);
+  const Eigen::VectorXd Jtmp = xiK * Co;
+  G = 2.0 * xyK->contract_df(Jtmp) - G;
 
-  timers[0].stop(4);
-  std::cout << "time for coulomb = " << timers[0].read(4) << std::endl;
+  timers.stop(3);
+  std::cout << "time for coulomb = " << timers.read(3) << std::endl;
 
-  // copy result to an Eigen::Matrix
-  Matrix result(n, n);
-  std::copy(G.cbegin(), G.cend(), result.data());
-  return result;
+  return G;
 }
 #endif  // HAVE_DENSITY_FITTING
 
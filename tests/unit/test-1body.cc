@@ -1,6 +1,8 @@
 #include "catch.hpp"
 #include "fixture.h"
 
+#include <libint2/point_charge_potential.h>
+
 TEST_CASE_METHOD(libint2::unit::DefaultFixture, "electrostatic potential", "[engine][1-body]") {
 #if defined(LIBINT2_SUPPORT_ONEBODY)
   if (LIBINT_SHGSHELL_ORDERING != LIBINT_SHGSHELL_ORDERING_STANDARD)
@@ -61,3 +63,95 @@ TEST_CASE_METHOD(libint2::unit::DefaultFixture, "electrostatic potential", "[eng
 
 #endif // LIBINT2_SUPPORT_ONEBODY
 }
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "electrostatic potential of many charges", "[engine][1-body]") {
+#if defined(LIBINT2_SUPPORT_ONEBODY)
+  if (LIBINT2_MAX_AM_elecpot < obs.max_l())
+    return;
+
+  // enough pseudorandom charges to need several batches, some of them far away
+  std::vector<std::pair<double, std::array<double, 3>>> charges;
+  for (int i = 0; i != 300; ++i) {
+    const auto r = (i % 3 == 0) ? 100.0 : 5.0;
+    charges.emplace_back(
+        0.1 * std::cos(1.3 * i),
+        std::array<double, 3>{{r * std::sin(0.7 * i), r * std::cos(1.1 * i),
+                               r * std::sin(2.3 * i + 1.0)}});
+  }
+
+  auto engine = Engine(Operator::nuclear, obs.max_nprim(), obs.max_l());
+  engine.set_params(charges);
+  auto engine_screened = Engine(Operator::nuclear, obs.max_nprim(), obs.max_l(), 0, 1e-10);
+  engine_screened.set_params(charges).set_charge_screening(true);
+  REQUIRE(engine_screened.charge_screening());
+  auto engine1 = Engine(Operator::nuclear, obs.max_nprim(), obs.max_l());
+
+  for (auto s1 = 0ul; s1 != obs.size(); ++s1) {
+    for (auto s2 = 0ul; s2 <= s1; ++s2) {
+      const auto n12 = obs[s1].size() * obs[s2].size();
+      // reference: one charge at a time
+      std::vector<double> ref(n12, 0.0);
+      for (const auto& charge : charges) {
+        engine1.set_params(std::vector<std::pair<double, std::array<double, 3>>>{charge});
+        engine1.compute(obs[s1], obs[s2]);
+        for (auto i = 0ul; i != n12; ++i) ref[i] += engine1.results()[0][i];
+      }
+      engine.compute(obs[s1], obs[s2]);
+      for (auto i = 0ul; i != n12; ++i)
+        REQUIRE(engine.results()[0][i] == Approx(ref[i]).margin(1e-12));
+      engine_screened.compute(obs[s1], obs[s2]);
+      for (auto i = 0ul; i != n12; ++i)
+        REQUIRE(engine_screened.results()[0][i] == Approx(ref[i]).margin(1e-8));
+    }
+  }
+#endif // LIBINT2_SUPPORT_ONEBODY
+}
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "PointChargePotential", "[engine][1-body]") {
+#if defined(LIBINT2_SUPPORT_ONEBODY)
+  if (LIBINT2_MAX_AM_elecpot < obs.max_l() || LIBINT2_MAX_AM_1emultipole < obs.max_l())
+    return;
+  typedef libint2::PointChargePotential::Matrix Matrix;
+
+  // pseudorandom charges in a shell around the molecule, plus the nuclei
+  auto charges = libint2::make_point_charges(atoms);
+  for (int i = 0; i != 2000; ++i) {
+    const auto r = 10.0 + 30.0 * (0.5 + 0.5 * std::sin(3.1 * i));
+    const auto cos_theta = std::cos(1.7 * i);
+    const auto sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+    const auto phi = 2.3 * i;
+    charges.emplace_back(
+        0.2 * std::cos(0.9 * i),
+        std::array<double, 3>{{r * sin_theta * std::cos(phi),
+                               r * sin_theta * std::sin(phi), r * cos_theta}});
+  }
+
+  // reference
+  const auto n = obs.nbf();
+  Matrix Vref(n, n);
+  {
+    auto engine = Engine(Operator::nuclear, obs.max_nprim(), obs.max_l());
+    engine.set_params(charges);
+    const auto shell2bf = obs.shell2bf();
+    for (auto s1 = 0ul; s1 != obs.size(); ++s1) {
+      for (auto s2 = 0ul; s2 != obs.size(); ++s2) {
+        engine.compute(obs[s1], obs[s2]);
+        Vref.block(shell2bf[s1], shell2bf[s2], obs[s1].size(), obs[s2].size()) =
+            Eigen::Map<const Matrix>(engine.results()[0], obs[s1].size(), obs[s2].size());
+      }
+    }
+  }
+
+  libint2::PointChargePotential pcp(charges, 16);
+  REQUIRE(pcp.charges().size() == charges.size());
+  REQUIRE(pcp.ncells() > 1);
+  // exact
+  const auto V0 = pcp.compute(obs, 0.0);
+  REQUIRE((V0 - Vref).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-10));
+  // multipole approximation, the error decreases with theta
+  const auto V3 = pcp.compute(obs, 0.3, 1e-12);
+  REQUIRE((V3 - Vref).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-3));
+  const auto V1 = pcp.compute(obs, 0.1, 1e-12);
+  REQUIRE((V1 - Vref).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-6));
+#endif // LIBINT2_SUPPORT_ONEBODY
+}
@@ -1,6 +1,10 @@
 #include "catch.hpp"
 #include "fixture.h"
 
+#include <libint2/df_integral_store.h>
+#include <libint2/engine_pool.h>
+#include <libint2/fock_builder.h>
+
 TEST_CASE("Slater/Yukawa integrals", "[engine][2-body]") {
 
   std::vector<Shell> obs{
@@ -63,3 +67,654 @@ TEST_CASE("Slater/Yukawa integrals", "[engine][2-body]") {
   }
 
 }
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "Engine::compute2_batch", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < 1)
+    return;
+
+  // group all shell quartets of the (pp|sp) class
+  std::vector<std::size_t> s_shells, p_shells;
+  for (auto s = 0ul; s != obs.size(); ++s) {
+    if (obs[s].contr[0].l == 0) s_shells.push_back(s);
+    if (obs[s].contr[0].l == 1) p_shells.push_back(s);
+  }
+  std::vector<Engine::ShellQuartet> quartets;
+  for (auto s1 : p_shells)
+    for (auto s2 : p_shells)
+      for (auto s3 : s_shells)
+        for (auto s4 : p_shells)
+          quartets.push_back(Engine::ShellQuartet{&obs[s1], &obs[s2], &obs[s3],
+                                                  &obs[s4], nullptr, nullptr});
+  REQUIRE(!quartets.empty());
+
+  auto engine = Engine(Operator::coulomb, obs.max_nprim(), 1);
+  const auto setsize = 3 * 3 * 1 * 3;
+  std::vector<double> batch(quartets.size() * setsize);
+  const auto nnonzero =
+      engine.compute2_batch<Operator::coulomb, BraKet::xx_xx, 0>(
+          quartets.data(), quartets.size(), batch.data());
+  REQUIRE(nnonzero <= quartets.size());
+
+  const auto& results = engine.results();
+  for (auto q = 0ul; q != quartets.size(); ++q) {
+    const auto& quartet = quartets[q];
+    engine.compute2<Operator::coulomb, BraKet::xx_xx, 0>(
+        *quartet.bra1, *quartet.bra2, *quartet.ket1, *quartet.ket2);
+    for (int i = 0; i != setsize; ++i) {
+      const auto ref = results[0] != nullptr ? results[0][i] : 0.;
+      REQUIRE(batch[q * setsize + i] == Approx(ref).margin(1e-14));
+    }
+  }
+}
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "Engine::compute2 permuted solid harmonics", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < 2)
+    return;
+
+  // (d p|s d) quartet with solid harmonic d shells on different centers
+  std::vector<Shell> shells(4);
+  for (const auto& sh : obs) {
+    if (sh.contr[0].l == 2 && sh.O == obs[0].O) shells[0] = sh;
+    if (sh.contr[0].l == 1 && sh.O != obs[0].O) shells[1] = sh;
+    if (sh.contr[0].l == 0 && sh.O != obs[0].O) shells[2] = sh;
+    if (sh.contr[0].l == 2 && sh.O != obs[0].O) shells[3] = sh;
+  }
+  REQUIRE(shells[0].contr[0].l == 2);
+  REQUIRE(shells[3].contr[0].l == 2);
+
+  auto engine = Engine(Operator::coulomb, obs.max_nprim(), 2);
+  const auto& buf = engine.results();
+  for (auto pure : {false, true}) {
+    shells[0].contr[0].pure = pure;
+    shells[3].contr[0].pure = pure;
+    // reference computed in the canonical order, in which no permutation is needed
+    engine.compute(shells[0], shells[1], shells[2], shells[3]);
+    REQUIRE(buf[0] != nullptr);
+    const std::vector<double> ref(buf[0], buf[0] + shells[0].size() * shells[1].size() *
+                                                     shells[2].size() * shells[3].size());
+
+    // all 8 permutationally-equivalent orderings of the quartet
+    const std::array<std::array<int, 4>, 8> perms = {{{{0, 1, 2, 3}},
+                                                      {{1, 0, 2, 3}},
+                                                      {{0, 1, 3, 2}},
+                                                      {{1, 0, 3, 2}},
+                                                      {{2, 3, 0, 1}},
+                                                      {{3, 2, 0, 1}},
+                                                      {{2, 3, 1, 0}},
+                                                      {{3, 2, 1, 0}}}};
+    for (const auto& p : perms) {
+      engine.compute(shells[p[0]], shells[p[1]], shells[p[2]], shells[p[3]]);
+      REQUIRE(buf[0] != nullptr);
+      std::array<size_t, 4> f, n;
+      for (int k = 0; k != 4; ++k) n[k] = shells[k].size();
+      size_t f0123 = 0;
+      for (f[p[0]] = 0; f[p[0]] != n[p[0]]; ++f[p[0]])
+        for (f[p[1]] = 0; f[p[1]] != n[p[1]]; ++f[p[1]])
+          for (f[p[2]] = 0; f[p[2]] != n[p[2]]; ++f[p[2]])
+            for (f[p[3]] = 0; f[p[3]] != n[p[3]]; ++f[p[3]], ++f0123) {
+              const auto ref_idx = ((f[0] * n[1] + f[1]) * n[2] + f[2]) * n[3] + f[3];
+              REQUIRE(buf[0][f0123] == Approx(ref[ref_idx]).margin(1e-14));
+            }
+    }
+  }
+}
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "Engine::compute2 Rys quadrature", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < 2)
+    return;
+
+  auto engine_os = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l());
+  auto engine_rys = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l());
+  REQUIRE(engine_rys.rys_am_threshold() > 4 * LIBINT2_MAX_AM_eri);
+  engine_rys.set_rys_am_threshold(1);
+  REQUIRE(engine_rys.rys_am_threshold() == 1);
+  // contracted quartets of 6-31G* are computed by the library, the rest by the Rys quadrature
+  auto engine_mixed = engine_rys;
+  engine_mixed.set_rys_max_nprim(1);
+  REQUIRE(engine_mixed.rys_max_nprim() == 1);
+  REQUIRE(engine_rys.rys_max_nprim() > 1);
+  const auto& results_os = engine_os.results();
+  const auto& results_rys = engine_rys.results();
+  const auto& results_mixed = engine_mixed.results();
+
+  // the d shells of 6-31G* are Cartesian, also test solid harmonics
+  auto shells = std::vector<Shell>(obs.begin(), obs.end());
+  for (auto pure : {false, true}) {
+    for (auto& sh : shells)
+      if (sh.contr[0].l > 1) sh.contr[0].pure = pure;
+    const auto nshell = shells.size();
+    for (auto s1 = 0ul; s1 != nshell; ++s1) {
+      for (auto s2 = 0ul; s2 != nshell; ++s2) {
+        for (auto s3 = 0ul; s3 != nshell; ++s3) {
+          for (auto s4 = 0ul; s4 != nshell; ++s4) {
+            engine_os.compute(shells[s1], shells[s2], shells[s3], shells[s4]);
+            engine_rys.compute(shells[s1], shells[s2], shells[s3], shells[s4]);
+            engine_mixed.compute(shells[s1], shells[s2], shells[s3], shells[s4]);
+            if (results_os[0] == nullptr) {
+              REQUIRE(results_rys[0] == nullptr);
+              REQUIRE(results_mixed[0] == nullptr);
+              continue;
+            }
+            REQUIRE(results_rys[0] != nullptr);
+            REQUIRE(results_mixed[0] != nullptr);
+            const auto setsize = shells[s1].size() * shells[s2].size() *
+                                 shells[s3].size() * shells[s4].size();
+            for (auto i = 0ul; i != setsize; ++i) {
+              REQUIRE(results_rys[0][i] == Approx(results_os[0][i]).margin(1e-12));
+              REQUIRE(results_mixed[0][i] == Approx(results_os[0][i]).margin(1e-12));
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "Engine::estimated_cost", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < 2)
+    return;
+
+  auto engine = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l());
+  const auto& results = engine.results();
+
+  // the cost grows with the angular momentum and the number of primitives
+  const Shell p1{{1.0}, {{1, false, {1.0}}}, {{0.0, 0.0, 0.0}}};
+  const Shell p2{{1.0, 3.0}, {{1, false, {0.5, 0.5}}}, {{0.0, 0.0, 0.0}}};
+  const Shell d1{{1.0}, {{2, false, {1.0}}}, {{0.0, 0.0, 0.0}}};
+  const auto cost_pppp = engine.estimated_cost(p1, p1, p1, p1);
+  const auto cost_dddd = engine.estimated_cost(d1, d1, d1, d1);
+  const auto cost_pppp_contracted = engine.estimated_cost(p2, p2, p2, p2);
+  REQUIRE(cost_pppp.nflops > 0);
+  REQUIRE(cost_pppp.stack_bytes > 0);
+  REQUIRE(cost_pppp.target_size == 81);
+  REQUIRE(cost_dddd.nflops > cost_pppp.nflops);
+  REQUIRE(cost_dddd.target_size == 1296);
+  REQUIRE(cost_pppp_contracted.nflops > cost_pppp.nflops);
+  REQUIRE(cost_pppp_contracted.target_size == cost_pppp.target_size);
+
+  const auto nshell = obs.size();
+  for (auto s1 = 0ul; s1 != nshell; ++s1) {
+    for (auto s2 = 0ul; s2 != nshell; ++s2) {
+      for (auto s3 = 0ul; s3 != nshell; ++s3) {
+        for (auto s4 = 0ul; s4 != nshell; ++s4) {
+          const auto cost = engine.estimated_cost(obs[s1], obs[s2], obs[s3], obs[s4]);
+          // shell sets with no primitive quartets left after screening are not computed
+          if (cost.nflops == 0) {
+            engine.compute(obs[s1], obs[s2], obs[s3], obs[s4]);
+            REQUIRE(results[0] == nullptr);
+            continue;
+          }
+          REQUIRE(cost.target_size ==
+                  obs[s1].cartesian_size() * obs[s2].cartesian_size() *
+                      obs[s3].cartesian_size() * obs[s4].cartesian_size());
+          // the cost does not depend on the order of shells within bra and ket
+          const auto cost_perm = engine.estimated_cost(obs[s2], obs[s1], obs[s4], obs[s3]);
+          REQUIRE(cost_perm.nflops == Approx(cost.nflops));
+          REQUIRE(cost_perm.stack_bytes == cost.stack_bytes);
+        }
+      }
+    }
+  }
+
+  // 1-body integrals
+  auto engine1 = Engine(Operator::overlap, p2.nprim(), 1);
+  REQUIRE(engine1.estimated_cost(p2, p2).nflops > engine1.estimated_cost(p1, p1).nflops);
+  REQUIRE(engine1.estimated_cost(p1, p1).target_size == 9);
+}
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "ShellPairDatabase", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < obs.max_l())
+    return;
+
+  const auto spdb = libint2::ShellPairDatabase(obs);
+  REQUIRE(spdb.symmetric());
+  REQUIRE(spdb.size() > 0);
+  REQUIRE(spdb.row_offsets().size() == obs.size() + 1);
+  REQUIRE(spdb.row_offsets().back() == spdb.size());
+  for (auto sp = 0ul; sp != spdb.size(); ++sp) {
+    REQUIRE(spdb.shell2(sp) <= spdb.shell1(sp));
+    REQUIRE(spdb.find(spdb.shell1(sp), spdb.shell2(sp)) == sp);
+  }
+  // shells on the same center are always significant
+  for (auto s = 0ul; s != obs.size(); ++s)
+    REQUIRE(spdb.find(s, s) != std::size_t(libint2::ShellPairDatabase::npos));
+
+  auto engine = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l());
+  auto engine_ref = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l());
+  const auto& results = engine.results();
+  const auto& results_ref = engine_ref.results();
+  for (auto spbra = 0ul; spbra < spdb.size(); spbra += 7) {
+    for (auto spket = 0ul; spket < spdb.size(); spket += 5) {
+      const auto& bra1 = obs[spdb.shell1(spbra)];
+      const auto& bra2 = obs[spdb.shell2(spbra)];
+      const auto& ket1 = obs[spdb.shell1(spket)];
+      const auto& ket2 = obs[spdb.shell2(spket)];
+      engine.compute2<Operator::coulomb, BraKet::xx_xx, 0>(spdb, spbra, spket);
+      engine_ref.compute2<Operator::coulomb, BraKet::xx_xx, 0>(bra1, bra2, ket1, ket2);
+      REQUIRE((results[0] == nullptr) == (results_ref[0] == nullptr));
+      if (results[0] == nullptr) continue;
+      const auto setsize = bra1.size() * bra2.size() * ket1.size() * ket2.size();
+      for (auto i = 0ul; i != setsize; ++i)
+        REQUIRE(results[0][i] == Approx(results_ref[0][i]).margin(1e-14));
+    }
+  }
+}
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "FockBuilder", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < obs.max_l())
+    return;
+  typedef libint2::FockBuilder::Matrix Matrix;
+
+  // pseudorandom symmetric density
+  const auto n = obs.nbf();
+  Matrix D(n, n);
+  for (auto i = 0l; i != n; ++i)
+    for (auto j = 0l; j <= i; ++j)
+      D(i, j) = D(j, i) = std::cos(0.3 * i + 0.7 * j) / (1 + std::abs(i - j));
+
+  // reference J and K, without any use of permutational symmetry
+  Matrix Jref = Matrix::Zero(n, n);
+  Matrix Kref = Matrix::Zero(n, n);
+  {
+    auto engine = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l(), 0, 0.0);
+    const auto& buf = engine.results();
+    const auto shell2bf = obs.shell2bf();
+    for (auto s1 = 0ul; s1 != obs.size(); ++s1) {
+      for (auto s2 = 0ul; s2 != obs.size(); ++s2) {
+        for (auto s3 = 0ul; s3 != obs.size(); ++s3) {
+          for (auto s4 = 0ul; s4 != obs.size(); ++s4) {
+            engine.compute(obs[s1], obs[s2], obs[s3], obs[s4]);
+            if (buf[0] == nullptr) continue;
+            for (auto f1 = 0ul, f1234 = 0ul; f1 != obs[s1].size(); ++f1) {
+              const auto bf1 = f1 + shell2bf[s1];
+              for (auto f2 = 0ul; f2 != obs[s2].size(); ++f2) {
+                const auto bf2 = f2 + shell2bf[s2];
+                for (auto f3 = 0ul; f3 != obs[s3].size(); ++f3) {
+                  const auto bf3 = f3 + shell2bf[s3];
+                  for (auto f4 = 0ul; f4 != obs[s4].size(); ++f4, ++f1234) {
+                    const auto bf4 = f4 + shell2bf[s4];
+                    Jref(bf1, bf2) += buf[0][f1234] * D(bf3, bf4);
+                    Kref(bf1, bf3) += buf[0][f1234] * D(bf2, bf4);
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  for (auto nthreads : {1, 3}) {
+    libint2::FockBuilder fb(obs, nthreads, 1e-12);
+    fb.set_flush_size(1024);  // exercise the intermediate flushes
+    const auto JK = fb.compute(D);
+    REQUIRE((JK.first - Jref).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-9));
+    REQUIRE((JK.second - Kref).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-9));
+    const auto J = fb.compute(D, true, false);
+    REQUIRE(J.second.size() == 0);
+    REQUIRE((J.first - JK.first).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-12));
+
+    // same, with cached integral norms, for the density and for a small density difference
+    {
+      libint2::FockBuilder fb_cached(obs, nthreads, 1e-12);
+      REQUIRE(!fb_cached.integral_norms_cached());
+      fb_cached.cache_integral_norms();
+      REQUIRE(fb_cached.integral_norms_cached());
+      const auto JK_cached = fb_cached.compute(D);
+      REQUIRE((JK_cached.first - JK.first).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-10));
+      REQUIRE((JK_cached.second - JK.second).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-10));
+      const Matrix dD = 1e-6 * D;
+      const auto dJK_cached = fb_cached.compute(dD);
+      REQUIRE((dJK_cached.first - 1e-6 * JK.first).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-10));
+      REQUIRE((dJK_cached.second - 1e-6 * JK.second).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-10));
+      fb_cached.set_precision(1e-8);
+      REQUIRE(fb_cached.precision() == 1e-8);
+      const auto JK_loose = fb_cached.compute(D);
+      REQUIRE((JK_loose.first - JK.first).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-5));
+      REQUIRE((JK_loose.second - JK.second).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-5));
+    }
+
+    // same, with the integrals read back from files in several batches
+    REQUIRE(!fb.integrals_stored());
+    fb.store_integrals("libint2-unit-test-fockbuilder").set_read_size(4096);
+    REQUIRE(fb.integrals_stored());
+    for (auto iter = 0; iter != 2; ++iter) {
+      const auto JK_stored = fb.compute(D);
+      REQUIRE((JK_stored.first - JK.first).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-12));
+      REQUIRE((JK_stored.second - JK.second).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-12));
+    }
+  }
+}
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "ShellPairTree", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < obs.max_l())
+    return;
+  typedef libint2::FockBuilder::Matrix Matrix;
+
+  // 2 copies of the molecule, far apart
+  auto atoms2 = atoms;
+  for (const auto& a : atoms)
+    atoms2.push_back(Atom{a.atomic_number, a.x + 30.0, a.y, a.z});
+  const BasisSet obs2("6-31g*", atoms2);
+  const auto spdb = libint2::ShellPairDatabase(obs2);
+  const auto Schwarz = libint2::FockBuilder::compute_schwarz(obs2);
+  const double precision = 1e-10;
+  const auto tree = libint2::ShellPairTree(spdb, Schwarz, precision, 4);
+  REQUIRE(tree.size() == spdb.size());
+  REQUIRE(tree.nnodes() > 1);
+
+  std::size_t nschwarz = 0, nqqr = 0;
+  for (auto sp12 = 0ul; sp12 != spdb.size(); ++sp12) {
+    const auto Q12 = Schwarz(spdb.shell1(sp12), spdb.shell2(sp12));
+    REQUIRE(tree.schwarz(sp12) == Q12);
+    REQUIRE(tree.extent(sp12) > 0.0);
+    std::vector<std::size_t> kets;
+    tree.visit(sp12, precision, [&](std::size_t sp34, double estimate) {
+      REQUIRE(estimate == tree.estimate(sp12, sp34));
+      kets.push_back(sp34);
+    });
+    std::sort(kets.begin(), kets.end());
+    // the tree must find the same kets as a search over all shell pairs
+    std::vector<std::size_t> kets_ref;
+    for (auto sp34 = 0ul; sp34 != spdb.size(); ++sp34) {
+      const auto Q1234 = Q12 * Schwarz(spdb.shell1(sp34), spdb.shell2(sp34));
+      REQUIRE(tree.estimate(sp12, sp34) <= Q1234);
+      if (tree.estimate(sp12, sp34) >= precision) kets_ref.push_back(sp34);
+      if (Q1234 >= precision) ++nschwarz;
+    }
+    REQUIRE(kets == kets_ref);
+    nqqr += kets.size();
+  }
+  REQUIRE(nqqr < nschwarz);
+
+  // the QQR-screened Fock builds agree with the Schwarz-screened ones
+  const auto n = obs2.nbf();
+  Matrix D(n, n);
+  for (auto i = 0l; i != n; ++i)
+    for (auto j = 0l; j <= i; ++j)
+      D(i, j) = D(j, i) = std::cos(0.3 * i + 0.7 * j) / (1 + std::abs(i - j));
+  libint2::FockBuilder fb(obs2, 2, precision, Schwarz);
+  const auto JK = fb.compute(D);
+  libint2::FockBuilder fb_qqr(obs2, 2, precision, Schwarz);
+  REQUIRE(!fb_qqr.distance_screening());
+  fb_qqr.enable_distance_screening();
+  REQUIRE(fb_qqr.distance_screening());
+  const auto JK_qqr = fb_qqr.compute(D);
+  REQUIRE((JK_qqr.first - JK.first).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-8));
+  REQUIRE((JK_qqr.second - JK.second).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-8));
+  fb_qqr.cache_integral_norms();
+  const auto JK_qqr_cached = fb_qqr.compute(D);
+  REQUIRE((JK_qqr_cached.first - JK.first).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-8));
+  REQUIRE((JK_qqr_cached.second - JK.second).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-8));
+}
+
+#if LIBINT2_DERIV_ERI_ORDER > 0
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "FockBuilder derivatives", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri1 < obs.max_l())
+    return;
+  typedef libint2::FockBuilder::Matrix Matrix;
+
+  // pseudorandom symmetric density
+  const auto n = obs.nbf();
+  Matrix D(n, n);
+  for (auto i = 0l; i != n; ++i)
+    for (auto j = 0l; j <= i; ++j)
+      D(i, j) = D(j, i) = std::cos(0.3 * i + 0.7 * j) / (1 + std::abs(i - j));
+
+  // reference derivatives, without any use of permutational symmetry or translational invariance
+  const auto shell2bf = obs.shell2bf();
+  const auto shell2atom = obs.shell2atom(atoms);
+  const auto ncoords = 3 * atoms.size();
+  auto compute_ref = [&](size_t deriv_order) {
+    Matrix ref = Matrix::Zero(ncoords, deriv_order == 1 ? 1 : ncoords);
+    auto engine = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l(), deriv_order, 0.0);
+    const auto& buf = engine.results();
+    for (auto s1 = 0ul; s1 != obs.size(); ++s1) {
+      for (auto s2 = 0ul; s2 != obs.size(); ++s2) {
+        for (auto s3 = 0ul; s3 != obs.size(); ++s3) {
+          for (auto s4 = 0ul; s4 != obs.size(); ++s4) {
+            engine.compute(obs[s1], obs[s2], obs[s3], obs[s4]);
+            if (buf[0] == nullptr) continue;
+            const size_t s[4] = {s1, s2, s3, s4};
+            auto contract = [&](size_t set) {
+              double value = 0.0;
+              for (auto f1 = 0ul, f1234 = 0ul; f1 != obs[s1].size(); ++f1) {
+                const auto bf1 = f1 + shell2bf[s1];
+                for (auto f2 = 0ul; f2 != obs[s2].size(); ++f2) {
+                  const auto bf2 = f2 + shell2bf[s2];
+                  for (auto f3 = 0ul; f3 != obs[s3].size(); ++f3) {
+                    const auto bf3 = f3 + shell2bf[s3];
+                    for (auto f4 = 0ul; f4 != obs[s4].size(); ++f4, ++f1234) {
+                      const auto bf4 = f4 + shell2bf[s4];
+                      value += buf[set][f1234] * (2 * D(bf1, bf2) * D(bf3, bf4) -
+                                                  D(bf1, bf3) * D(bf2, bf4));
+                    }
+                  }
+                }
+              }
+              return value;
+            };
+            auto coord = [&](size_t d) { return shell2atom[s[d / 3]] * 3 + d % 3; };
+            if (deriv_order == 1) {
+              for (auto d = 0; d != 12; ++d)
+                ref(coord(d), 0) += contract(d);
+            } else {
+              for (auto d0 = 0, d01 = 0; d0 != 12; ++d0) {
+                for (auto d1 = d0; d1 != 12; ++d1, ++d01) {
+                  const auto value = contract(d01);
+                  ref(coord(d0), coord(d1)) += value;
+                  if (d0 != d1) ref(coord(d1), coord(d0)) += value;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    return ref;
+  };
+
+  const auto grad_ref = compute_ref(1);
+  for (auto nthreads : {1, 3}) {
+    libint2::FockBuilder fb(obs, nthreads, 1e-12);
+    const auto grad = fb.compute_gradient(D, atoms);
+    REQUIRE(grad.rows() == atoms.size());
+    REQUIRE(grad.cols() == 3);
+    for (auto a = 0ul; a != atoms.size(); ++a)
+      for (auto xyz = 0; xyz != 3; ++xyz)
+        REQUIRE(grad(a, xyz) == Approx(grad_ref(a * 3 + xyz, 0)).margin(1e-9));
+    // translational invariance
+    REQUIRE(grad.colwise().sum().lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-9));
+  }
+
+#if LIBINT2_DERIV_ERI_ORDER > 1
+  if (LIBINT2_MAX_AM_eri2 < obs.max_l())
+    return;
+  const auto hess_ref = compute_ref(2);
+  libint2::FockBuilder fb(obs, 2, 1e-12);
+  const auto hess = fb.compute_hessian(D, atoms);
+  REQUIRE(hess.rows() == ncoords);
+  REQUIRE(hess.cols() == ncoords);
+  REQUIRE((hess - hess_ref).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-9));
+#endif
+}
+#endif
+
+#if defined(LIBINT2_SUPPORT_ERI3) && defined(LIBINT2_SUPPORT_ERI2)
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "DFIntegralStore", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < obs.max_l() ||
+      LIBINT2_MAX_AM_3eri < std::max(obs.max_l(), dfbs.max_l()) ||
+      LIBINT2_MAX_AM_2eri < dfbs.max_l())
+    return;
+  typedef libint2::DFIntegralStore::Matrix Matrix;
+  typedef libint2::DFIntegralStore::Vector Vector;
+
+  const auto n = obs.nbf();
+  const auto ndf = dfbs.nbf();
+
+  // reference (P|μν) as an (ndf x n*n) matrix, without any screening or use of permutational symmetry
+  Matrix Zref = Matrix::Zero(ndf, n * n);
+  {
+    auto engine = Engine(Operator::coulomb,
+                         std::max(obs.max_nprim(), dfbs.max_nprim()),
+                         std::max(obs.max_l(), dfbs.max_l()), 0, 0.0);
+    engine.set(BraKet::xs_xx);
+    const auto& buf = engine.results();
+    const auto shell2bf = obs.shell2bf();
+    const auto shell2bf_df = dfbs.shell2bf();
+    for (auto P = 0ul; P != dfbs.size(); ++P) {
+      for (auto s1 = 0ul; s1 != obs.size(); ++s1) {
+        for (auto s2 = 0ul; s2 != obs.size(); ++s2) {
+          engine.compute2<Operator::coulomb, BraKet::xs_xx, 0>(dfbs[P], Shell::unit(), obs[s1], obs[s2]);
+          if (buf[0] == nullptr) continue;
+          for (auto fP = 0ul, fP12 = 0ul; fP != dfbs[P].size(); ++fP)
+            for (auto f1 = 0ul; f1 != obs[s1].size(); ++f1)
+              for (auto f2 = 0ul; f2 != obs[s2].size(); ++f2, ++fP12)
+                Zref(shell2bf_df[P] + fP, (shell2bf[s1] + f1) * n + shell2bf[s2] + f2) = buf[0][fP12];
+        }
+      }
+    }
+  }
+
+  // pseudorandom coefficients and metric
+  const auto nocc = 3;
+  Matrix C(n, nocc);
+  for (auto i = 0l; i != n; ++i)
+    for (auto j = 0l; j != nocc; ++j)
+      C(i, j) = std::cos(0.3 * i + 0.7 * j);
+  Vector d(ndf);
+  for (auto P = 0l; P != ndf; ++P)
+    d(P) = std::sin(0.5 * P);
+  Matrix M(ndf, ndf);
+  for (auto P = 0l; P != ndf; ++P)
+    for (auto Q = 0l; Q != ndf; ++Q)
+      M(P, Q) = std::cos(0.2 * P + 0.9 * Q) / (1 + std::abs(P - Q));
+
+  for (auto nthreads : {1, 3}) {
+    libint2::DFIntegralStore store(obs, dfbs, nthreads, 1e-12);
+    const auto& spdb = store.shellpairs();
+    REQUIRE(store.nsignificant() > 0);
+    REQUIRE(store.nsignificant() <= spdb.size() * dfbs.size());
+
+    // every block matches the reference
+    const auto shell2bf = obs.shell2bf();
+    for (auto sp = 0ul; sp != spdb.size(); ++sp) {
+      const auto s1 = spdb.shell1(sp);
+      const auto s2 = spdb.shell2(sp);
+      const auto blk = store.block(sp);
+      REQUIRE(blk.rows() == ndf);
+      REQUIRE(blk.cols() == obs[s1].size() * obs[s2].size());
+      for (auto P = 0l; P != ndf; ++P)
+        for (auto f1 = 0ul, f12 = 0ul; f1 != obs[s1].size(); ++f1)
+          for (auto f2 = 0ul; f2 != obs[s2].size(); ++f2, ++f12)
+            REQUIRE(blk(P, f12) == Approx(Zref(P, (shell2bf[s1] + f1) * n + shell2bf[s2] + f2)).margin(1e-10));
+    }
+
+    // contractions, before and after transforming the DF index, with the blocks in memory and in
+    // a file, read in several batches
+    libint2::DFIntegralStore store_ooc(obs, dfbs, nthreads, 1e-12, "libint2-unit-test-dfstore", 10000);
+    REQUIRE(store.in_core());
+    REQUIRE(!store_ooc.in_core());
+    REQUIRE(store_ooc.size() == store.size());
+    REQUIRE(store_ooc.nsignificant() == store.nsignificant());
+    for (auto transformed : {false, true}) {
+      if (transformed) {
+        store.transform(M);
+        store_ooc.transform(M);
+      }
+      const Matrix Z = transformed ? Matrix(M.transpose() * Zref) : Zref;
+
+      for (const auto* s : {&store, &store_ooc}) {
+        const auto X = s->contract_ao(C);
+        REQUIRE(X.rows() == ndf);
+        REQUIRE(X.cols() == n * nocc);
+        for (auto Q = 0l; Q != ndf; ++Q) {
+          Eigen::Map<const Matrix> ZQ(Z.data() + Q * n * n, n, n);
+          const Matrix XQref = ZQ * C;
+          Eigen::Map<const Matrix> XQ(X.data() + Q * n * nocc, n, nocc);
+          REQUIRE((XQ - XQref).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-9));
+        }
+
+        const auto J = s->contract_df(d);
+        const Vector Jref = Z.transpose() * d;
+        Eigen::Map<const Matrix> Jref_nn(Jref.data(), n, n);
+        REQUIRE((J - Jref_nn).lpNorm<Eigen::Infinity>() == Approx(0.0).margin(1e-9));
+      }
+    }
+  }
+}
+#endif
+
+TEST_CASE_METHOD(libint2::unit::DefaultFixture, "EnginePool", "[engine][2-body]") {
+  if (LIBINT2_MAX_AM_eri < obs.max_l())
+    return;
+
+  libint2::EnginePool pool;
+  auto engine_ref = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l());
+  const auto& results_ref = engine_ref.results();
+
+  // engines are recycled, and grown as needed
+  {
+    auto engine = pool.acquire(Operator::coulomb, 1, 0);
+    REQUIRE(engine->max_nprim() == 1);
+  }
+  REQUIRE(pool.nidle() == 1);
+  {
+    auto engine = pool.acquire(Operator::coulomb, obs.max_nprim(), obs.max_l());
+    REQUIRE(pool.nengines() == 1);
+    REQUIRE(pool.nidle() == 0);
+    REQUIRE(engine->max_nprim() == obs.max_nprim());
+    REQUIRE(engine->max_l() == obs.max_l());
+    // different key => different engine
+    auto engine_ov = pool.acquire(Operator::overlap, obs.max_nprim(), obs.max_l());
+    REQUIRE(pool.nengines() == 2);
+    REQUIRE(engine_ov->oper() == Operator::overlap);
+  }
+  REQUIRE(pool.nidle() == 2);
+
+  // concurrent use
+  const auto nthreads = 4;
+  std::vector<int> nerrors(nthreads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t != nthreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (auto s1 = t; s1 < obs.size(); s1 += nthreads) {
+        for (auto s2 = 0ul; s2 != obs.size(); ++s2) {
+          // one engine per task
+          auto engine = pool.acquire(Operator::coulomb, obs.max_nprim(), obs.max_l());
+          const auto& results = engine->results();
+          engine->compute(obs[s1], obs[s2], obs[s2], obs[s1]);
+          auto engine2 = Engine(Operator::coulomb, obs.max_nprim(), obs.max_l());
+          engine2.compute(obs[s1], obs[s2], obs[s2], obs[s1]);
+          const auto& results2 = engine2.results();
+          if ((results[0] == nullptr) != (results2[0] == nullptr)) {
+            ++nerrors[t];
+            continue;
+          }
+          if (results[0] == nullptr) continue;
+          const auto n = obs[s1].size() * obs[s2].size() * obs[s2].size() * obs[s1].size();
+          for (auto i = 0ul; i != n; ++i)
+            if (results[0][i] != results2[0][i]) ++nerrors[t];
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  for (auto n : nerrors) REQUIRE(n == 0);
+  REQUIRE(pool.nengines() <= nthreads + 1);
+
+  // operator parameters are reset by acquire()
+  {
+    auto engine = pool.acquire(Operator::coulomb, obs.max_nprim(), obs.max_l());
+    engine->compute(obs[0], obs[1], obs[2], obs[3]);
+    engine_ref.compute(obs[0], obs[1], obs[2], obs[3]);
+    if (results_ref[0] != nullptr) {
+      const auto n = obs[0].size() * obs[1].size() * obs[2].size() * obs[3].size();
+      for (auto i = 0ul; i != n; ++i)
+        REQUIRE(engine->results()[0][i] == results_ref[0][i]);
+    }
+  }
+  pool.clear();
+  REQUIRE(pool.nidle() == 0);
+}
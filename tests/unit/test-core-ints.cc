@@ -1,9 +1,11 @@
 #include "catch.hpp"
 
+#include <thread>
 #include <type_traits>
 
 #include <libint2/config.h>
 #include <libint2/boys.h>
+#include <libint2/rys.h>
 
 #ifdef LIBINT_HAS_MPFR
 TEST_CASE("Boys reference values", "[core-ints]") {
@@ -48,6 +50,87 @@ TEST_CASE("Boys reference values", "[core-ints]") {
 
 #endif  // LIBINT_HAS_MPFR
 
+TEST_CASE("Boys batch evaluation", "[core-ints]") {
+  using scalar_type = libint2::scalar_type;
+
+  const int mmax = 12;
+  // cover both the interpolation and the upward recursion regimes, and more than one chunk
+  std::vector<scalar_type> T_values;
+  for(int i=0; i!=150; ++i)
+    T_values.push_back(std::pow(10., -3 + 6. * i / 149));
+  const auto n = T_values.size();
+
+  auto fm_eval = libint2::FmEval_Chebyshev7<scalar_type>::instance(mmax);
+  std::vector<scalar_type> Fm_batch(n * (mmax+1));
+  fm_eval->eval(Fm_batch.data(), T_values.data(), n, mmax);
+  std::vector<scalar_type> Fm_values(mmax+1);
+  for(std::size_t i=0; i!=n; ++i) {
+    fm_eval->eval(Fm_values.data(), T_values[i], mmax);
+    for(int m=0; m<=mmax; ++m)
+      REQUIRE(Fm_batch[i * (mmax+1) + m] == Fm_values[m]);
+  }
+}
+
+TEST_CASE("Rys quadrature", "[core-ints]") {
+  using scalar_type = libint2::scalar_type;
+
+  // the n-point quadrature reproduces F_m(T) for m < 2n, in the interpolation and the asymptotic regimes
+  const int nmax = 10;
+  auto rys_eval = libint2::RysEval_Chebyshev7<scalar_type>::instance(nmax);
+  REQUIRE(rys_eval->max_n() >= nmax);
+  auto fm_eval = libint2::FmEval_Chebyshev7<scalar_type>::instance(2 * nmax - 1);
+  std::vector<scalar_type> u(nmax), w(nmax), u_ref(nmax), w_ref(nmax), Fm(2 * nmax);
+  for(int i=0; i!=60; ++i) {
+    const scalar_type T = std::pow(10., -3 + 6. * i / 59);
+    fm_eval->eval(Fm.data(), T, 2 * nmax - 1);
+    for(int n=1; n<=nmax; ++n) {
+      rys_eval->eval(u.data(), w.data(), T, n);
+      for(int m=0; m<2*n; ++m) {
+        scalar_type value = 0;
+        for(int r=0; r!=n; ++r)
+          value += w[r] * std::pow(u[r], m);
+        REQUIRE(value == Approx(Fm[m]).epsilon(1e-12));
+      }
+      if (T < 100) {
+        libint2::RysEval_Reference<scalar_type>::eval(u_ref.data(), w_ref.data(), T, n);
+        for(int r=0; r!=n; ++r) {
+          REQUIRE(u[r] == Approx(u_ref[r]).epsilon(1e-12));
+          REQUIRE(w[r] == Approx(w_ref[r]).epsilon(1e-12));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("core evaluator instances", "[core-ints]") {
+  using scalar_type = libint2::scalar_type;
+  typedef libint2::FmEval_Chebyshev7<scalar_type> fm_eval_t;
+
+  // libint2::initialize() created the instance big enough for any engine
+  const auto fm_eval = fm_eval_t::instance(0);
+  REQUIRE(fm_eval->max_m() >= std::min(4 * LIBINT2_MAX_AM, fm_eval_t::max_m_tabulated()));
+  REQUIRE(fm_eval_t::instance(fm_eval->max_m()).get() == fm_eval.get());
+
+  // concurrent lookups and growth always return an instance that suffices
+  std::vector<std::thread> threads;
+  std::vector<int> max_m(8);
+  for(int t=0; t!=8; ++t)
+    threads.emplace_back([&max_m,t]() {
+      for(int i=0; i!=100; ++i) {
+        const auto m = (t * 100 + i) % (fm_eval_t::max_m_tabulated() + 1);
+        max_m[t] = std::min(m, fm_eval_t::instance(m)->max_m() - m);
+      }
+    });
+  for(auto& thread: threads)
+    thread.join();
+  for(auto m: max_m)
+    REQUIRE(m >= 0);
+  // superseded instances remain valid
+  std::vector<scalar_type> Fm(fm_eval->max_m() + 1);
+  fm_eval->eval(Fm.data(), 1.0, fm_eval->max_m());
+  REQUIRE(Fm[0] == Approx(0.746824132812427));
+}
+
 TEST_CASE("Slater/Yukawa core integral values", "[core-ints]") {
   using scalar_type = libint2::scalar_type;
 
@@ -19,6 +19,47 @@ TEST_CASE("Shell ctor", "[shell]") {
   REQUIRE(s1.O == std::array<double,3>{0, 0, 0});
 }
 
+TEST_CASE("ShellPair ctor", "[shell]") {
+  using libint2::ShellPair;
+  // O 1s and 2sp in STO-3G, displaced
+  auto s1 = Shell{{130.709320000, 23.808861000, 6.443608300},
+                  {{0, false, {0.15432897, 0.53532814, 0.44463454}}},
+                  {{0.0, 0.0, 0.0}}};
+  auto s2 = Shell{{5.033151300, 1.169596100, 0.380389000},
+                  {{1, false, {0.15591627, 0.60768372, 0.39195739}}},
+                  {{0.0, 0.0, 1.5}}};
+  const auto ln_prec = std::log(std::numeric_limits<double>::epsilon());
+
+  ShellPair sp(s1, s2, ln_prec);
+  REQUIRE(sp.nprimpairs() > 0);
+  REQUIRE(sp.nprimpairs() <= 9);
+  for (auto p = 1ul; p < sp.nprimpairs(); ++p)
+    REQUIRE(sp.scr()[p - 1] >= sp.scr()[p]);
+  for (auto f = 0; f != 3; ++f)
+    REQUIRE(reinterpret_cast<std::uintptr_t>(sp.P(f)) % ShellPair::align_size == 0);
+  for (auto p = 0ul; p < sp.nprimpairs(); ++p) {
+    const auto a1 = s1.alpha[sp.p1()[p]];
+    const auto a2 = s2.alpha[sp.p2()[p]];
+    REQUIRE(sp.one_over_gamma()[p] == Approx(1 / (a1 + a2)));
+    REQUIRE(sp.P(2)[p] == Approx(a2 * 1.5 / (a1 + a2)));
+  }
+
+  // reinitialization reuses the storage, copies are deep
+  ShellPair sp_reused(3);
+  REQUIRE(sp_reused.max_nprimpairs() == 9);
+  sp_reused.init(s2, s2, ln_prec);
+  sp_reused.init(s1, s2, ln_prec);
+  REQUIRE(sp_reused.max_nprimpairs() == 9);
+  const auto sp_copy = sp_reused;
+  REQUIRE(sp_copy.nprimpairs() == sp.nprimpairs());
+  for (auto p = 0ul; p < sp.nprimpairs(); ++p) {
+    REQUIRE(sp_copy.scr()[p] == sp.scr()[p]);
+    REQUIRE(sp_copy.K()[p] == sp.K()[p]);
+    REQUIRE(sp_copy.p1()[p] == sp.p1()[p]);
+    REQUIRE(sp_copy.p2()[p] == sp.p2()[p]);
+  }
+}
+
 TEST_CASE("Engine ctor", "[engine]") {
   REQUIRE_NOTHROW(Engine{});
   auto a = Engine{};